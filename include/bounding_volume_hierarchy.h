@@ -0,0 +1,100 @@
+#ifndef PLANAR_REFLECTION_BOUNDING_VOLUME_HIERARCHY
+#define PLANAR_REFLECTION_BOUNDING_VOLUME_HIERARCHY
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "frustum.h"
+#include "job_system.h"
+
+// Tree of axis aligned boxes over a box list, for culling and spatial queries. It is built with the surface area
+// heuristic (SAH), and refitted while the boxes move. Refitting keeps it correct, but not as good as a new build;
+// once its SAH cost has grown too much, a new tree is built by a background job, and replaces it when done.
+class BoundingVolumeHierarchy
+{
+public:
+	// Nodes are stored depth first: the first child of an internal node comes right after it. Every node covers
+	// the consecutive range [first_primitive, first_primitive + primitive_count) of the primitive order
+	class Node
+	{
+	public:
+		glm::vec3 min_coeffs;
+		glm::vec3 max_coeffs;
+		uint32_t first_primitive;
+		uint32_t primitive_count;
+
+		// Index of the second child; 0 for leaves
+		uint32_t second_child;
+	};
+
+	BoundingVolumeHierarchy();
+	virtual ~BoundingVolumeHierarchy();
+
+	BoundingVolumeHierarchy(const BoundingVolumeHierarchy&) = delete;
+	BoundingVolumeHierarchy& operator=(const BoundingVolumeHierarchy&) = delete;
+
+	// Refit the tree to the boxes, once per frame. Builds a new tree right away if the number of boxes changed,
+	// and in the background if refitting made it too costly
+	void Update(const Frustum::BoxList& boxes);
+
+	// Build a new tree now, or only move the node bounds to the boxes
+	void Build(const Frustum::BoxList& boxes);
+	void Refit(const Frustum::BoxList& boxes);
+
+	// Set visible[i] to 1 if box i intersects the frustum (and the portal frustum through a mirror), and 0
+	// otherwise; returns the number of visible boxes, like Frustum::CullBoxes
+	size_t CullBoxes(const Frustum& frustum, std::vector<uint8_t>& visible) const;
+	size_t CullBoxes(const Frustum& frustum, const Frustum& portal_frustum, std::vector<uint8_t>& visible) const;
+
+	// Nearest box hit by the ray before max_distance; the distance is in units of direction
+	bool IntersectRay(const glm::vec3& origin, const glm::vec3& direction, float max_distance, uint32_t& index, float& distance) const;
+
+	// Append the boxes which overlap the box (min_coeffs, max_coeffs)
+	void QueryBox(const glm::vec3& min_coeffs, const glm::vec3& max_coeffs, std::vector<uint32_t>& indices) const;
+
+	size_t GetSize() const;
+	size_t GetNodeCount() const;
+
+	// SAH cost of the refitted tree, relative to its cost when it was built
+	float GetCostRatio() const;
+	size_t GetRebuildCount() const;
+
+private:
+	class Tree
+	{
+	public:
+		std::vector<Node> nodes;
+		std::vector<uint32_t> primitives;
+		float built_cost;
+	};
+
+	// A background build, and the boxes it was started with
+	class Rebuild
+	{
+	public:
+		Frustum::BoxList boxes;
+		std::unique_ptr<Tree> tree;
+	};
+
+	static std::unique_ptr<Tree> BuildTree(const Frustum::BoxList& boxes);
+	static float CalculateCost(const std::vector<Node>& nodes);
+	static float CalculateHalfArea(const glm::vec3& min_coeffs, const glm::vec3& max_coeffs);
+
+	size_t CullNodes(const std::array<glm::vec4, 12>& planes, size_t plane_count, std::vector<uint8_t>& visible) const;
+
+	std::unique_ptr<Tree> tree_;
+	float cost_;
+	size_t rebuild_count_;
+
+	// Boxes in the primitive order of the tree, so leaves read them consecutively
+	std::vector<glm::vec3> primitive_min_;
+	std::vector<glm::vec3> primitive_max_;
+
+	std::shared_ptr<Rebuild> rebuild_;
+	JobSystem::Counter rebuild_counter_;
+};
+
+#endif
\ No newline at end of file
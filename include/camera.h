@@ -3,6 +3,8 @@
 
 #include <glm/glm.hpp>
 
+#include "frustum.h"
+
 class Camera
 {
 public:
@@ -31,6 +33,13 @@ public:
 	glm::mat4 GetViewTransform() const;
 	glm::mat4 GetProjectionTransform() const;
 
+	// Projection whose near plane is replaced by the given world space plane (oblique near plane clipping);
+	// what is on the positive side of the plane is kept, and the eye must be on its negative side
+	glm::mat4 GetObliqueProjectionTransform(const glm::vec4& clip_plane) const;
+
+	// Frustum in world space, or in the space which model_transform maps to world space
+	Frustum GetFrustum(const glm::mat4& model_transform = glm::mat4(1)) const;
+
 private:
 	glm::vec3 eye_;
 	glm::vec3 up_;
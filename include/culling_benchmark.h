@@ -0,0 +1,33 @@
+#ifndef PLANAR_REFLECTION_CULLING_BENCHMARK
+#define PLANAR_REFLECTION_CULLING_BENCHMARK
+
+#include <cstddef>
+
+// Times the queries of BoundingVolumeHierarchy against testing every box of a box list,
+// on random boxes at constant density, so the numbers of boxes can be compared.
+// Every query runs on the calling thread only, so both sides of each comparison are single-threaded
+class CullingBenchmark
+{
+public:
+	// Times per query, in milliseconds
+	class Result
+	{
+	public:
+		size_t box_count;
+		double build_ms;
+		double linear_frustum_ms;
+		double tree_frustum_ms;
+		double linear_ray_ms;
+		double tree_ray_ms;
+		double linear_box_ms;
+		double tree_box_ms;
+
+		// Whether the tree found the same boxes as the linear queries
+		bool matches;
+	};
+
+	// Run query_count queries of every kind over box_count boxes
+	static Result Run(size_t box_count, size_t query_count);
+};
+
+#endif
\ No newline at end of file
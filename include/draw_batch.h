@@ -0,0 +1,44 @@
+#ifndef PLANAR_REFLECTION_DRAW_BATCH
+#define PLANAR_REFLECTION_DRAW_BATCH
+
+#include <vector>
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include "obj_mesh.h"
+
+// Collects draws of meshes which share the same uniforms (material, transformation), and
+// submits them with one glMultiDrawElementsBaseVertex per mesh arena and index type
+class DrawBatch
+{
+public:
+	DrawBatch();
+	virtual ~DrawBatch();
+
+	void Add(const ObjMesh& mesh);
+	bool IsEmpty() const;
+
+	// Draw and clear the batch; returns the number of draw calls issued. There is no instanced
+	// multi-draw in GL 3.3, so drawing more than one instance takes one draw call per mesh
+	size_t Submit(GLsizei instance_count = 1);
+
+private:
+	// Draws which can be submitted by a single multi-draw call
+	class DrawList
+	{
+	public:
+		DrawList(ObjMesh::VertexFormat vertex_format, GLenum index_type);
+		ObjMesh::VertexFormat vertex_format;
+
+		// GL_NONE for non-indexed meshes
+		GLenum index_type;
+
+		std::vector<GLsizei> counts;
+		std::vector<const GLvoid*> index_offsets;
+		std::vector<GLint> base_vertices;
+	};
+
+	std::vector<DrawList> draw_lists_;
+};
+
+#endif
\ No newline at end of file
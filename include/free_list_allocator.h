@@ -0,0 +1,34 @@
+#ifndef PLANAR_REFLECTION_FREE_LIST_ALLOCATOR
+#define PLANAR_REFLECTION_FREE_LIST_ALLOCATOR
+
+#include <cstddef>
+#include <map>
+
+// First-fit suballocator of a linear range (e.g. a GPU buffer), in arbitrary units.
+// Free blocks are kept sorted by offset, so freed neighbors are merged right away.
+class FreeListAllocator
+{
+public:
+	FreeListAllocator(size_t capacity);
+	virtual ~FreeListAllocator();
+
+	// Returns the offset of the new block, or INVALID_OFFSET if no free block is large enough
+	size_t Allocate(size_t size, size_t alignment);
+	void Free(size_t offset, size_t size);
+
+	// Free everything, and change the capacity
+	void Reset(size_t capacity);
+
+	size_t GetCapacity() const;
+	size_t GetUsedSize() const;
+
+	static const size_t INVALID_OFFSET;
+
+private:
+	// Offset to size of every free block
+	std::map<size_t, size_t> free_blocks_;
+	size_t capacity_;
+	size_t used_size_;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,63 @@
+#ifndef PLANAR_REFLECTION_FRUSTUM
+#define PLANAR_REFLECTION_FRUSTUM
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+// View frustum as six planes, extracted from a (model-)view-projection matrix
+class Frustum
+{
+public:
+	// Axis aligned boxes in structure of arrays layout, so four of them are tested at once
+	class BoxList
+	{
+	public:
+		BoxList();
+
+		// Add the box (min_coeffs, max_coeffs) after transformation, as the box enclosing the transformed box
+		void Add(const glm::vec3& min_coeffs, const glm::vec3& max_coeffs, const glm::mat4& transform);
+
+		// Replace box index in the same way; with Resize, lets several threads fill disjoint parts of the list
+		void Set(size_t index, const glm::vec3& min_coeffs, const glm::vec3& max_coeffs, const glm::mat4& transform);
+		void Resize(size_t size);
+		void Clear();
+		size_t GetSize() const;
+
+		std::vector<float> center_x;
+		std::vector<float> center_y;
+		std::vector<float> center_z;
+		std::vector<float> extent_x;
+		std::vector<float> extent_y;
+		std::vector<float> extent_z;
+	};
+
+	Frustum(const glm::mat4& view_projection);
+
+	// Planes in the form described at GetPlane; they don't have to be normalized
+	Frustum(const std::array<glm::vec4, 6>& planes);
+	virtual ~Frustum();
+
+	// Planes are ordered left, right, bottom, top, near, far.
+	// Points inside the frustum satisfy dot(plane.xyz, point) + plane.w >= 0 for every plane
+	const glm::vec4& GetPlane(int index) const;
+
+	bool IsBoxVisible(const glm::vec3& center, const glm::vec3& extent) const;
+
+	// Set visible[i] to 1 if box i intersects the frustum, and 0 otherwise; returns the number of visible boxes.
+	// Large lists are split into ranges which are culled in parallel by the job system
+	size_t CullBoxes(const BoxList& boxes, std::vector<uint8_t>& visible) const;
+
+	// Same as CullBoxes, on the calling thread only
+	size_t CullBoxesSerial(const BoxList& boxes, std::vector<uint8_t>& visible) const;
+
+private:
+	size_t CullRange(const BoxList& boxes, size_t begin, size_t end, std::vector<uint8_t>& visible) const;
+
+	static std::array<glm::vec4, 6> ExtractPlanes(const glm::mat4& view_projection);
+
+	std::array<glm::vec4, 6> planes_;
+};
+
+#endif
\ No newline at end of file
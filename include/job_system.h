@@ -0,0 +1,99 @@
+#ifndef PLANAR_REFLECTION_JOB_SYSTEM
+#define PLANAR_REFLECTION_JOB_SYSTEM
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Pool of worker threads with a deque of jobs each. A thread pushes and pops jobs at the back of its own deque,
+// and when that is empty steals from the front of the others. Threads which aren't workers share one extra deque.
+class JobSystem
+{
+private:
+	class Job;
+
+public:
+	// Number of unfinished jobs of a group; jobs which depend on the group are started once it drops to zero
+	class Counter
+	{
+	public:
+		Counter();
+
+		Counter(const Counter&) = delete;
+		Counter& operator=(const Counter&) = delete;
+
+		// Takes the mutex, so once this returns true no worker touches the counter anymore and it can be destroyed
+		bool IsDone() const;
+
+	private:
+		friend class JobSystem;
+
+		// Only decremented with mutex_ held, together with taking out the dependents
+		std::atomic<size_t> pending_;
+		mutable std::mutex mutex_;
+		std::vector<Job> dependents_;
+	};
+
+	static JobSystem& GetInstance();
+	virtual ~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// Run a job on any thread. The counter (optional) is incremented right away, and decremented when the job has
+	// finished; if a dependency is given, the job isn't started before the dependency counter drops to zero
+	void Run(std::function<void()> function, Counter* counter = nullptr, Counter* dependency = nullptr);
+
+	// Run a long job (like loading a file) on a worker, once there is no other work. Wait never runs these,
+	// so a thread which waits for its own short jobs isn't held up by them
+	void RunBackground(std::function<void()> function, Counter* counter = nullptr);
+
+	// Run (or steal) jobs until the counter drops to zero
+	void Wait(Counter& counter);
+
+	// Call body(begin, end) for consecutive ranges of at most grain_size indices, covering [0, count), and wait for all of them
+	void ParallelFor(size_t count, size_t grain_size, const std::function<void(size_t, size_t)>& body);
+
+	size_t GetWorkerCount() const;
+
+private:
+	class Job
+	{
+	public:
+		std::function<void()> function;
+		Counter* counter;
+	};
+
+	class Queue
+	{
+	public:
+		std::deque<Job> jobs;
+		std::mutex mutex;
+	};
+
+	JobSystem(size_t worker_count);
+
+	void WorkerLoop(size_t queue_index);
+	void Push(Job job);
+	bool PopJob(size_t queue_index, bool background, Job& job);
+	void Execute(Job& job);
+
+	// Queue 0 is shared by the threads which aren't workers; queue i + 1 belongs to worker i
+	std::vector<std::unique_ptr<Queue>> queues_;
+	Queue background_queue_;
+	std::vector<std::thread> workers_;
+
+	// Number of queued jobs of all queues, guarded by mutex_ when it is incremented, so workers don't miss a wakeup
+	std::atomic<size_t> queued_count_;
+	bool stopping_;
+	std::mutex mutex_;
+	std::condition_variable condition_;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,38 @@
+#ifndef PLANAR_REFLECTION_MAPPED_FILE
+#define PLANAR_REFLECTION_MAPPED_FILE
+
+#include <string>
+#include <cstddef>
+
+// Read-only memory mapping of an entire file.
+// The mapping stays valid for the lifetime of the object.
+class MappedFile
+{
+public:
+	MappedFile(const std::string& file_path);
+	virtual ~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool IsOpen() const;
+	const char* GetData() const;
+	size_t GetSize() const;
+
+private:
+	void Map(const std::string& file_path);
+	void Unmap();
+
+	const char* data_;
+	size_t size_;
+	bool open_;
+
+#ifdef _WIN32
+	void* file_handle_;
+	void* mapping_handle_;
+#else
+	int file_descriptor_;
+#endif
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,85 @@
+#ifndef PLANAR_REFLECTION_MESH_ARENA
+#define PLANAR_REFLECTION_MESH_ARENA
+
+#include <cstdint>
+#include <vector>
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include "free_list_allocator.h"
+#include "obj_mesh.h"
+
+// One large vertex buffer and one large index buffer, shared by every mesh of a vertex format,
+// behind a single VAO. Meshes are suballocated from a free list; the buffers are compacted
+// (and grown or shrunk) by copying every live allocation on the GPU.
+class MeshArena
+{
+public:
+	class Allocation
+	{
+	public:
+		Allocation();
+
+		// Offset and count in vertices; used as the base vertex of indexed draws
+		size_t vertex_offset;
+		size_t vertex_count;
+
+		// Offset and size in bytes (the size is rounded up to 4 bytes)
+		size_t index_offset;
+		size_t index_size;
+
+		bool used;
+	};
+
+	// Arena of the given vertex format; requires a current GL context
+	static MeshArena& GetInstance(ObjMesh::VertexFormat vertex_format);
+
+	MeshArena(const MeshArena&) = delete;
+	MeshArena& operator=(const MeshArena&) = delete;
+
+	// Returns the id of a new allocation, whose offsets may change whenever the arena is compacted
+	uint32_t Allocate(size_t vertex_count, size_t index_size);
+	void Free(uint32_t allocation_id);
+	const Allocation& GetAllocation(uint32_t allocation_id) const;
+
+	// Copy data into an allocation, at the given byte offset within it
+	void WriteVertices(uint32_t allocation_id, size_t offset, const void* data, size_t size);
+	void WriteIndices(uint32_t allocation_id, size_t offset, const void* data, size_t size);
+
+	GLuint GetVertexArray() const;
+
+	// Delete the GL objects of every arena, while the context is still current. Meshes which are
+	// destroyed afterwards only give their allocations back, without any GL call
+	static void Shutdown();
+
+	// Allocated and total size of both buffers, in bytes
+	size_t GetUsedSize() const;
+	size_t GetCapacity() const;
+
+private:
+	MeshArena(ObjMesh::VertexFormat vertex_format);
+	virtual ~MeshArena();
+
+	// Move every live allocation to the front of new buffers of the given capacities
+	void Reallocate(size_t vertex_capacity, size_t index_capacity);
+	void SetVertexAttributes() const;
+	void DeleteObjects();
+
+	ObjMesh::VertexFormat vertex_format_;
+	size_t vertex_size_;
+
+	GLuint vao_;
+	GLuint vbo_;
+	GLuint ibo_;
+
+	// Vertices are allocated in units of vertices, so every offset can be used as a base vertex
+	FreeListAllocator vertex_allocator_;
+	FreeListAllocator index_allocator_;
+
+	std::vector<Allocation> allocations_;
+	std::vector<uint32_t> free_allocation_ids_;
+
+	bool shut_down_;
+};
+
+#endif
\ No newline at end of file
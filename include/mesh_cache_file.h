@@ -0,0 +1,62 @@
+#ifndef PLANAR_REFLECTION_MESH_CACHE_FILE
+#define PLANAR_REFLECTION_MESH_CACHE_FILE
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+#include "obj_mesh.h"
+
+// Versioned binary sidecar holding the final GPU-ready data of an ObjMesh:
+// interleaved vertices, indices and bounding box. The file is memory mapped
+// on load, so its contents can be handed directly to glBufferData.
+//
+// Layout: [Header][Vertex x vertex_count][uint32_t x index_count]
+class MeshCacheFile
+{
+public:
+	MeshCacheFile(const std::string& cache_path);
+	virtual ~MeshCacheFile();
+
+	// True if the file is complete and was built from a source with the given key
+	bool IsValid(uint64_t source_key) const;
+
+	const ObjMesh::Vertex* GetVertices() const;
+	size_t GetVertexCount() const;
+	const uint32_t* GetIndices() const;
+	size_t GetIndexCount() const;
+	ObjMesh::BoundingBox GetBoundingBox() const;
+
+	static bool Write(
+		const std::string& cache_path,
+		uint64_t source_key,
+		const std::vector<ObjMesh::Vertex>& vertices,
+		const std::vector<uint32_t>& indices,
+		const ObjMesh::BoundingBox& bounding_box);
+
+	static std::string GetCachePath(const std::string& source_path);
+
+	// Combines the source content hash with the loader version and the load flags,
+	// so that caches written by an older loader or with other options are rebuilt automatically
+	static uint64_t CalculateSourceKey(const char* source_data, size_t source_size, uint32_t load_flags);
+
+private:
+	struct Header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t vertex_size;
+		uint64_t source_key;
+		uint64_t vertex_count;
+		uint64_t index_count;
+		float bounding_box_min[3];
+		float bounding_box_max[3];
+		uint64_t reserved;
+	};
+
+	MappedFile file_;
+	const Header* header_;
+};
+
+#endif
\ No newline at end of file
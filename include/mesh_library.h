@@ -0,0 +1,52 @@
+#ifndef PLANAR_REFLECTION_MESH_LIBRARY
+#define PLANAR_REFLECTION_MESH_LIBRARY
+
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "obj_mesh.h"
+
+// Shares meshes between models: every model loaded from the same file content with the
+// same options references a single ObjMesh, which is freed once the last model releases it
+class MeshLibrary
+{
+public:
+	static MeshLibrary& GetInstance();
+
+	MeshLibrary(const MeshLibrary&) = delete;
+	MeshLibrary& operator=(const MeshLibrary&) = delete;
+
+	// Return the mesh of file_path loaded with load_options (thread safe). The returned mesh
+	// may not be loaded yet: call ObjMesh::LoadData and then ObjMesh::UploadData before rendering it.
+	std::shared_ptr<ObjMesh> AcquireMesh(const std::string& file_path, const ObjMesh::LoadOptions& load_options);
+
+	// Number of meshes currently in use, and the total size of their GPU buffers in bytes
+	size_t GetMeshCount();
+	size_t GetBufferSize();
+
+private:
+	// Content hash of a file, valid while its size and modification time don't change
+	class SourceKey
+	{
+	public:
+		std::filesystem::file_time_type write_time;
+		uintmax_t file_size;
+		uint64_t key;
+	};
+
+	MeshLibrary();
+
+	uint64_t GetSourceKey(const std::string& path, const ObjMesh::LoadOptions& load_options);
+
+	static std::string GetCanonicalPath(const std::string& file_path);
+	static std::string CalculateKey(const std::string& path, const ObjMesh::LoadOptions& load_options, uint64_t source_key);
+
+	std::unordered_map<std::string, std::weak_ptr<ObjMesh>> meshes_;
+	std::unordered_map<std::string, SourceKey> source_keys_;
+	std::mutex mutex_;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,52 @@
+#ifndef PLANAR_REFLECTION_MESH_OPTIMIZER
+#define PLANAR_REFLECTION_MESH_OPTIMIZER
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Reordering passes for indexed triangle lists, following
+// "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"
+// (Sander, Nehab and Barczak, 2007).
+class MeshOptimizer
+{
+public:
+	// Tipsify: reorder triangles for post-transform vertex cache locality.
+	// Optionally returns the first triangle of every cluster (hard boundaries),
+	// i.e. every place where the traversal had to jump to a non-adjacent vertex.
+	static std::vector<uint32_t> OptimizeVertexCache(
+		const std::vector<uint32_t>& indices,
+		size_t vertex_count,
+		size_t cache_size,
+		std::vector<uint32_t>* clusters);
+
+	// Split the given clusters further where cache efficiency allows it (up to threshold times
+	// the cluster ACMR), then sort clusters so that outward facing ones are drawn first
+	static std::vector<uint32_t> OptimizeOverdraw(
+		const std::vector<uint32_t>& indices,
+		const std::vector<glm::vec3>& positions,
+		const std::vector<uint32_t>& clusters,
+		size_t cache_size,
+		float threshold);
+
+	// Remap vertices in order of first use, so vertex fetches walk the vertex buffer linearly.
+	// Rewrites the indices in place, and returns the new position of every old vertex
+	// (unreferenced vertices are mapped to UINT32_MAX and should be dropped).
+	static std::vector<uint32_t> OptimizeVertexFetch(std::vector<uint32_t>& indices, size_t vertex_count, size_t& unique_vertex_count);
+
+	// Average cache miss ratio (transformed vertices per triangle)
+	static float CalculateAcmr(const std::vector<uint32_t>& indices, size_t cache_size);
+
+	// Average transform to vertex ratio (transformed vertices per unique vertex, 1.0 is optimal)
+	static float CalculateAtvr(const std::vector<uint32_t>& indices, size_t vertex_count, size_t cache_size);
+
+private:
+	static std::vector<uint32_t> GenerateSoftBoundaries(
+		const std::vector<uint32_t>& indices,
+		size_t vertex_count,
+		const std::vector<uint32_t>& clusters,
+		size_t cache_size,
+		float threshold);
+};
+
+#endif
\ No newline at end of file
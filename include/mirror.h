@@ -0,0 +1,42 @@
+#ifndef PLANAR_REFLECTION_MIRROR
+#define PLANAR_REFLECTION_MIRROR
+
+#include <glm/glm.hpp>
+
+#include "mirror_portal.h"
+#include "occlusion_query_ring.h"
+
+// A planar mirror: the plane model at some placement, together with the queries which gate and time its reflection
+class Mirror
+{
+public:
+	// The quad is the rectangle of the plane model bounds in the local XZ plane, placed by transform
+	Mirror(const glm::vec3& min_coeffs, const glm::vec3& max_coeffs, const glm::mat4& transform, size_t query_latency);
+	virtual ~Mirror();
+
+	Mirror(const Mirror&) = delete;
+	Mirror& operator=(const Mirror&) = delete;
+
+	const glm::mat4& GetTransform() const;
+	const MirrorPortal& GetPortal() const;
+
+	// Reflection across the mirror plane
+	const glm::mat4& GetReflection() const;
+
+	void SetEnabled(bool enabled);
+	bool IsEnabled() const;
+
+	// Samples of the mirror itself which passed the depth test, and GPU time of its reflection pass
+	OcclusionQueryRing& GetOcclusionQueries();
+	OcclusionQueryRing& GetTimerQueries();
+
+private:
+	glm::mat4 transform_;
+	MirrorPortal portal_;
+	glm::mat4 reflection_;
+	bool enabled_;
+	OcclusionQueryRing occlusion_queries_;
+	OcclusionQueryRing timer_queries_;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,50 @@
+#ifndef PLANAR_REFLECTION_MIRROR_PORTAL
+#define PLANAR_REFLECTION_MIRROR_PORTAL
+
+#include <array>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "frustum.h"
+
+// The finite mirror quad, used to restrict the reflection pass to what can be seen through it
+class MirrorPortal
+{
+public:
+	// The quad is the rectangle of the bounds in the local XZ plane (the mirror normal is local +Y)
+	MirrorPortal(const glm::vec3& min_coeffs, const glm::vec3& max_coeffs, const glm::mat4& transform);
+	virtual ~MirrorPortal();
+
+	// Plane of the quad; its positive side is the reflecting side
+	const glm::vec4& GetPlane() const;
+	bool IsFacing(const glm::vec3& eye) const;
+
+	// Corners of the quad, in order around it
+	const std::array<glm::vec3, 4>& GetCorners() const;
+
+	// Transformation to quad space: the quad is [0,1] in x and z, and y is the distance to the mirror plane
+	const glm::mat4& GetQuadTransform() const;
+
+	// Project the quad to a viewport of the given size; returns false if no part of it is on screen
+	bool Project(const glm::mat4& view_projection, int width, int height);
+
+	// Screen area covered by the quad and its bounding rectangle (x, y, width, height), after Project
+	float GetPixelCount() const;
+	const glm::ivec4& GetScissor() const;
+
+	// Frustum of everything which can be seen through the quad from eye, in unreflected space:
+	// the reflected eye looking through the quad edges, bounded by the mirror plane (so that
+	// anything behind the mirror is culled) and by the far plane of the reflected camera frustum
+	Frustum CalculateReflectionFrustum(const glm::vec3& eye, const Frustum& reflected_camera_frustum) const;
+
+private:
+	static std::vector<glm::vec2> ClipPolygon(const std::vector<glm::vec2>& polygon, int axis, float bound, bool keep_below);
+
+	std::array<glm::vec3, 4> corners_;
+	glm::vec4 plane_;
+	glm::mat4 quad_transform_;
+	float pixel_count_;
+	glm::ivec4 scissor_;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,95 @@
+#ifndef PLANAR_REFLECTION_MIRROR_TREE
+#define PLANAR_REFLECTION_MIRROR_TREE
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "bounding_volume_hierarchy.h"
+#include "camera.h"
+#include "frustum.h"
+#include "mirror.h"
+#include "occlusion_buffer.h"
+
+// The reflection passes of one frame: every mirror seen directly, then every mirror seen in those mirrors,
+// and so on up to a maximum depth. Every pass is culled against the frustum through its own mirror, and
+// when there are more passes than the budget allows, the ones with the smallest screen area are dropped
+class MirrorTree
+{
+public:
+	// A single reflection pass
+	class Node
+	{
+	public:
+		// Index into the mirror list, and the node the mirror is seen through (NO_PARENT if it is seen directly)
+		size_t mirror;
+		size_t parent;
+
+		// Stencil value inside the mirror; 1 for mirrors which are seen directly
+		int level;
+
+		// Reflection of the space in which the mirror is seen, and of the space which is seen through it
+		glm::mat4 parent_reflection;
+		glm::mat4 reflection;
+
+		// Plane of the mirror as seen in world space, and its screen area and scissor, limited by the parent
+		glm::vec4 plane;
+		float pixel_count;
+		glm::ivec4 scissor;
+
+		// Boxes which are visible through the mirror, and the kept nodes seen in it (largest first)
+		std::vector<uint8_t> visibility;
+		size_t visible_count;
+		std::vector<size_t> children;
+	};
+
+	MirrorTree();
+	virtual ~MirrorTree();
+
+	// Find the reflection passes of the mirrors in a viewport of the given size, and cull the boxes of the hierarchy for each
+	void Build(
+		const std::vector<std::shared_ptr<Mirror>>& mirrors,
+		const Camera& camera,
+		const BoundingVolumeHierarchy& hierarchy,
+		int width,
+		int height,
+		int max_depth,
+		float min_pixel_count,
+		size_t budget);
+
+	// Clear the visibility of the boxes of a node which the occluders of its pass hide; returns how many were hidden
+	size_t CullOccluded(size_t node, const OcclusionBuffer& occlusion_buffer, const Frustum::BoxList& boxes);
+
+	// All candidate nodes, and the kept nodes of mirrors which are seen directly (largest first)
+	const std::vector<Node>& GetNodes() const;
+	const std::vector<size_t>& GetRoots() const;
+
+	// Number of kept passes, and of passes which were dropped because of the budget
+	size_t GetPassCount() const;
+	size_t GetDroppedCount() const;
+
+	static const size_t NO_PARENT;
+
+private:
+	void AddNodes(
+		size_t parent,
+		const std::vector<std::shared_ptr<Mirror>>& mirrors,
+		const Camera& camera,
+		const BoundingVolumeHierarchy& hierarchy,
+		int width,
+		int height,
+		float min_pixel_count);
+
+	// Whether all corners of a quad are on the back side of one of the planes
+	static bool IsQuadOutside(const std::array<glm::vec4, 6>& planes, const std::array<glm::vec3, 4>& corners);
+	static glm::ivec4 IntersectScissors(const glm::ivec4& a, const glm::ivec4& b);
+
+	std::vector<Node> nodes_;
+	std::vector<size_t> roots_;
+	size_t pass_count_;
+	size_t dropped_count_;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,85 @@
+#ifndef PLANAR_REFLECTION_MODEL_LOADER
+#define PLANAR_REFLECTION_MODEL_LOADER
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "job_system.h"
+#include "obj_model.h"
+
+// Loads models in the background: the CPU stage (parsing, normals, interleaving) runs as
+// background jobs of the job system, and the GL upload runs incrementally on the render thread
+class ModelLoader
+{
+public:
+	class Job
+	{
+	public:
+		Job(const std::string& file_path, const ObjMesh::LoadOptions& load_options);
+		virtual ~Job();
+
+		Job(const Job&) = delete;
+		Job& operator=(const Job&) = delete;
+
+		std::string file_path;
+		ObjMesh::LoadOptions load_options;
+		ObjMesh::LoadProgress progress;
+		std::shared_ptr<ObjModel> model;
+
+		// For reloads: the model which gets the loaded mesh, and keeps rendering its old one until then
+		std::shared_ptr<ObjModel> target;
+	};
+
+	ModelLoader();
+	virtual ~ModelLoader();
+
+	ModelLoader(const ModelLoader&) = delete;
+	ModelLoader& operator=(const ModelLoader&) = delete;
+
+	// Queue a model for loading (render thread)
+	void LoadModelAsync(const std::string& file_path, const ObjMesh::LoadOptions& load_options);
+
+	// Queue loading the mesh of a model in the current vertex format (render thread). The model keeps its
+	// old mesh until the new one is uploaded; a model which is already being reloaded isn't queued again
+	void ReloadModelAsync(const std::shared_ptr<ObjModel>& model);
+
+	// Upload up to upload_budget bytes of loaded models, and return the models which
+	// became ready for rendering (render thread, once per frame)
+	std::vector<std::shared_ptr<ObjModel>> Update(size_t upload_budget);
+
+	// Loads which were not returned by Update yet (render thread)
+	const std::vector<std::shared_ptr<Job>>& GetPendingJobs() const;
+
+	// Models which switched to their reloaded mesh during the last Update (render thread)
+	const std::vector<std::shared_ptr<ObjModel>>& GetReloadedModels() const;
+
+	// Vertex format of the models returned by Update (render thread). Loads take the format when they start,
+	// and loads which finished in a previous format are queued again, so the render thread never reloads them
+	void SetVertexFormat(ObjMesh::VertexFormat vertex_format);
+
+private:
+	void LoadModel(const std::shared_ptr<Job>& job);
+	void QueueJob(const std::shared_ptr<Job>& job);
+
+	// Render thread only
+	std::vector<std::shared_ptr<Job>> pending_jobs_;
+	std::deque<std::shared_ptr<Job>> uploading_jobs_;
+	std::vector<std::shared_ptr<ObjModel>> reloaded_models_;
+
+	// Shared with the jobs, guarded by mutex_
+	std::vector<std::shared_ptr<Job>> loaded_jobs_;
+	std::mutex mutex_;
+
+	// Read by the jobs when they start
+	std::atomic<ObjMesh::VertexFormat> vertex_format_;
+
+	// Loads which haven't started yet are skipped once stopping
+	std::atomic<bool> stopping_;
+	JobSystem::Counter load_counter_;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,281 @@
+#ifndef PLANAR_REFLECTION_OBJ_MESH
+#define PLANAR_REFLECTION_OBJ_MESH
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <GL/gl.h>
+#include <glm/glm.hpp>
+
+class MeshCacheFile;
+
+// Geometry of an OBJ file, in CPU and GPU memory. Meshes are shared between
+// models through MeshLibrary, so a mesh holds no per-instance state.
+// OBJ file format reference:
+// https://en.wikipedia.org/wiki/Wavefront_.obj_file
+class ObjMesh
+{
+public:
+	struct Vertex
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec2 uv;
+	};
+
+	// 16 byte vertex layout: snorm16 position (w unused), snorm 10:10:10:2 normal, half float uv
+	struct CompactVertex
+	{
+		uint64_t position;
+		uint32_t normal;
+		uint32_t uv;
+	};
+
+	enum VertexFormat
+	{
+		// 32 byte float Vertex
+		STANDARD,
+
+		// 16 byte quantized CompactVertex
+		COMPACT
+	};
+
+	class BoundingBox
+	{
+	public:
+		BoundingBox();
+		glm::vec3 max_coeffs;
+		glm::vec3 min_coeffs;
+	};
+
+	enum ParseMode
+	{
+		// Read the file into a string stream and parse it line by line
+		STREAM,
+
+		// Memory map the file and tokenize it in place
+		MAPPED,
+
+		// Memory map the file and tokenize line-aligned chunks of it concurrently
+		PARALLEL
+	};
+
+	enum LoadStage
+	{
+		QUEUED,
+		HASHING,
+		PARSING,
+		PROCESSING,
+		UPLOADING,
+		FINISHED
+	};
+
+	// Progress of a load, written by the loading thread and read by the render thread
+	class LoadProgress
+	{
+	public:
+		LoadProgress();
+		float GetFraction() const;
+		std::atomic<int> stage;
+		std::atomic<size_t> total_bytes;
+		std::atomic<size_t> parsed_bytes;
+		std::atomic<size_t> upload_bytes;
+		std::atomic<size_t> uploaded_bytes;
+
+		// Progress of the shared mesh while this load waits for it; GetFraction follows it instead of the fields above
+		std::atomic<const LoadProgress*> shared;
+	};
+
+	class LoadOptions
+	{
+	public:
+		LoadOptions();
+		ParseMode parse_mode;
+
+		// Largest number of chunks parsed as jobs in PARALLEL mode (0 = one per job system thread)
+		unsigned int thread_count;
+
+		// Load from, and write to, a binary sidecar cache next to the OBJ file
+		bool use_cache;
+
+		// Merge face corners sharing the same (position, normal, uv) into one indexed vertex
+		bool deduplicate_vertices;
+
+		// Reorder indexed meshes for vertex cache hits, reduced overdraw and linear vertex fetch
+		bool optimize_mesh;
+
+		// Layout of the vertex buffer on the GPU
+		VertexFormat vertex_format;
+
+		// Free the parsed and processed CPU side arrays once the mesh is on the GPU
+		bool release_cpu_data;
+
+		// Only run the CPU stage when constructing an ObjModel (safe on any thread);
+		// ObjModel::UploadModelData must then be called on the GL thread
+		bool defer_upload;
+
+		// Optional progress report, must outlive the load
+		LoadProgress* progress;
+	};
+
+	class LoadStatistics
+	{
+	public:
+		LoadStatistics();
+		double GetParseThroughput() const;
+		size_t file_size;
+		double parse_seconds;
+		double load_seconds;
+		bool cache_hit;
+
+		// Vertex cache efficiency before and after mesh optimization
+		float acmr_before;
+		float acmr_after;
+		float atvr_before;
+		float atvr_after;
+	};
+	
+
+	// Does not load anything yet; source_key identifies the file content and the options
+	// which change the final data (see MeshCacheFile::CalculateSourceKey)
+	ObjMesh(const std::string& file_path, const LoadOptions& load_options, uint64_t source_key);
+	virtual ~ObjMesh();
+
+	ObjMesh(const ObjMesh&) = delete;
+	ObjMesh& operator=(const ObjMesh&) = delete;
+
+	const std::vector<glm::vec3>& GetVertices() const;
+	const std::vector<uint32_t>& GetVertexIndices() const;
+	const std::vector<glm::vec3>& GetNormals() const;
+	const std::vector<uint32_t>& GetNormalIndices() const;
+	const std::vector<glm::vec2>& GetUvs() const;
+	const std::vector<uint32_t>& GetUvIndices() const;
+
+	// CPU stage of loading: parse, process and prepare GPU data. Makes no GL calls.
+	// Runs only once; concurrent callers wait until it has finished.
+	void LoadData();
+
+	// GL stage of loading: copy up to byte_budget bytes of prepared data to the GPU.
+	// Returns true once the mesh is fully uploaded and ready to render.
+	bool UploadData(size_t byte_budget);
+
+	bool IsLoaded() const;
+
+	void Render() const;
+
+	// Draw parameters within the MeshArena of the vertex format, for batched submission
+	GLsizei GetVertexCount() const;
+	GLsizei GetIndexCount() const;
+	GLenum GetIndexType() const;
+	uint32_t GetAllocationId() const;
+
+	const std::string& GetFilePath() const;
+	const LoadOptions& GetLoadOptions() const;
+	VertexFormat GetVertexFormat() const;
+
+	// Size of the vertex and index buffers on the GPU, in bytes (thread safe)
+	size_t GetBufferSize() const;
+
+	// Report the progress of this mesh to progress (thread safe), until it is loaded or DetachProgress is called.
+	// Every load which shares the mesh gets the progress of the one load which actually runs.
+	void AttachProgress(LoadProgress* progress);
+	void DetachProgress(LoadProgress* progress);
+
+	const BoundingBox& GetBoundingBox() const;
+	const LoadStatistics& GetLoadStatistics() const;
+
+	// Every option that changes the final vertex/index data, as flags of the cache key
+	static uint32_t GetCacheFlags(const LoadOptions& load_options);
+
+private:
+	void LoadDataOnce();
+	void PrepareUpload(const Vertex* vertices, size_t vertex_count, const uint32_t* indices, size_t index_count);
+	void DestroyBuffers();
+	void ReleaseCpuData();
+	void SetLoadStage(LoadStage stage);
+	void PrintBufferStatistics(size_t corner_count) const;
+	void OptimizeMesh();
+
+	bool LoadCache(const std::string& cache_path);
+	void ParseStream();
+	void ParseMapped();
+
+	void ParseVertexPosition(std::istream& line_stream);
+	void ParseVertexNormal(std::istream& line_stream);
+	void ParseVertexTexture(std::istream& line_stream);
+	void ParseFace(std::istream& line_stream);
+
+	static glm::vec3 Vec3FromStream(std::istream& line_stream);
+	static glm::vec2 Vec2FromStream(std::istream& line_stream);
+	static std::vector<Vertex> InterleaveData(
+		const std::vector<glm::vec3>& positions,
+		const std::vector<glm::vec3>& normals,
+		const std::vector<glm::vec2>& uvs,
+		const std::vector<uint32_t>& position_indices,
+		const std::vector<uint32_t>& normal_indices,
+		const std::vector<uint32_t>& uv_indices);
+	static std::vector<Vertex> IndexData(
+		const std::vector<glm::vec3>& positions,
+		const std::vector<glm::vec3>& normals,
+		const std::vector<glm::vec2>& uvs,
+		const std::vector<uint32_t>& position_indices,
+		const std::vector<uint32_t>& normal_indices,
+		const std::vector<uint32_t>& uv_indices,
+		std::vector<uint32_t>& indices);
+	static std::vector<CompactVertex> CompressVertices(const Vertex* vertices, size_t vertex_count);
+	static BoundingBox CalculateBoundingBox(const std::vector<glm::vec3>& positions);
+	static std::vector<glm::vec3> NormalizePositions(const std::vector<glm::vec3>& positions);
+
+	std::vector<glm::vec3> positions_;
+	std::vector<glm::vec3> normals_;
+	std::vector<glm::vec2> uvs_;
+	std::vector<uint32_t> position_indices_;
+	std::vector<uint32_t> normal_indices_;
+	std::vector<uint32_t> uv_indices_;
+	std::vector<Vertex> vertices_;
+	std::vector<uint32_t> indices_;
+
+	// Location of the GPU data in the MeshArena of the vertex format
+	uint32_t allocation_id_;
+	bool allocated_;
+	GLsizei vertex_count_;
+	GLsizei index_count_;
+	GLenum index_type_;
+
+	// Written by the loading thread, read by any thread through GetBufferSize
+	std::atomic<size_t> buffer_size_;
+
+	BoundingBox bounding_box_;
+
+	LoadOptions load_options_;
+	std::string file_path_;
+	uint64_t source_key_;
+	LoadStatistics load_statistics_;
+	std::once_flag load_once_;
+
+	// Progress of the load, mirrored to the attached progress objects of the callers
+	LoadProgress progress_;
+	std::vector<LoadProgress*> attached_progress_;
+	bool progress_finished_;
+	std::mutex progress_mutex_;
+
+	// Data prepared by the CPU stage, until it is uploaded
+	std::unique_ptr<MeshCacheFile> cache_file_;
+	std::vector<CompactVertex> compact_vertices_;
+	std::vector<uint16_t> short_indices_;
+	const void* upload_vertex_data_;
+	size_t upload_vertex_size_;
+	const void* upload_index_data_;
+	size_t upload_index_size_;
+	size_t upload_offset_;
+	bool upload_pending_;
+	bool upload_started_;
+
+	bool loaded_;
+};
+
+#endif
\ No newline at end of file
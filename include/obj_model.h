@@ -1,50 +1,53 @@
 #ifndef PLANAR_REFLECTION_OBJ_LOADER
 #define PLANAR_REFLECTION_OBJ_LOADER
 
+#include <memory>
 #include <string>
-#include <vector>
-#include <GL/glew.h>
-#include <GL/gl.h>
 #include <glm/glm.hpp>
 
 #include "material.h"
+#include "obj_mesh.h"
 
-// OBJ file format reference:
-// https://en.wikipedia.org/wiki/Wavefront_.obj_file
+// A model instance: transformation and material over a mesh, which is shared
+// with every other model of the same OBJ file (see MeshLibrary)
 class ObjModel
 {
 public:
-	struct Vertex
-	{
-		glm::vec3 position;
-		glm::vec3 normal;
-		glm::vec2 uv;
-	};
-
-	class BoundingBox
-	{
-	public:
-		BoundingBox();
-		glm::vec3 max_coeffs;
-		glm::vec3 min_coeffs;
-	};
-	
 	ObjModel(const std::string& file_path);
 	ObjModel(const std::string& file_path, const Material& material);
+	ObjModel(const std::string& file_path, const ObjMesh::LoadOptions& load_options);
+	ObjModel(const std::string& file_path, const Material& material, const ObjMesh::LoadOptions& load_options);
 	virtual ~ObjModel();
 
-	const std::vector<glm::vec3>& GetVertices() const;
-	const std::vector<uint32_t>& GetVertexIndices() const;
-	const std::vector<glm::vec3>& GetNormals() const;
-	const std::vector<uint32_t>& GetNormalIndices() const;
-	const std::vector<glm::vec2>& GetUvs() const;
-	const std::vector<uint32_t>& GetUvIndices() const;
-	
+	// Load and upload synchronously; requires a current GL context
 	void LoadModel(const std::string& file_path);
+
+	// GL stage of loading: copy up to byte_budget bytes of the mesh to the GPU.
+	// Returns true once the model is fully uploaded and ready to render.
+	bool UploadModelData(size_t byte_budget);
+
+	bool IsLoaded() const;
+
+	// Release the mesh; it is freed once no other model references it
 	void UnloadModel();
-	
+
 	void Render() const;
 
+	// Reload synchronously in another vertex format; see ModelLoader::ReloadModelAsync to reload without blocking
+	void SetVertexFormat(ObjMesh::VertexFormat vertex_format);
+	ObjMesh::VertexFormat GetVertexFormat() const;
+
+	// Switch to a mesh of the same file which was loaded elsewhere, possibly in another vertex format
+	void SetMesh(const std::shared_ptr<ObjMesh>& mesh);
+
+	const std::string& GetFilePath() const;
+	const ObjMesh::LoadOptions& GetLoadOptions() const;
+
+	// Size of the vertex and index buffers on the GPU, in bytes (shared with other models of the same mesh)
+	size_t GetBufferSize() const;
+
+	const std::shared_ptr<ObjMesh>& GetMesh() const;
+
 	Material& GetMaterial();
 	void SetMaterial(const Material& material);
 
@@ -53,51 +56,27 @@ public:
 
 	const glm::mat4& GetLocalTransform() const;
 	const glm::mat4& GetWorldTransform() const;
-	glm::mat4 GetModelTransform() const;
 
-	const BoundingBox& GetBoundingBox() const;
-	
+	// World transform times local transform, recomputed only after either of them changed
+	const glm::mat4& GetModelTransform() const;
+
+	const ObjMesh::BoundingBox& GetBoundingBox() const;
+	const ObjMesh::LoadStatistics& GetLoadStatistics() const;
+
 private:
-	void CreateBuffers();
-	void DestroyBuffers();
-	
-	void ParseVertexPosition(std::istream& line_stream);
-	void ParseVertexNormal(std::istream& line_stream);
-	void ParseVertexTexture(std::istream& line_stream);
-	void ParseFace(std::istream& line_stream);
-
-	static glm::vec3 Vec3FromStream(std::istream& line_stream);
-	static glm::vec2 Vec2FromStream(std::istream& line_stream);
-	static std::vector<Vertex> InterleaveData(
-		std::vector<glm::vec3> positions,
-		std::vector<glm::vec3> normals,
-		std::vector<glm::vec2> uvs,
-		std::vector<uint32_t> position_indices,
-		std::vector<uint32_t> normal_indices,
-		std::vector<uint32_t> uv_indices);
-	static BoundingBox CalculateBoundingBox(const std::vector<glm::vec3>& positions);
-	static std::vector<glm::vec3> NormalizePositions(const std::vector<glm::vec3>& positions);
-	
-	std::vector<glm::vec3> positions_;
-	std::vector<glm::vec3> normals_;
-	std::vector<glm::vec2> uvs_;
-	std::vector<uint32_t> position_indices_;
-	std::vector<uint32_t> normal_indices_;
-	std::vector<uint32_t> uv_indices_;
-	std::vector<Vertex> vertices_;
-
-	GLuint vao_;
-	GLuint vbo_;
-	GLuint ibo_;
+	void AcquireMesh(const std::string& file_path);
+
+	std::shared_ptr<ObjMesh> mesh_;
 
 	glm::mat4 local_transform_;
 	glm::mat4 world_transform_;
+	mutable glm::mat4 model_transform_;
+	mutable bool model_transform_dirty_;
 
 	Material material_;
 
-	BoundingBox bounding_box_;
-
-	bool loaded_;
+	ObjMesh::LoadOptions load_options_;
+	std::string file_path_;
 };
 
 #endif
\ No newline at end of file
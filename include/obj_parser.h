@@ -0,0 +1,49 @@
+#ifndef PLANAR_REFLECTION_OBJ_PARSER
+#define PLANAR_REFLECTION_OBJ_PARSER
+
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include <glm/glm.hpp>
+
+// In-place OBJ tokenizer operating directly on a character buffer
+// (typically a memory mapped file). Produces exactly the same data as
+// the stream based parser in ObjMesh, without any per-line allocations.
+class ObjParser
+{
+public:
+	struct Result
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec2> uvs;
+		std::vector<uint32_t> position_indices;
+		std::vector<uint32_t> normal_indices;
+		std::vector<uint32_t> uv_indices;
+	};
+
+	// If parsed_bytes is given, it is advanced periodically while parsing, for progress reporting
+	static void Parse(const char* begin, const char* end, Result& result, std::atomic<size_t>* parsed_bytes = nullptr);
+
+	// Split the buffer into at most chunk_limit line-aligned chunks, parse them as jobs of the job system,
+	// and stitch the chunk results together in file order. A chunk limit of 0 uses one chunk per worker and caller.
+	static void ParseParallel(const char* begin, const char* end, unsigned int chunk_limit, Result& result, std::atomic<size_t>* parsed_bytes = nullptr);
+
+private:
+	static std::vector<const char*> SplitLines(const char* begin, const char* end, size_t chunk_count);
+	static void Stitch(const std::vector<Result>& chunk_results, Result& result);
+
+	static void ParseLine(const char* begin, const char* end, Result& result);
+	static bool ParseFace(const char* begin, const char* end, Result& result);
+
+	static const char* SkipSpaces(const char* begin, const char* end);
+	static const char* SkipToken(const char* begin, const char* end);
+	static const char* ParseFloat(const char* begin, const char* end, float& value);
+	static const char* ParseIndex(const char* begin, const char* end, uint32_t& value);
+	static bool IsSpace(char c);
+
+	static void ReportError(std::string_view line);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,82 @@
+#ifndef PLANAR_REFLECTION_OCCLUSION_BUFFER
+#define PLANAR_REFLECTION_OCCLUSION_BUFFER
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "frustum.h"
+
+// Low resolution depth buffer, rasterized on the CPU from a few large occluders, for culling the boxes hidden
+// behind them before anything is submitted. The buffer is split into tiles which are rasterized in parallel
+// (four pixels at a time with SSE), and every block of 8x8 pixels keeps its farthest depth, so most boxes are
+// accepted or rejected without reading single pixels. Occluders only cover the pixels which are fully inside
+// their outline, at their farthest depth in the pixel, so a box is never culled by less than what covers it;
+// edges shared by two triangles of an occluder are rasterized as usual, so they leave no gaps.
+class OcclusionBuffer
+{
+public:
+	// The size is rounded up to whole tiles
+	OcclusionBuffer(int width, int height);
+	virtual ~OcclusionBuffer();
+
+	// Start over with no occluders, seen through view_projection
+	void Clear(const glm::mat4& view_projection);
+
+	// Add the triangles of an occluder mesh, placed by transform; both sides occlude
+	void AddOccluder(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, const glm::mat4& transform);
+	void AddOccluder(const glm::vec3* positions, size_t position_count, const uint32_t* indices, size_t index_count, const glm::mat4& transform);
+
+	// Rasterize the occluders added since Clear
+	void Rasterize();
+
+	// Whether any part of the box (in the space of view_projection) may be in front of the occluders
+	bool IsBoxVisible(const glm::vec3& center, const glm::vec3& extent) const;
+
+	// Set visible[i] to 0 for the visible boxes which are hidden by the occluders; returns the number still visible
+	size_t CullBoxes(const Frustum::BoxList& boxes, std::vector<uint8_t>& visible) const;
+
+	int GetWidth() const;
+	int GetHeight() const;
+	size_t GetTriangleCount() const;
+
+private:
+	// Screen space triangle, as its edge functions and depth plane (a * x + b * y + c) over pixel coordinates,
+	// already offset to the conservative pixel test and depth, and the pixel rectangle it covers
+	class Triangle
+	{
+	public:
+		std::array<glm::vec3, 3> edges;
+		glm::vec3 depth;
+		int min_x;
+		int min_y;
+		int max_x;
+		int max_y;
+	};
+
+	// Outline edges (from vertex i to the next) are moved inward, to only cover the pixels fully inside
+	void AddClipTriangle(const std::array<glm::vec4, 3>& vertices, const std::array<bool, 3>& outline);
+	void AddScreenTriangle(glm::vec3 a, glm::vec3 b, glm::vec3 c, std::array<bool, 3> outline);
+	void RasterizeTile(size_t tile);
+
+	int width_;
+	int height_;
+	int tile_columns_;
+	int tile_rows_;
+	int block_columns_;
+	glm::mat4 view_projection_;
+
+	// Scratch arrays of AddOccluder, kept so adding occluders every frame doesn't allocate
+	std::vector<glm::vec4> clip_positions_;
+	std::vector<uint64_t> edges_;
+
+	std::vector<Triangle> triangles_;
+	std::vector<std::vector<uint32_t>> tile_triangles_;
+
+	// Depth in [0, 1] per pixel, rows from the bottom of the screen up, and the farthest depth of every block
+	std::vector<float> depth_;
+	std::vector<float> block_depth_;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,52 @@
+#ifndef PLANAR_REFLECTION_OCCLUSION_QUERY_RING
+#define PLANAR_REFLECTION_OCCLUSION_QUERY_RING
+
+#include <cstddef>
+#include <vector>
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+// Queries, one per frame in a ring. The current occlusion query can gate later draws of the same
+// frame on the GPU (glBeginConditionalRender), while its result is read back on the CPU a few frames
+// later, once it is available, so the CPU never waits for the GPU. Counting targets (GL_SAMPLES_PASSED,
+// or pipeline statistics such as fragment shader invocations) are read back the same way.
+class OcclusionQueryRing
+{
+public:
+	OcclusionQueryRing(size_t size, GLenum target = GL_ANY_SAMPLES_PASSED);
+	virtual ~OcclusionQueryRing();
+
+	OcclusionQueryRing(const OcclusionQueryRing&) = delete;
+	OcclusionQueryRing& operator=(const OcclusionQueryRing&) = delete;
+
+	// Begin and end the query of this frame
+	void Begin();
+	void End();
+
+	// Query object of the last Begin
+	GLuint GetCurrentQuery() const;
+
+	// Read back every finished query without blocking
+	void CollectResults();
+
+	// Number of queries read back, and how many of them had no samples passing
+	size_t GetResultCount() const;
+	size_t GetOccludedCount() const;
+
+	// Result of the query read back last (a boolean for GL_ANY_SAMPLES_PASSED)
+	GLuint64 GetLastResult() const;
+
+private:
+	void CollectResult(size_t index);
+
+	GLenum target_;
+	std::vector<GLuint> queries_;
+	std::vector<bool> pending_;
+	size_t current_;
+	size_t next_;
+	size_t result_count_;
+	size_t occluded_count_;
+	GLuint64 last_result_;
+};
+
+#endif
\ No newline at end of file
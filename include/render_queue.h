@@ -0,0 +1,63 @@
+#ifndef PLANAR_REFLECTION_RENDER_QUEUE
+#define PLANAR_REFLECTION_RENDER_QUEUE
+
+#include <cstdint>
+#include <vector>
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include "draw_batch.h"
+#include "material.h"
+#include "obj_mesh.h"
+#include "uniform_blocks.h"
+#include "uniform_ring_buffer.h"
+
+// Draw packets ordered by a 64-bit sort key: pass (8 bits), program (8), material (16), mesh (16) and quantized
+// depth (16, front to back). Building and sorting make no GL calls; only Submit does, on the render thread.
+// A queue doesn't change any GL state between passes, so passes which need different state are queued separately.
+class RenderQueue
+{
+public:
+	class Packet
+	{
+	public:
+		uint64_t key;
+		const ObjMesh* mesh;
+		uint32_t object;
+	};
+
+	RenderQueue(UniformRingBuffer& uniform_ring);
+	virtual ~RenderQueue();
+
+	// Sort key of a draw; depth is the normalized depth in [0, 1]
+	static uint64_t MakeKey(uint32_t pass, uint32_t program, uint32_t material, const ObjMesh& mesh, float depth);
+
+	// Small id of a material, equal for materials of the same colors
+	uint32_t GetMaterialId(const Material& material);
+
+	// Add the uniforms of an object, shared by all of its packets, and return its index
+	uint32_t AddObject(const ObjectUniforms& uniforms);
+
+	// Queue a draw of the mesh with the uniforms of the given object
+	void Push(uint64_t key, const ObjMesh& mesh, uint32_t object);
+
+	// Order the packets by key (radix sort, skipping the bytes which are equal in every key)
+	void Sort();
+
+	// Upload the object uniforms, and draw the packets in order; consecutive packets of the same
+	// object are drawn by a single multi-draw. Returns the number of draw calls, and clears the queue.
+	size_t Submit(GLsizei instance_count);
+
+	void Clear();
+	const std::vector<Packet>& GetPackets() const;
+
+private:
+	UniformRingBuffer& uniform_ring_;
+	std::vector<Packet> packets_;
+	std::vector<Packet> sorted_packets_;
+	std::vector<ObjectUniforms> objects_;
+	std::vector<Material> materials_;
+	DrawBatch batch_;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef PLANAR_REFLECTION_RENDER_TARGET
+#define PLANAR_REFLECTION_RENDER_TARGET
+
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+// Framebuffer with an RGBA color texture and a depth buffer, for rendering to a texture
+class RenderTarget
+{
+public:
+	RenderTarget();
+	virtual ~RenderTarget();
+
+	RenderTarget(const RenderTarget&) = delete;
+	RenderTarget& operator=(const RenderTarget&) = delete;
+
+	// (Re)create the attachments; does nothing if the size didn't change
+	void Resize(int width, int height);
+
+	// Bind the framebuffer, with a viewport covering all of it
+	void Bind() const;
+
+	GLuint GetTexture() const;
+	int GetWidth() const;
+	int GetHeight() const;
+
+private:
+	GLuint framebuffer_;
+	GLuint color_texture_;
+	GLuint depth_buffer_;
+	int width_;
+	int height_;
+};
+
+#endif
\ No newline at end of file
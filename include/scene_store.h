@@ -0,0 +1,120 @@
+#ifndef PLANAR_REFLECTION_SCENE_STORE
+#define PLANAR_REFLECTION_SCENE_STORE
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "frustum.h"
+#include "material.h"
+#include "obj_mesh.h"
+
+// Per-frame data of the scene objects in structure of arrays layout: the hot loops (animation, bounds,
+// draw list building) read only the dense arrays they need. Entities are stable handles; the dense
+// arrays stay packed when an entity is destroyed, by moving the last entity into its slot.
+//
+// Entities form a transform hierarchy: the local transform of an entity is relative to its parent, or to
+// the root transform. The dense arrays are kept sorted by depth, so parents come before their children,
+// and world and normal matrices are only recomputed for entities whose local transform, or that of an
+// ancestor, changed since the last update.
+class SceneStore
+{
+public:
+	typedef uint32_t Entity;
+
+	SceneStore();
+	virtual ~SceneStore();
+
+	SceneStore(const SceneStore&) = delete;
+	SceneStore& operator=(const SceneStore&) = delete;
+
+	Entity Create(const std::shared_ptr<ObjMesh>& mesh, const Material& material, const glm::mat4& local_transform, Entity parent = INVALID_ENTITY);
+
+	// The children of a destroyed entity are attached to its parent
+	void Destroy(Entity entity);
+	bool IsValid(Entity entity) const;
+
+	// Position of the entity in the dense arrays; changes when another entity is destroyed
+	size_t GetIndex(Entity entity) const;
+	size_t GetSize() const;
+
+	void SetMesh(Entity entity, const std::shared_ptr<ObjMesh>& mesh);
+	void SetMaterial(Entity entity, const Material& material);
+	void SetLocalTransform(Entity entity, const glm::mat4& local_transform);
+
+	// Fails if parent is the entity itself or one of its descendants
+	bool SetParent(Entity entity, Entity parent);
+	Entity GetParent(Entity entity) const;
+
+	// Transform of the entities without parent
+	void SetRootTransform(const glm::mat4& root_transform);
+
+	// Batch updates, run in parallel by the job system (and with SSE, where available). The world transforms
+	// are updated level by level; UpdateBounds only replaces the boxes of the entities updated last, so it
+	// has to be given the same list every frame
+	void MultiplyLocalTransforms(const glm::mat4& transform);
+	void UpdateWorldTransforms();
+	void UpdateBounds(Frustum::BoxList& boxes) const;
+
+	// Entities whose world transform was recomputed by the last UpdateWorldTransforms
+	size_t GetUpdatedCount() const;
+
+	// Dense arrays, indexed by GetIndex
+	const std::vector<glm::mat4>& GetLocalTransforms() const;
+	const std::vector<glm::mat4>& GetWorldTransforms() const;
+	const std::vector<glm::mat4>& GetNormalMatrices() const;
+	const std::vector<glm::vec3>& GetBoundsMin() const;
+	const std::vector<glm::vec3>& GetBoundsMax() const;
+	const std::vector<const ObjMesh*>& GetMeshes() const;
+	const std::vector<uint32_t>& GetMaterialIds() const;
+
+	const Material& GetMaterial(uint32_t material_id) const;
+
+	static const Entity INVALID_ENTITY;
+
+private:
+	uint32_t AcquireMaterial(const Material& material);
+	void ReleaseMaterial(uint32_t material_id);
+
+	// Restore the depth order of the dense arrays after parents changed or entities were destroyed
+	void SortByDepth();
+	void UpdateLevel(size_t begin, size_t end);
+
+	// Dense arrays
+	std::vector<glm::mat4> local_transforms_;
+	std::vector<glm::mat4> world_transforms_;
+	std::vector<glm::mat4> normal_matrices_;
+	std::vector<glm::vec3> bounds_min_;
+	std::vector<glm::vec3> bounds_max_;
+	std::vector<const ObjMesh*> meshes_;
+	std::vector<uint32_t> material_ids_;
+
+	// Hierarchy, also dense: the dense index of the parent (INVALID_ENTITY for none), whether the local
+	// transform changed, and whether the world transform was updated last
+	std::vector<uint32_t> parents_;
+	std::vector<uint8_t> dirty_;
+	std::vector<uint8_t> updated_;
+
+	// Dense index of the first entity of every depth, and one past the last entity
+	std::vector<size_t> level_offsets_;
+	bool order_dirty_;
+
+	glm::mat4 root_transform_;
+	bool root_dirty_;
+	size_t updated_count_;
+
+	// Cold data, also dense: the owners of the meshes, and the entity of every slot
+	std::vector<std::shared_ptr<ObjMesh>> mesh_owners_;
+	std::vector<Entity> entities_;
+
+	// Entity to dense index, and the entities which can be reused
+	std::vector<uint32_t> indices_;
+	std::vector<Entity> free_entities_;
+
+	// Distinct materials, and how many entities use each of them (unused ones are reused)
+	std::vector<Material> materials_;
+	std::vector<uint32_t> material_references_;
+};
+
+#endif
\ No newline at end of file
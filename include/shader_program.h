@@ -1,11 +1,31 @@
 #ifndef PLANAR_REFLECTION_SHADER_PROGRAM
 #define PLANAR_REFLECTION_SHADER_PROGRAM
 
-#include <map>
+#include <cstddef>
 #define GLEW_STATIC
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <string>
+#include <vector>
+
+class ShaderProgram;
+
+// Pre-resolved uniform of a shader program, for setting it without a lookup by name. The handle
+// stays valid when the program is reloaded, as the program resolves its name again after linking
+template<typename T>
+class UniformHandle
+{
+public:
+	UniformHandle();
+
+	bool IsValid() const;
+
+private:
+	friend class ShaderProgram;
+	explicit UniformHandle(size_t index);
+
+	size_t index_;
+};
 
 class ShaderProgram
 {
@@ -25,6 +45,19 @@ public:
 
 	GLuint GetProgram() const;
 
+	// Resolve a uniform to a handle; unknown names and mismatching types are reported here, and after every relink
+	template<typename T>
+	UniformHandle<T> GetUniformHandle(const GLchar* name);
+
+	// Set a uniform through its handle, which is a single table index
+	void SetUniform(const UniformHandle<glm::vec2>& handle, const glm::vec2& vec);
+	void SetUniform(const UniformHandle<glm::vec3>& handle, const glm::vec3& vec);
+	void SetUniform(const UniformHandle<glm::vec4>& handle, const glm::vec4& vec);
+	void SetUniform(const UniformHandle<glm::mat4>& handle, const glm::mat4& mat);
+	void SetUniform(const UniformHandle<GLfloat>& handle, const GLfloat value);
+	void SetUniform(const UniformHandle<GLint>& handle, const GLint value);
+
+	// Set a uniform by name, with a binary search of the active uniforms; prefer handles for uniforms set every frame
 	void SetUniform(const GLchar* name, const glm::vec2& vec);
 	void SetUniform(const GLchar* name, const glm::vec3& vec);
 	void SetUniform(const GLchar* name, const glm::vec4& vec);
@@ -32,14 +65,86 @@ public:
 	void SetUniform(const GLchar* name, const GLfloat value);
 	void SetUniform(const GLchar* name, const GLint value);
 
+	// Attach a uniform block of the program to a uniform buffer binding point
+	void SetUniformBlockBinding(const GLchar* name, GLuint binding);
+
 private:
+	// Active uniform of the linked program
+	class Uniform
+	{
+	public:
+		std::string name;
+		GLint location;
+		GLenum type;
+	};
+
+	// Uniform requested through a handle, resolved after every link
+	class Handle
+	{
+	public:
+		std::string name;
+		GLenum type;
+		GLint location;
+	};
+
 	void UnloadShaders();
 	std::string LoadTextFile(const std::string& file_path);
 	void  CheckCompileErrors(GLuint shader, ShaderType type);
+	void ReflectUniforms();
+	void ResolveHandle(Handle& handle) const;
+	size_t AddHandle(const GLchar* name, GLenum type);
+	const Uniform* FindUniform(const GLchar* name) const;
 	GLint GetUniformLocation(const GLchar* name);
-	
+
+	// Type of the uniforms which a handle of the given value type can set
+	static GLenum GetUniformType(const glm::vec2*);
+	static GLenum GetUniformType(const glm::vec3*);
+	static GLenum GetUniformType(const glm::vec4*);
+	static GLenum GetUniformType(const glm::mat4*);
+	static GLenum GetUniformType(const GLfloat*);
+	static GLenum GetUniformType(const GLint*);
+
+	template<typename T>
+	GLint GetHandleLocation(const UniformHandle<T>& handle) const;
+
 	GLuint handle_;
-	std::map<std::string, GLint> uniform_locations_;
+
+	// Sorted by name
+	std::vector<Uniform> uniforms_;
+	std::vector<Handle> handles_;
+	std::vector<std::string> unknown_names_;
 };
 
+template<typename T>
+UniformHandle<T>::UniformHandle() :
+	index_(static_cast<size_t>(-1))
+{
+
+}
+
+template<typename T>
+UniformHandle<T>::UniformHandle(size_t index) :
+	index_(index)
+{
+
+}
+
+template<typename T>
+bool UniformHandle<T>::IsValid() const
+{
+	return index_ != static_cast<size_t>(-1);
+}
+
+template<typename T>
+UniformHandle<T> ShaderProgram::GetUniformHandle(const GLchar* name)
+{
+	return UniformHandle<T>(AddHandle(name, GetUniformType(static_cast<const T*>(nullptr))));
+}
+
+template<typename T>
+GLint ShaderProgram::GetHandleLocation(const UniformHandle<T>& handle) const
+{
+	return handle.index_ < handles_.size() ? handles_[handle.index_].location : -1;
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,107 @@
+#ifndef PLANAR_REFLECTION_STATE_CACHE
+#define PLANAR_REFLECTION_STATE_CACHE
+
+#include <array>
+#include <cstddef>
+#include <vector>
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+// Shadows the GL state which is changed while rendering (program, vertex array, buffer bindings, depth, stencil,
+// color mask, scissor and blend state), and drops the calls which wouldn't change it. Everything that is set
+// through the cache must only be changed through it, or the cache has to be invalidated afterwards.
+class StateCache
+{
+public:
+	// Cache of the current GL context (render thread only)
+	static StateCache& GetInstance();
+
+	StateCache(const StateCache&) = delete;
+	StateCache& operator=(const StateCache&) = delete;
+
+	// Forget all state, so the next call of every kind is issued; used when code outside of the cache may have changed it
+	void Invalidate();
+
+	// Keep the counters of the frame which just ended, start counting again, and invalidate (ImGui sets state of its own)
+	void BeginFrame();
+
+	void UseProgram(GLuint program);
+	void BindVertexArray(GLuint vertex_array);
+	void BindBuffer(GLenum target, GLuint buffer);
+	void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+	// Delete objects, and forget the bindings which referred to them (their names may be reused)
+	void DeleteProgram(GLuint program);
+	void DeleteVertexArray(GLuint vertex_array);
+	void DeleteBuffer(GLuint buffer);
+
+	// glEnable / glDisable
+	void SetEnabled(GLenum capability, bool enabled);
+
+	void DepthMask(GLboolean mask);
+	void DepthFunc(GLenum func);
+	void DepthRange(GLdouble near_value, GLdouble far_value);
+	void StencilFunc(GLenum func, GLint ref, GLuint mask);
+	void StencilOp(GLenum stencil_fail, GLenum depth_fail, GLenum depth_pass);
+	void StencilMask(GLuint mask);
+	void ColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha);
+	void BlendFunc(GLenum source_factor, GLenum destination_factor);
+	void Scissor(GLint x, GLint y, GLsizei width, GLsizei height);
+
+	// Calls passed on to GL, and calls dropped as redundant, during the last frame
+	size_t GetIssuedCount() const;
+	size_t GetElidedCount() const;
+
+private:
+	// Value of a piece of state, which is unknown until it is first set
+	template<typename T>
+	class Shadow
+	{
+	public:
+		Shadow();
+
+		T value;
+		bool known;
+	};
+
+	class BufferRange
+	{
+	public:
+		bool operator==(const BufferRange&) const = default;
+
+		GLuint buffer;
+		GLintptr offset;
+		GLsizeiptr size;
+	};
+
+	StateCache();
+
+	// Record a new value; returns whether the call has to be issued
+	template<typename T>
+	bool Update(Shadow<T>& shadow, const T& value);
+
+	static int GetCapabilityIndex(GLenum capability);
+	static int GetBufferIndex(GLenum target);
+
+	Shadow<GLuint> program_;
+	Shadow<GLuint> vertex_array_;
+	std::vector<Shadow<GLuint>> buffers_;
+	std::vector<Shadow<BufferRange>> uniform_ranges_;
+	std::vector<Shadow<bool>> capabilities_;
+	Shadow<GLboolean> depth_mask_;
+	Shadow<GLenum> depth_func_;
+	Shadow<std::array<GLdouble, 2>> depth_range_;
+	Shadow<std::array<GLuint, 3>> stencil_func_;
+	Shadow<std::array<GLuint, 3>> stencil_op_;
+	Shadow<GLuint> stencil_mask_;
+	Shadow<std::array<GLboolean, 4>> color_mask_;
+	Shadow<std::array<GLuint, 2>> blend_func_;
+	Shadow<std::array<GLint, 4>> scissor_;
+
+	size_t issued_count_;
+	size_t elided_count_;
+	size_t last_issued_count_;
+	size_t last_elided_count_;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,45 @@
+#ifndef PLANAR_REFLECTION_UNIFORM_BLOCKS
+#define PLANAR_REFLECTION_UNIFORM_BLOCKS
+
+#include <glm/glm.hpp>
+
+#include "material.h"
+#include "point_light.h"
+
+// Binding points of the uniform blocks, shared by all shader programs
+#define FRAME_UNIFORMS_BINDING 0
+#define OBJECT_UNIFORMS_BINDING 1
+
+// Per-frame uniform block (std140 "Frame"); only mat4 and vec4 members, so the C++ layout matches without padding
+class FrameUniforms
+{
+public:
+	FrameUniforms(const glm::mat4& view, const glm::mat4& projection, PointLight& light);
+
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 view_projection;
+	glm::vec4 light_position;
+	glm::vec4 light_ambient;
+	glm::vec4 light_diffuse;
+};
+
+// Per-object uniform block (std140 "Object"). Lighting is done at the unreflected placement (model), as reflecting
+// is an isometry; the object is drawn at its reflected placement (world), with the matrices of the pass baked in
+class ObjectUniforms
+{
+public:
+	ObjectUniforms(const glm::mat4& model, const glm::mat4& reflection, const glm::mat4& view_projection, const Material& material);
+
+	// With the normal matrix of model, when it is cached (see SceneStore)
+	ObjectUniforms(const glm::mat4& model, const glm::mat4& normal_matrix, const glm::mat4& reflection, const glm::mat4& view_projection, const Material& material);
+
+	glm::mat4 model;
+	glm::mat4 world;
+	glm::mat4 normal_matrix;
+	glm::mat4 model_view_projection;
+	glm::vec4 ambient;
+	glm::vec4 diffuse;
+};
+
+#endif
\ No newline at end of file
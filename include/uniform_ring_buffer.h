@@ -0,0 +1,64 @@
+#ifndef PLANAR_REFLECTION_UNIFORM_RING_BUFFER
+#define PLANAR_REFLECTION_UNIFORM_RING_BUFFER
+
+#include <cstddef>
+#include <vector>
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+// Uniform buffer split into one region per frame in flight. Blocks are appended to the region of the current frame
+// with unsynchronized writes; a fence per region makes sure the GPU is done with it before it is written again
+class UniformRingBuffer
+{
+public:
+	UniformRingBuffer(size_t frame_capacity, size_t frame_count);
+	virtual ~UniformRingBuffer();
+
+	UniformRingBuffer(const UniformRingBuffer&) = delete;
+	UniformRingBuffer& operator=(const UniformRingBuffer&) = delete;
+
+	// Wait until the GPU has finished the frame which last used the region of this frame
+	void BeginFrame();
+
+	// Fence the region of this frame, and move on to the next one
+	void EndFrame();
+
+	// Copy count consecutive blocks of block_size bytes, each to an aligned offset, and return the offset of the first
+	GLintptr Write(const void* blocks, size_t block_size, size_t count);
+
+	// Distance between the blocks of a single write
+	size_t GetStride(size_t block_size) const;
+
+	// Bind a block at the given offset to a uniform block binding point; if the buffer grows later this frame,
+	// the range is bound again at its new location
+	void BindRange(GLuint binding, GLintptr offset, size_t block_size);
+
+	GLuint GetBuffer() const;
+	size_t GetFrameCapacity() const;
+
+	// Number of frames in which BeginFrame had to wait for the GPU
+	size_t GetStallCount() const;
+
+private:
+	class BoundRange
+	{
+	public:
+		GLuint binding;
+		size_t region_offset;
+		size_t size;
+	};
+
+	void Grow(size_t frame_capacity);
+
+	GLuint buffer_;
+	size_t alignment_;
+	size_t frame_capacity_;
+	size_t frame_count_;
+	size_t frame_;
+	size_t cursor_;
+	size_t stall_count_;
+	std::vector<GLsync> fences_;
+	std::vector<BoundRange> bound_ranges_;
+};
+
+#endif
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <string>
 #include <glm/vec3.hpp>
 #include <vector>
+#include <cstdint>
 
 class Utils
 {
@@ -10,6 +11,12 @@ public:
 	static std::string TextFileToString(const std::string& file_path);
 	static std::stringstream TextFileToStream(const std::string& file_path);
 	static std::vector<glm::vec3> CalculateVertexNormals(const std::vector<glm::vec3>& vertices, const std::vector<uint32_t>& vertex_indices);
+
+	// Number of vertex shader invocations for an indexed triangle list, assuming a FIFO post-transform cache
+	static size_t SimulateVertexCache(const std::vector<uint32_t>& indices, size_t cache_size);
+
+	// Fast non-cryptographic 64-bit content hash (XXH64)
+	static uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0);
 };
 
 #endif
\ No newline at end of file
@@ -1,37 +1,78 @@
 #version 330 core
 
-struct Material
+// Camera and light, written once per frame
+layout(std140) uniform Frame
 {
-	vec3 ambient;
-	vec3 diffuse;
-};
+	mat4 view;
+	mat4 projection;
+	mat4 view_projection;
+	vec4 light_position;
+	vec4 light_ambient;
+	vec4 light_diffuse;
+} frame;
 
-struct PointLight
+// Placement and material of the object
+layout(std140) uniform Object
 {
-	vec3 position;
-	vec3 ambient;
-	vec3 diffuse;
-};
+	mat4 model;
+	mat4 world;
+	mat4 normal_matrix;
+	mat4 model_view_projection;
+	vec4 ambient;
+	vec4 diffuse;
+} object;
 
 in vec3 frag_pos;
 in vec3 frag_normal;
+in vec3 frag_quad_pos;
+flat in int frag_instance;
+in vec4 frag_clip_pos;
 
-uniform PointLight point_light;
-uniform Material material;
+// Eye position relative to the mirror quad
+uniform vec3 mirror_eye;
+
+// Single pass reflection: the mirror quad doesn't write depth, so the models behind it are discarded where it covers them
+uniform bool mirror_occludes;
+
+// Render to texture reflection, sampled by the mirror plane at its own screen position
+uniform bool reflection_texture_enabled;
+uniform sampler2D reflection_texture;
 
 out vec4 frag_color;
 
 void main()
 {
+	// The reflected instance can only be seen through the mirror quad (what the stencil does in two passes),
+	// and the model itself only where the quad doesn't cover it
+	if (frag_instance == 1 || mirror_occludes)
+	{
+		// Whether the view ray passes through the quad before it reaches the fragment
+		vec3 ray = frag_quad_pos - mirror_eye;
+		vec2 hit = mirror_eye.xz - ray.xz * (mirror_eye.y / ray.y);
+		bool behind_quad = frag_quad_pos.y * mirror_eye.y < 0.0 && all(greaterThanEqual(hit, vec2(0.0))) && all(lessThanEqual(hit, vec2(1.0)));
+		if (behind_quad != (frag_instance == 1))
+		{
+			discard;
+		}
+	}
+
 	// Calculate ambient color
-	vec3 ambient = point_light.ambient * material.ambient * material.ambient;
+	vec3 ambient = frame.light_ambient.rgb * object.ambient.rgb * object.ambient.rgb;
 
 	// Calculate diffuse color
 	vec3 normal = normalize(frag_normal);
-	vec3 light_dir = normalize(point_light.position - frag_pos);
+	vec3 light_dir = normalize(frame.light_position.xyz - frag_pos);
 	float factor = max(dot(normal, light_dir), 0.0);
-	vec3 diffuse = factor * point_light.diffuse * material.diffuse;
+	vec3 diffuse = factor * frame.light_diffuse.rgb * object.diffuse.rgb;
+
+	// Blend in the reflection where reflected models were rendered (alpha is 0 elsewhere)
+	vec3 color = ambient + diffuse;
+	if (reflection_texture_enabled)
+	{
+		vec4 reflection = textureProj(reflection_texture, vec3((frag_clip_pos.xy + frag_clip_pos.w) * 0.5, frag_clip_pos.w));
+		color = mix(color, reflection.rgb, reflection.a);
+	}
 
 	// Calculate final fragment color
-	frag_color = vec4(ambient + diffuse, 1.0f);
+	frag_color = vec4(color, 1.0f);
 };
\ No newline at end of file
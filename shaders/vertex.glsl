@@ -3,21 +3,67 @@
 layout(location = 0) in vec3 pos;
 layout(location = 1) in vec3 normal;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Camera and light, written once per frame
+layout(std140) uniform Frame
+{
+	mat4 view;
+	mat4 projection;
+	mat4 view_projection;
+	vec4 light_position;
+	vec4 light_ambient;
+	vec4 light_diffuse;
+} frame;
+
+// Placement and material of the object, with the matrices of the pass already multiplied in
+layout(std140) uniform Object
+{
+	mat4 model;
+	mat4 world;
+	mat4 normal_matrix;
+	mat4 model_view_projection;
+	vec4 ambient;
+	vec4 diffuse;
+} object;
+
+// Single pass reflection: instance 1 is the model reflected by the mirror
+uniform mat4 reflection;
+uniform mat4 mirror_quad;
+
+// Plane which the (non instanced) models are clipped against, when GL_CLIP_DISTANCE0 is enabled
+uniform vec4 clip_plane;
 
 out vec3 frag_pos;
 out vec3 frag_normal;
+out vec3 frag_quad_pos;
+flat out int frag_instance;
+out vec4 frag_clip_pos;
 
 void main()
 {
 	// Pass to fragment shader the associated vertex position
-	frag_pos = vec3(model * vec4(pos, 1.0f));
+	frag_pos = vec3(object.model * vec4(pos, 1.0f));
 
 	// Pass to fragment shader the associated vertex normal
-	frag_normal = mat3(model) * normal;
+	frag_normal = mat3(object.normal_matrix) * normal;
+
+	// Pick the placement of this instance; reflecting is an isometry, so the reflected
+	// instance is lit at its unreflected position with the unreflected light
+	vec4 world_pos = object.world * vec4(pos, 1.0f);
+	if (gl_InstanceID == 1)
+	{
+		world_pos = reflection * world_pos;
+	}
+
+	frag_instance = gl_InstanceID;
+
+	// Pass to fragment shader the vertex position relative to the mirror quad
+	frag_quad_pos = vec3(mirror_quad * world_pos);
+
+	// Clip what is reflected to the front of the mirror; the reflected instance is clipped
+	// at the mirror quad plane, which is where y becomes positive in quad space
+	gl_ClipDistance[0] = gl_InstanceID == 1 ? -frag_quad_pos.y : dot(clip_plane, world_pos);
 
 	// Run position through pipeline
-	gl_Position = projection * view * model * vec4(pos, 1.0f);
+	gl_Position = gl_InstanceID == 1 ? frame.view_projection * world_pos : object.model_view_projection * vec4(pos, 1.0f);
+	frag_clip_pos = gl_Position;
 }
\ No newline at end of file
@@ -0,0 +1,595 @@
+#include "bounding_volume_hierarchy.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+// Leaves hold at most this many boxes; up to it, the SAH decides whether splitting pays off
+#define BVH_MAX_LEAF_SIZE 8
+
+// Candidate split planes per axis
+#define BVH_BIN_COUNT 16
+
+// Cost of visiting a node, relative to testing a box
+#define BVH_TRAVERSAL_COST 1.0f
+
+// Rebuild once refitting made the tree this much more costly than when it was built
+#define BVH_REBUILD_COST_RATIO 1.3f
+
+// Smaller trees are rebuilt right away instead of in the background
+#define BVH_BACKGROUND_REBUILD_SIZE 4096
+
+namespace
+{
+	inline glm::vec3 GetMin(const Frustum::BoxList& boxes, size_t i)
+	{
+		return glm::vec3(boxes.center_x[i] - boxes.extent_x[i], boxes.center_y[i] - boxes.extent_y[i], boxes.center_z[i] - boxes.extent_z[i]);
+	}
+
+	inline glm::vec3 GetMax(const Frustum::BoxList& boxes, size_t i)
+	{
+		return glm::vec3(boxes.center_x[i] + boxes.extent_x[i], boxes.center_y[i] + boxes.extent_y[i], boxes.center_z[i] + boxes.extent_z[i]);
+	}
+
+	inline bool Overlap(const glm::vec3& min_a, const glm::vec3& max_a, const glm::vec3& min_b, const glm::vec3& max_b)
+	{
+		return min_a.x <= max_b.x && min_b.x <= max_a.x &&
+			min_a.y <= max_b.y && min_b.y <= max_a.y &&
+			min_a.z <= max_b.z && min_b.z <= max_a.z;
+	}
+
+	// Whether the ray enters the box (slab test) before max_distance, and its entry distance if it does.
+	// A miss is reported by the flag, as no distance can be compared against an infinite max_distance
+	inline bool IntersectBox(const glm::vec3& origin, const glm::vec3& inverse_direction, float max_distance, const glm::vec3& min_coeffs, const glm::vec3& max_coeffs, float& distance)
+	{
+		float near_distance = 0;
+		float far_distance = max_distance;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float t0 = (min_coeffs[axis] - origin[axis]) * inverse_direction[axis];
+			float t1 = (max_coeffs[axis] - origin[axis]) * inverse_direction[axis];
+			if (t0 > t1)
+			{
+				std::swap(t0, t1);
+			}
+
+			near_distance = std::max(near_distance, t0);
+			far_distance = std::min(far_distance, t1);
+		}
+
+		distance = near_distance;
+		return near_distance <= far_distance;
+	}
+}
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy() :
+	cost_(0),
+	rebuild_count_(0)
+{
+
+}
+
+BoundingVolumeHierarchy::~BoundingVolumeHierarchy()
+{
+	// A background build decrements the counter when it is done, so it has to finish first
+	JobSystem::GetInstance().Wait(rebuild_counter_);
+}
+
+void BoundingVolumeHierarchy::Update(const Frustum::BoxList& boxes)
+{
+	// Take over a finished background build; it is refitted below, as the boxes moved while it was built
+	if (rebuild_ != nullptr && rebuild_counter_.IsDone())
+	{
+		if (rebuild_->boxes.GetSize() == boxes.GetSize())
+		{
+			tree_ = std::move(rebuild_->tree);
+			rebuild_count_++;
+		}
+
+		rebuild_.reset();
+	}
+
+	if (tree_ == nullptr || tree_->primitives.size() != boxes.GetSize())
+	{
+		Build(boxes);
+		return;
+	}
+
+	Refit(boxes);
+	if (rebuild_ != nullptr || cost_ <= tree_->built_cost * BVH_REBUILD_COST_RATIO)
+	{
+		return;
+	}
+
+	if (boxes.GetSize() < BVH_BACKGROUND_REBUILD_SIZE)
+	{
+		Build(boxes);
+		rebuild_count_++;
+		return;
+	}
+
+	// The job builds from its own copy of the boxes
+	auto rebuild = std::make_shared<Rebuild>();
+	rebuild->boxes = boxes;
+	rebuild_ = rebuild;
+	JobSystem::GetInstance().RunBackground([rebuild]() { rebuild->tree = BuildTree(rebuild->boxes); }, &rebuild_counter_);
+}
+
+void BoundingVolumeHierarchy::Build(const Frustum::BoxList& boxes)
+{
+	tree_ = BuildTree(boxes);
+	Refit(boxes);
+}
+
+void BoundingVolumeHierarchy::Refit(const Frustum::BoxList& boxes)
+{
+	std::vector<Node>& nodes = tree_->nodes;
+	const std::vector<uint32_t>& primitives = tree_->primitives;
+	primitive_min_.resize(primitives.size());
+	primitive_max_.resize(primitives.size());
+	for (size_t i = 0; i < primitives.size(); i++)
+	{
+		primitive_min_[i] = GetMin(boxes, primitives[i]);
+		primitive_max_[i] = GetMax(boxes, primitives[i]);
+	}
+
+	// Children come after their parent, so a reverse pass updates them first
+	for (size_t i = nodes.size(); i-- > 0;)
+	{
+		Node& node = nodes[i];
+		if (node.second_child == 0)
+		{
+			node.min_coeffs = glm::vec3(std::numeric_limits<float>::max());
+			node.max_coeffs = glm::vec3(-std::numeric_limits<float>::max());
+			for (uint32_t p = node.first_primitive; p < node.first_primitive + node.primitive_count; p++)
+			{
+				node.min_coeffs = glm::min(node.min_coeffs, primitive_min_[p]);
+				node.max_coeffs = glm::max(node.max_coeffs, primitive_max_[p]);
+			}
+		}
+		else
+		{
+			const Node& first_child = nodes[i + 1];
+			const Node& second_child = nodes[node.second_child];
+			node.min_coeffs = glm::min(first_child.min_coeffs, second_child.min_coeffs);
+			node.max_coeffs = glm::max(first_child.max_coeffs, second_child.max_coeffs);
+		}
+	}
+
+	cost_ = CalculateCost(nodes);
+}
+
+size_t BoundingVolumeHierarchy::CullBoxes(const Frustum& frustum, std::vector<uint8_t>& visible) const
+{
+	std::array<glm::vec4, 12> planes;
+	for (int i = 0; i < 6; i++)
+	{
+		planes[i] = frustum.GetPlane(i);
+	}
+
+	return CullNodes(planes, 6, visible);
+}
+
+size_t BoundingVolumeHierarchy::CullBoxes(const Frustum& frustum, const Frustum& portal_frustum, std::vector<uint8_t>& visible) const
+{
+	// A box has to be inside both frustums, so it is tested against the planes of both at once
+	std::array<glm::vec4, 12> planes;
+	for (int i = 0; i < 6; i++)
+	{
+		planes[i] = frustum.GetPlane(i);
+		planes[i + 6] = portal_frustum.GetPlane(i);
+	}
+
+	return CullNodes(planes, 12, visible);
+}
+
+size_t BoundingVolumeHierarchy::CullNodes(const std::array<glm::vec4, 12>& planes, size_t plane_count, std::vector<uint8_t>& visible) const
+{
+	visible.assign(GetSize(), 0);
+	if (tree_ == nullptr || tree_->nodes.empty())
+	{
+		return 0;
+	}
+
+	// Classify a box against the planes of the mask; planes which it is fully inside of are removed from the mask
+	auto classify = [&planes](const glm::vec3& min_coeffs, const glm::vec3& max_coeffs, uint32_t& mask)
+	{
+		const glm::vec3 center = (min_coeffs + max_coeffs) * 0.5f;
+		const glm::vec3 extent = (max_coeffs - min_coeffs) * 0.5f;
+		for (uint32_t plane = 0; mask >> plane != 0; plane++)
+		{
+			if ((mask & (1u << plane)) == 0)
+			{
+				continue;
+			}
+
+			const glm::vec3 normal(planes[plane]);
+			const float distance = glm::dot(normal, center) + planes[plane].w;
+			const float radius = glm::dot(glm::abs(normal), extent);
+			if (distance + radius < 0)
+			{
+				return false;
+			}
+
+			if (distance - radius >= 0)
+			{
+				mask &= ~(1u << plane);
+			}
+		}
+
+		return true;
+	};
+
+	const std::vector<Node>& nodes = tree_->nodes;
+	const std::vector<uint32_t>& primitives = tree_->primitives;
+	std::vector<std::pair<uint32_t, uint32_t>> stack;
+	stack.reserve(64);
+	stack.emplace_back(0, (1u << plane_count) - 1);
+	size_t visible_count = 0;
+	while (!stack.empty())
+	{
+		const uint32_t index = stack.back().first;
+		uint32_t mask = stack.back().second;
+		stack.pop_back();
+
+		const Node& node = nodes[index];
+		if (!classify(node.min_coeffs, node.max_coeffs, mask))
+		{
+			continue;
+		}
+
+		// Everything below a node which is inside all planes is visible, without further tests
+		if (mask == 0 || node.second_child == 0)
+		{
+			for (uint32_t p = node.first_primitive; p < node.first_primitive + node.primitive_count; p++)
+			{
+				uint32_t primitive_mask = mask;
+				if (mask == 0 || classify(primitive_min_[p], primitive_max_[p], primitive_mask))
+				{
+					visible[primitives[p]] = 1;
+					visible_count++;
+				}
+			}
+
+			continue;
+		}
+
+		stack.emplace_back(node.second_child, mask);
+		stack.emplace_back(index + 1, mask);
+	}
+
+	return visible_count;
+}
+
+bool BoundingVolumeHierarchy::IntersectRay(const glm::vec3& origin, const glm::vec3& direction, float max_distance, uint32_t& index, float& distance) const
+{
+	if (tree_ == nullptr || tree_->nodes.empty())
+	{
+		return false;
+	}
+
+	const glm::vec3 inverse_direction(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+	const std::vector<Node>& nodes = tree_->nodes;
+	float nearest_distance = max_distance;
+	bool hit = false;
+
+	std::vector<uint32_t> stack;
+	stack.reserve(64);
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		const Node& node = nodes[stack.back()];
+		const uint32_t node_index = stack.back();
+		stack.pop_back();
+		float node_distance = 0;
+		if (!IntersectBox(origin, inverse_direction, nearest_distance, node.min_coeffs, node.max_coeffs, node_distance))
+		{
+			continue;
+		}
+
+		if (node.second_child == 0)
+		{
+			for (uint32_t p = node.first_primitive; p < node.first_primitive + node.primitive_count; p++)
+			{
+				float primitive_distance = 0;
+				if (IntersectBox(origin, inverse_direction, nearest_distance, primitive_min_[p], primitive_max_[p], primitive_distance))
+				{
+					nearest_distance = primitive_distance;
+					index = tree_->primitives[p];
+					hit = true;
+				}
+			}
+
+			continue;
+		}
+
+		// Visit the nearer child first, so the farther one is more likely to be skipped; missed children aren't visited
+		const Node& first_child = nodes[node_index + 1];
+		const Node& second_child = nodes[node.second_child];
+		float first_distance = 0;
+		float second_distance = 0;
+		const bool first_hit = IntersectBox(origin, inverse_direction, nearest_distance, first_child.min_coeffs, first_child.max_coeffs, first_distance);
+		const bool second_hit = IntersectBox(origin, inverse_direction, nearest_distance, second_child.min_coeffs, second_child.max_coeffs, second_distance);
+		if (first_hit && second_hit)
+		{
+			if (first_distance <= second_distance)
+			{
+				stack.push_back(node.second_child);
+				stack.push_back(node_index + 1);
+			}
+			else
+			{
+				stack.push_back(node_index + 1);
+				stack.push_back(node.second_child);
+			}
+		}
+		else if (first_hit)
+		{
+			stack.push_back(node_index + 1);
+		}
+		else if (second_hit)
+		{
+			stack.push_back(node.second_child);
+		}
+	}
+
+	if (hit)
+	{
+		distance = nearest_distance;
+	}
+
+	return hit;
+}
+
+void BoundingVolumeHierarchy::QueryBox(const glm::vec3& min_coeffs, const glm::vec3& max_coeffs, std::vector<uint32_t>& indices) const
+{
+	if (tree_ == nullptr || tree_->nodes.empty())
+	{
+		return;
+	}
+
+	const std::vector<Node>& nodes = tree_->nodes;
+	std::vector<uint32_t> stack;
+	stack.reserve(64);
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		const uint32_t index = stack.back();
+		stack.pop_back();
+
+		const Node& node = nodes[index];
+		if (!Overlap(node.min_coeffs, node.max_coeffs, min_coeffs, max_coeffs))
+		{
+			continue;
+		}
+
+		if (node.second_child == 0)
+		{
+			for (uint32_t p = node.first_primitive; p < node.first_primitive + node.primitive_count; p++)
+			{
+				if (Overlap(primitive_min_[p], primitive_max_[p], min_coeffs, max_coeffs))
+				{
+					indices.push_back(tree_->primitives[p]);
+				}
+			}
+
+			continue;
+		}
+
+		stack.push_back(node.second_child);
+		stack.push_back(index + 1);
+	}
+}
+
+size_t BoundingVolumeHierarchy::GetSize() const
+{
+	return tree_ != nullptr ? tree_->primitives.size() : 0;
+}
+
+size_t BoundingVolumeHierarchy::GetNodeCount() const
+{
+	return tree_ != nullptr ? tree_->nodes.size() : 0;
+}
+
+float BoundingVolumeHierarchy::GetCostRatio() const
+{
+	return tree_ != nullptr && tree_->built_cost > 0 ? cost_ / tree_->built_cost : 1.0f;
+}
+
+size_t BoundingVolumeHierarchy::GetRebuildCount() const
+{
+	return rebuild_count_;
+}
+
+std::unique_ptr<BoundingVolumeHierarchy::Tree> BoundingVolumeHierarchy::BuildTree(const Frustum::BoxList& boxes)
+{
+	auto tree = std::make_unique<Tree>();
+	const size_t box_count = boxes.GetSize();
+	tree->primitives.resize(box_count);
+	std::iota(tree->primitives.begin(), tree->primitives.end(), 0);
+	if (box_count == 0)
+	{
+		tree->built_cost = 0;
+		return tree;
+	}
+
+	// Corners and centers of the boxes, which are read once per level
+	std::vector<glm::vec3> box_min(box_count);
+	std::vector<glm::vec3> box_max(box_count);
+	std::vector<glm::vec3> box_centers(box_count);
+	for (size_t i = 0; i < box_count; i++)
+	{
+		box_min[i] = GetMin(boxes, i);
+		box_max[i] = GetMax(boxes, i);
+		box_centers[i] = glm::vec3(boxes.center_x[i], boxes.center_y[i], boxes.center_z[i]);
+	}
+
+	// Ranges of primitives to turn into nodes; a second child links itself to its parent when it is created,
+	// and a first child is created right after its parent, as it is pushed last
+	class Range
+	{
+	public:
+		uint32_t begin;
+		uint32_t end;
+		uint32_t parent;
+		bool second_child;
+	};
+
+	class Bin
+	{
+	public:
+		glm::vec3 min_coeffs = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 max_coeffs = glm::vec3(-std::numeric_limits<float>::max());
+		uint32_t count = 0;
+	};
+
+	std::vector<Range> stack;
+	stack.push_back({ 0, static_cast<uint32_t>(box_count), 0, false });
+	tree->nodes.reserve(2 * box_count);
+	while (!stack.empty())
+	{
+		const Range range = stack.back();
+		stack.pop_back();
+
+		const uint32_t index = static_cast<uint32_t>(tree->nodes.size());
+		if (range.second_child)
+		{
+			tree->nodes[range.parent].second_child = index;
+		}
+
+		// Bounds of the boxes, and of their centers, which are what is split
+		Node node;
+		node.min_coeffs = glm::vec3(std::numeric_limits<float>::max());
+		node.max_coeffs = glm::vec3(-std::numeric_limits<float>::max());
+		node.first_primitive = range.begin;
+		node.primitive_count = range.end - range.begin;
+		node.second_child = 0;
+		glm::vec3 center_min(std::numeric_limits<float>::max());
+		glm::vec3 center_max(-std::numeric_limits<float>::max());
+		for (uint32_t p = range.begin; p < range.end; p++)
+		{
+			const uint32_t box = tree->primitives[p];
+			node.min_coeffs = glm::min(node.min_coeffs, box_min[box]);
+			node.max_coeffs = glm::max(node.max_coeffs, box_max[box]);
+			center_min = glm::min(center_min, box_centers[box]);
+			center_max = glm::max(center_max, box_centers[box]);
+		}
+
+		tree->nodes.push_back(node);
+		if (node.primitive_count <= 2)
+		{
+			continue;
+		}
+
+		// Find the cheapest split between bins of box centers, over all axes
+		float best_cost = std::numeric_limits<float>::max();
+		int best_axis = -1;
+		int best_split = 0;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float axis_extent = center_max[axis] - center_min[axis];
+			if (axis_extent <= 0)
+			{
+				continue;
+			}
+
+			std::array<Bin, BVH_BIN_COUNT> bins;
+			const float bin_scale = BVH_BIN_COUNT / axis_extent;
+			for (uint32_t p = range.begin; p < range.end; p++)
+			{
+				const uint32_t box = tree->primitives[p];
+				const int b = std::min(static_cast<int>((box_centers[box][axis] - center_min[axis]) * bin_scale), BVH_BIN_COUNT - 1);
+				bins[b].min_coeffs = glm::min(bins[b].min_coeffs, box_min[box]);
+				bins[b].max_coeffs = glm::max(bins[b].max_coeffs, box_max[box]);
+				bins[b].count++;
+			}
+
+			// Sweep from the right to get the cost of every right side, then from the left to combine them
+			std::array<float, BVH_BIN_COUNT> right_costs;
+			Bin right;
+			for (int b = BVH_BIN_COUNT - 1; b > 0; b--)
+			{
+				right.min_coeffs = glm::min(right.min_coeffs, bins[b].min_coeffs);
+				right.max_coeffs = glm::max(right.max_coeffs, bins[b].max_coeffs);
+				right.count += bins[b].count;
+				right_costs[b] = right.count > 0 ? CalculateHalfArea(right.min_coeffs, right.max_coeffs) * right.count : 0;
+			}
+
+			Bin left;
+			for (int b = 0; b < BVH_BIN_COUNT - 1; b++)
+			{
+				left.min_coeffs = glm::min(left.min_coeffs, bins[b].min_coeffs);
+				left.max_coeffs = glm::max(left.max_coeffs, bins[b].max_coeffs);
+				left.count += bins[b].count;
+				const float cost = (left.count > 0 ? CalculateHalfArea(left.min_coeffs, left.max_coeffs) * left.count : 0) + right_costs[b + 1];
+				if (left.count > 0 && left.count < node.primitive_count && cost < best_cost)
+				{
+					best_cost = cost;
+					best_axis = axis;
+					best_split = b + 1;
+				}
+			}
+		}
+
+		// Keep a leaf if splitting costs more than testing all its boxes
+		const float node_area = CalculateHalfArea(node.min_coeffs, node.max_coeffs);
+		const float split_cost = node_area > 0 ? BVH_TRAVERSAL_COST + best_cost / node_area : 0;
+		if (node.primitive_count <= BVH_MAX_LEAF_SIZE && (best_axis < 0 || split_cost >= node.primitive_count))
+		{
+			continue;
+		}
+
+		uint32_t middle;
+		if (best_axis >= 0)
+		{
+			const int axis = best_axis;
+			const float bin_scale = BVH_BIN_COUNT / (center_max[axis] - center_min[axis]);
+			const auto split = std::partition(tree->primitives.begin() + range.begin, tree->primitives.begin() + range.end, [&](uint32_t box)
+			{
+				return std::min(static_cast<int>((box_centers[box][axis] - center_min[axis]) * bin_scale), BVH_BIN_COUNT - 1) < best_split;
+			});
+			middle = static_cast<uint32_t>(split - tree->primitives.begin());
+		}
+		else
+		{
+			// All centers coincide, so any split is as good as another
+			middle = range.begin + node.primitive_count / 2;
+		}
+
+		stack.push_back({ middle, range.end, index, true });
+		stack.push_back({ range.begin, middle, index, false });
+	}
+
+	tree->built_cost = CalculateCost(tree->nodes);
+	return tree;
+}
+
+float BoundingVolumeHierarchy::CalculateCost(const std::vector<Node>& nodes)
+{
+	// Expected cost of a query, with the chance of visiting a node proportional to its surface area
+	if (nodes.empty())
+	{
+		return 0;
+	}
+
+	const float root_area = CalculateHalfArea(nodes[0].min_coeffs, nodes[0].max_coeffs);
+	if (root_area <= 0)
+	{
+		return 0;
+	}
+
+	float cost = 0;
+	for (auto& node : nodes)
+	{
+		const float area = CalculateHalfArea(node.min_coeffs, node.max_coeffs);
+		cost += area * (node.second_child == 0 ? static_cast<float>(node.primitive_count) : BVH_TRAVERSAL_COST);
+	}
+
+	return cost / root_area;
+}
+
+float BoundingVolumeHierarchy::CalculateHalfArea(const glm::vec3& min_coeffs, const glm::vec3& max_coeffs)
+{
+	const glm::vec3 size = max_coeffs - min_coeffs;
+	return size.x * size.y + size.y * size.z + size.z * size.x;
+}
\ No newline at end of file
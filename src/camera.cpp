@@ -103,4 +103,31 @@ glm::mat4 Camera::GetViewTransform() const
 glm::mat4 Camera::GetProjectionTransform() const
 {
 	return glm::perspective(fovy_, aspect_ratio_, z_near_, z_far_);
+}
+
+glm::mat4 Camera::GetObliqueProjectionTransform(const glm::vec4& clip_plane) const
+{
+	// Clip plane in view space
+	const glm::vec4 plane = glm::transpose(glm::inverse(GetViewTransform())) * clip_plane;
+	glm::mat4 projection = GetProjectionTransform();
+
+	// View space corner of the frustum opposite to the plane, which must stay on the far plane
+	glm::vec4 corner;
+	corner.x = (glm::sign(plane.x) + projection[2][0]) / projection[0][0];
+	corner.y = (glm::sign(plane.y) + projection[2][1]) / projection[1][1];
+	corner.z = -1.0f;
+	corner.w = (1.0f + projection[2][2]) / projection[3][2];
+
+	// Replace the third row with the scaled plane, minus the fourth row
+	const glm::vec4 scaled_plane = plane * (2.0f / glm::dot(plane, corner));
+	projection[0][2] = scaled_plane.x - projection[0][3];
+	projection[1][2] = scaled_plane.y - projection[1][3];
+	projection[2][2] = scaled_plane.z - projection[2][3];
+	projection[3][2] = scaled_plane.w - projection[3][3];
+	return projection;
+}
+
+Frustum Camera::GetFrustum(const glm::mat4& model_transform) const
+{
+	return Frustum(GetProjectionTransform() * GetViewTransform() * model_transform);
 }
\ No newline at end of file
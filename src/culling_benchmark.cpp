@@ -0,0 +1,178 @@
+#include "culling_benchmark.h"
+#include "bounding_volume_hierarchy.h"
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <glm/ext.hpp>
+
+// Boxes per unit of volume, and the size of the query boxes
+#define BENCHMARK_BOX_DENSITY 0.01f
+#define BENCHMARK_QUERY_BOX_SIZE 10.0f
+
+namespace
+{
+	double GetMilliseconds(std::chrono::steady_clock::time_point start, size_t query_count)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / static_cast<double>(query_count);
+	}
+}
+
+CullingBenchmark::Result CullingBenchmark::Run(size_t box_count, size_t query_count)
+{
+	// Random boxes in a cube which grows with their number
+	std::mt19937 random(1234);
+	const float size = std::cbrt(static_cast<float>(box_count) / BENCHMARK_BOX_DENSITY);
+	std::uniform_real_distribution<float> position(-0.5f * size, 0.5f * size);
+	std::uniform_real_distribution<float> extent(0.1f, 1.0f);
+	Frustum::BoxList boxes;
+	for (size_t i = 0; i < box_count; i++)
+	{
+		const glm::vec3 center(position(random), position(random), position(random));
+		const glm::vec3 half_size(extent(random), extent(random), extent(random));
+		boxes.Add(center - half_size, center + half_size, glm::mat4(1));
+	}
+
+	// Views from the border of the cube into it, rays through the cube, and boxes inside it
+	std::vector<Frustum> frustums;
+	std::vector<glm::vec3> ray_origins;
+	std::vector<glm::vec3> ray_directions;
+	std::vector<glm::vec3> query_centers;
+	const glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, size);
+	for (size_t q = 0; q < query_count; q++)
+	{
+		const glm::vec3 eye(position(random), position(random), 0.5f * size);
+		const glm::vec3 at(position(random), position(random), 0);
+		frustums.emplace_back(projection * glm::lookAt(eye, at, glm::vec3(0, 1, 0)));
+		ray_origins.push_back(eye);
+		ray_directions.push_back(glm::normalize(at - eye));
+		query_centers.emplace_back(position(random), position(random), position(random));
+	}
+
+	Result result;
+	result.box_count = box_count;
+	result.matches = true;
+
+	auto start = std::chrono::steady_clock::now();
+	BoundingVolumeHierarchy hierarchy;
+	hierarchy.Build(boxes);
+	result.build_ms = GetMilliseconds(start, 1);
+
+	// Frustum culling; the tree is traversed on one thread, so the linear baseline must not use the job system either
+	std::vector<uint8_t> linear_visible;
+	std::vector<uint8_t> tree_visible;
+	size_t linear_count = 0;
+	size_t tree_count = 0;
+	start = std::chrono::steady_clock::now();
+	for (auto& frustum : frustums)
+	{
+		linear_count += frustum.CullBoxesSerial(boxes, linear_visible);
+	}
+
+	result.linear_frustum_ms = GetMilliseconds(start, query_count);
+	start = std::chrono::steady_clock::now();
+	for (auto& frustum : frustums)
+	{
+		tree_count += hierarchy.CullBoxes(frustum, tree_visible);
+	}
+
+	result.tree_frustum_ms = GetMilliseconds(start, query_count);
+	result.matches = result.matches && linear_count == tree_count && linear_visible == tree_visible;
+
+	// Nearest box along rays
+	float linear_distances = 0;
+	float tree_distances = 0;
+	start = std::chrono::steady_clock::now();
+	for (size_t q = 0; q < query_count; q++)
+	{
+		const glm::vec3& origin = ray_origins[q];
+		const glm::vec3 inverse_direction = 1.0f / ray_directions[q];
+		float nearest_distance = std::numeric_limits<float>::max();
+		for (size_t i = 0; i < box_count; i++)
+		{
+			float near_distance = 0;
+			float far_distance = nearest_distance;
+			const float centers[3] = { boxes.center_x[i], boxes.center_y[i], boxes.center_z[i] };
+			const float extents[3] = { boxes.extent_x[i], boxes.extent_y[i], boxes.extent_z[i] };
+			for (int axis = 0; axis < 3; axis++)
+			{
+				const float t0 = (centers[axis] - extents[axis] - origin[axis]) * inverse_direction[axis];
+				const float t1 = (centers[axis] + extents[axis] - origin[axis]) * inverse_direction[axis];
+				near_distance = std::max(near_distance, std::min(t0, t1));
+				far_distance = std::min(far_distance, std::max(t0, t1));
+			}
+
+			if (near_distance <= far_distance)
+			{
+				nearest_distance = near_distance;
+			}
+		}
+
+		linear_distances += nearest_distance < std::numeric_limits<float>::max() ? nearest_distance : 0;
+	}
+
+	result.linear_ray_ms = GetMilliseconds(start, query_count);
+	start = std::chrono::steady_clock::now();
+	for (size_t q = 0; q < query_count; q++)
+	{
+		uint32_t index = 0;
+		float distance = 0;
+		if (hierarchy.IntersectRay(ray_origins[q], ray_directions[q], std::numeric_limits<float>::max(), index, distance))
+		{
+			tree_distances += distance;
+		}
+	}
+
+	result.tree_ray_ms = GetMilliseconds(start, query_count);
+	result.matches = result.matches && std::abs(linear_distances - tree_distances) <= 1e-3f * std::max(linear_distances, 1.0f);
+
+	// Rays without a distance limit must find the same boxes, also when reversed, leaving the cube and mostly missing
+	for (size_t q = 0; q < query_count; q++)
+	{
+		for (float sign : { 1.0f, -1.0f })
+		{
+			uint32_t bounded_index = 0;
+			uint32_t infinite_index = 0;
+			float bounded_distance = 0;
+			float infinite_distance = 0;
+			const glm::vec3 direction = sign * ray_directions[q];
+			const bool bounded_hit = hierarchy.IntersectRay(ray_origins[q], direction, std::numeric_limits<float>::max(), bounded_index, bounded_distance);
+			const bool infinite_hit = hierarchy.IntersectRay(ray_origins[q], direction, std::numeric_limits<float>::infinity(), infinite_index, infinite_distance);
+			result.matches = result.matches && bounded_hit == infinite_hit &&
+				(!bounded_hit || (bounded_index == infinite_index && bounded_distance == infinite_distance));
+		}
+	}
+
+	// Boxes overlapping a box
+	std::vector<uint32_t> indices;
+	size_t linear_overlaps = 0;
+	size_t tree_overlaps = 0;
+	const glm::vec3 query_extent(0.5f * BENCHMARK_QUERY_BOX_SIZE);
+	start = std::chrono::steady_clock::now();
+	for (auto& center : query_centers)
+	{
+		for (size_t i = 0; i < box_count; i++)
+		{
+			if (std::abs(boxes.center_x[i] - center.x) <= boxes.extent_x[i] + query_extent.x &&
+				std::abs(boxes.center_y[i] - center.y) <= boxes.extent_y[i] + query_extent.y &&
+				std::abs(boxes.center_z[i] - center.z) <= boxes.extent_z[i] + query_extent.z)
+			{
+				linear_overlaps++;
+			}
+		}
+	}
+
+	result.linear_box_ms = GetMilliseconds(start, query_count);
+	start = std::chrono::steady_clock::now();
+	for (auto& center : query_centers)
+	{
+		indices.clear();
+		hierarchy.QueryBox(center - query_extent, center + query_extent, indices);
+		tree_overlaps += indices.size();
+	}
+
+	result.tree_box_ms = GetMilliseconds(start, query_count);
+	result.matches = result.matches && linear_overlaps == tree_overlaps;
+
+	return result;
+}
\ No newline at end of file
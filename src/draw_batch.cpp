@@ -0,0 +1,111 @@
+#include "draw_batch.h"
+#include "mesh_arena.h"
+#include "state_cache.h"
+
+DrawBatch::DrawBatch()
+{
+
+}
+
+DrawBatch::~DrawBatch()
+{
+
+}
+
+DrawBatch::DrawList::DrawList(ObjMesh::VertexFormat vertex_format, GLenum index_type) :
+	vertex_format(vertex_format),
+	index_type(index_type)
+{
+
+}
+
+void DrawBatch::Add(const ObjMesh& mesh)
+{
+	if (!mesh.IsLoaded())
+	{
+		return;
+	}
+
+	const ObjMesh::VertexFormat vertex_format = mesh.GetVertexFormat();
+	const GLenum index_type = mesh.GetIndexCount() > 0 ? mesh.GetIndexType() : GL_NONE;
+	const MeshArena::Allocation& allocation = MeshArena::GetInstance(vertex_format).GetAllocation(mesh.GetAllocationId());
+
+	// There are only a few (vertex format, index type) combinations, so a linear search is enough
+	DrawList* draw_list = nullptr;
+	for (auto& list : draw_lists_)
+	{
+		if (list.vertex_format == vertex_format && list.index_type == index_type)
+		{
+			draw_list = &list;
+			break;
+		}
+	}
+
+	if (draw_list == nullptr)
+	{
+		draw_list = &draw_lists_.emplace_back(vertex_format, index_type);
+	}
+
+	// Offsets are read at the time of adding, so the arena must not be compacted before Submit
+	if (index_type != GL_NONE)
+	{
+		draw_list->counts.push_back(mesh.GetIndexCount());
+		draw_list->index_offsets.push_back((const GLvoid*)allocation.index_offset);
+		draw_list->base_vertices.push_back(static_cast<GLint>(allocation.vertex_offset));
+	}
+	else
+	{
+		draw_list->counts.push_back(mesh.GetVertexCount());
+		draw_list->base_vertices.push_back(static_cast<GLint>(allocation.vertex_offset));
+	}
+}
+
+bool DrawBatch::IsEmpty() const
+{
+	return draw_lists_.empty();
+}
+
+size_t DrawBatch::Submit(GLsizei instance_count)
+{
+	size_t draw_calls = 0;
+	for (auto& draw_list : draw_lists_)
+	{
+		StateCache::GetInstance().BindVertexArray(MeshArena::GetInstance(draw_list.vertex_format).GetVertexArray());
+		const GLsizei draw_count = static_cast<GLsizei>(draw_list.counts.size());
+		if (instance_count != 1)
+		{
+			for (GLsizei i = 0; i < draw_count; i++)
+			{
+				if (draw_list.index_type != GL_NONE)
+				{
+					glDrawElementsInstancedBaseVertex(GL_TRIANGLES, draw_list.counts[i], draw_list.index_type,
+						draw_list.index_offsets[i], instance_count, draw_list.base_vertices[i]);
+				}
+				else
+				{
+					glDrawArraysInstanced(GL_TRIANGLES, draw_list.base_vertices[i], draw_list.counts[i], instance_count);
+				}
+			}
+
+			draw_calls += draw_count;
+			continue;
+		}
+
+		if (draw_list.index_type != GL_NONE)
+		{
+			glMultiDrawElementsBaseVertex(GL_TRIANGLES, draw_list.counts.data(), draw_list.index_type,
+				draw_list.index_offsets.data(), draw_count, draw_list.base_vertices.data());
+		}
+		else
+		{
+			// The base vertex is the first vertex of non-indexed draws
+			glMultiDrawArrays(GL_TRIANGLES, draw_list.base_vertices.data(), draw_list.counts.data(), draw_count);
+		}
+
+		draw_calls++;
+	}
+
+	// The vertex array stays bound, so the next batch of the same arena doesn't bind it again
+	draw_lists_.clear();
+	return draw_calls;
+}
\ No newline at end of file
@@ -0,0 +1,103 @@
+#include "free_list_allocator.h"
+#include <iterator>
+#include <limits>
+
+const size_t FreeListAllocator::INVALID_OFFSET = std::numeric_limits<size_t>::max();
+
+FreeListAllocator::FreeListAllocator(size_t capacity)
+{
+	Reset(capacity);
+}
+
+FreeListAllocator::~FreeListAllocator()
+{
+
+}
+
+size_t FreeListAllocator::Allocate(size_t size, size_t alignment)
+{
+	if (size == 0)
+	{
+		return 0;
+	}
+
+	for (auto it = free_blocks_.begin(); it != free_blocks_.end(); ++it)
+	{
+		const size_t block_offset = it->first;
+		const size_t block_size = it->second;
+		const size_t offset = (block_offset + alignment - 1) / alignment * alignment;
+		if (offset + size > block_offset + block_size)
+		{
+			continue;
+		}
+
+		// Keep the alignment padding in front, and the remainder behind the new block, free
+		free_blocks_.erase(it);
+		if (offset > block_offset)
+		{
+			free_blocks_[block_offset] = offset - block_offset;
+		}
+
+		if (offset + size < block_offset + block_size)
+		{
+			free_blocks_[offset + size] = block_offset + block_size - offset - size;
+		}
+
+		used_size_ += size;
+		return offset;
+	}
+
+	return INVALID_OFFSET;
+}
+
+void FreeListAllocator::Free(size_t offset, size_t size)
+{
+	if (size == 0)
+	{
+		return;
+	}
+
+	used_size_ -= size;
+	auto it = free_blocks_.emplace(offset, size).first;
+
+	// Merge with the following free block
+	auto next = std::next(it);
+	if (next != free_blocks_.end() && it->first + it->second == next->first)
+	{
+		it->second += next->second;
+		free_blocks_.erase(next);
+	}
+
+	// Merge with the preceding free block
+	if (it != free_blocks_.begin())
+	{
+		auto previous = std::prev(it);
+		if (previous->first + previous->second == it->first)
+		{
+			previous->second += it->second;
+			free_blocks_.erase(it);
+		}
+	}
+}
+
+void FreeListAllocator::Reset(size_t capacity)
+{
+	free_blocks_.clear();
+	if (capacity > 0)
+	{
+		free_blocks_[0] = capacity;
+	}
+
+	capacity_ = capacity;
+	used_size_ = 0;
+}
+
+size_t FreeListAllocator::GetCapacity() const
+{
+	return capacity_;
+}
+
+size_t FreeListAllocator::GetUsedSize() const
+{
+	return used_size_;
+}
\ No newline at end of file
@@ -0,0 +1,199 @@
+#include "frustum.h"
+#include "job_system.h"
+#include <atomic>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define FRUSTUM_USE_SSE
+#endif
+
+// Boxes per culling job; a multiple of 64, so jobs don't share cache lines of the visibility array
+#define FRUSTUM_CULL_GRAIN 4096
+
+Frustum::BoxList::BoxList()
+{
+
+}
+
+void Frustum::BoxList::Add(const glm::vec3& min_coeffs, const glm::vec3& max_coeffs, const glm::mat4& transform)
+{
+	Resize(GetSize() + 1);
+	Set(GetSize() - 1, min_coeffs, max_coeffs, transform);
+}
+
+void Frustum::BoxList::Set(size_t index, const glm::vec3& min_coeffs, const glm::vec3& max_coeffs, const glm::mat4& transform)
+{
+	const glm::vec3 center = (min_coeffs + max_coeffs) * 0.5f;
+	const glm::vec3 extent = (max_coeffs - min_coeffs) * 0.5f;
+
+	// The extent of the transformed box along each axis is the sum of the absolute projections of its edges (Arvo)
+	const glm::vec3 transformed_center = glm::vec3(transform * glm::vec4(center, 1.0f));
+	glm::vec3 transformed_extent(0);
+	for (int column = 0; column < 3; column++)
+	{
+		transformed_extent += glm::abs(glm::vec3(transform[column])) * extent[column];
+	}
+
+	center_x[index] = transformed_center.x;
+	center_y[index] = transformed_center.y;
+	center_z[index] = transformed_center.z;
+	extent_x[index] = transformed_extent.x;
+	extent_y[index] = transformed_extent.y;
+	extent_z[index] = transformed_extent.z;
+}
+
+void Frustum::BoxList::Resize(size_t size)
+{
+	center_x.resize(size);
+	center_y.resize(size);
+	center_z.resize(size);
+	extent_x.resize(size);
+	extent_y.resize(size);
+	extent_z.resize(size);
+}
+
+void Frustum::BoxList::Clear()
+{
+	center_x.clear();
+	center_y.clear();
+	center_z.clear();
+	extent_x.clear();
+	extent_y.clear();
+	extent_z.clear();
+}
+
+size_t Frustum::BoxList::GetSize() const
+{
+	return center_x.size();
+}
+
+Frustum::Frustum(const glm::mat4& view_projection) :
+	Frustum(ExtractPlanes(view_projection))
+{
+
+}
+
+Frustum::Frustum(const std::array<glm::vec4, 6>& planes) :
+	planes_(planes)
+{
+	// Normalized planes give the signed distance, which is compared against box extents
+	for (auto& plane : planes_)
+	{
+		const float length = glm::length(glm::vec3(plane));
+		if (length > 0)
+		{
+			plane /= length;
+		}
+	}
+}
+
+Frustum::~Frustum()
+{
+
+}
+
+const glm::vec4& Frustum::GetPlane(int index) const
+{
+	return planes_[index];
+}
+
+bool Frustum::IsBoxVisible(const glm::vec3& center, const glm::vec3& extent) const
+{
+	// A box is outside as soon as its corner closest to a plane's inside is behind it
+	for (auto& plane : planes_)
+	{
+		const glm::vec3 normal(plane);
+		if (glm::dot(normal, center) + glm::dot(glm::abs(normal), extent) + plane.w < 0)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+std::array<glm::vec4, 6> Frustum::ExtractPlanes(const glm::mat4& view_projection)
+{
+	// Gribb and Hartmann: every clip space inequality -w <= x,y,z <= w is a plane in the source space
+	const glm::mat4 m = glm::transpose(view_projection);
+	return {
+		m[3] + m[0],
+		m[3] - m[0],
+		m[3] + m[1],
+		m[3] - m[1],
+		m[3] + m[2],
+		m[3] - m[2]
+	};
+}
+
+size_t Frustum::CullBoxes(const BoxList& boxes, std::vector<uint8_t>& visible) const
+{
+	const size_t box_count = boxes.GetSize();
+	visible.resize(box_count);
+
+	std::atomic<size_t> visible_count(0);
+	JobSystem::GetInstance().ParallelFor(box_count, FRUSTUM_CULL_GRAIN, [&](size_t begin, size_t end)
+	{
+		visible_count += CullRange(boxes, begin, end, visible);
+	});
+
+	return visible_count;
+}
+
+size_t Frustum::CullBoxesSerial(const BoxList& boxes, std::vector<uint8_t>& visible) const
+{
+	visible.resize(boxes.GetSize());
+	return CullRange(boxes, 0, boxes.GetSize(), visible);
+}
+
+size_t Frustum::CullRange(const BoxList& boxes, size_t begin, size_t end, std::vector<uint8_t>& visible) const
+{
+	size_t visible_count = 0;
+	size_t i = begin;
+
+#ifdef FRUSTUM_USE_SSE
+	// Test four boxes against one plane at a time
+	const __m128 zero = _mm_setzero_ps();
+	for (; i + 4 <= end; i += 4)
+	{
+		const __m128 center_x = _mm_loadu_ps(&boxes.center_x[i]);
+		const __m128 center_y = _mm_loadu_ps(&boxes.center_y[i]);
+		const __m128 center_z = _mm_loadu_ps(&boxes.center_z[i]);
+		const __m128 extent_x = _mm_loadu_ps(&boxes.extent_x[i]);
+		const __m128 extent_y = _mm_loadu_ps(&boxes.extent_y[i]);
+		const __m128 extent_z = _mm_loadu_ps(&boxes.extent_z[i]);
+
+		__m128 outside = _mm_setzero_ps();
+		for (auto& plane : planes_)
+		{
+			__m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(center_x, _mm_set1_ps(plane.x)), _mm_mul_ps(center_y, _mm_set1_ps(plane.y))),
+				_mm_add_ps(_mm_mul_ps(center_z, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+			const __m128 radius = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(extent_x, _mm_set1_ps(std::abs(plane.x))), _mm_mul_ps(extent_y, _mm_set1_ps(std::abs(plane.y)))),
+				_mm_mul_ps(extent_z, _mm_set1_ps(std::abs(plane.z))));
+			distance = _mm_add_ps(distance, radius);
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, zero));
+		}
+
+		const int outside_mask = _mm_movemask_ps(outside);
+		for (int j = 0; j < 4; j++)
+		{
+			visible[i + j] = (outside_mask & (1 << j)) == 0 ? 1 : 0;
+			visible_count += visible[i + j];
+		}
+	}
+#endif
+
+	// Remaining boxes (or all of them, without SSE)
+	for (; i < end; i++)
+	{
+		const glm::vec3 center(boxes.center_x[i], boxes.center_y[i], boxes.center_z[i]);
+		const glm::vec3 extent(boxes.extent_x[i], boxes.extent_y[i], boxes.extent_z[i]);
+		visible[i] = IsBoxVisible(center, extent) ? 1 : 0;
+		visible_count += visible[i];
+	}
+
+	return visible_count;
+}
\ No newline at end of file
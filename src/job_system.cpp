@@ -0,0 +1,248 @@
+#include "job_system.h"
+#include <algorithm>
+
+// Queue of the current thread: 0 for threads which aren't workers
+static thread_local size_t current_queue_index = 0;
+
+JobSystem::Counter::Counter() :
+	pending_(0)
+{
+
+}
+
+bool JobSystem::Counter::IsDone() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return pending_.load(std::memory_order_relaxed) == 0;
+}
+
+JobSystem::JobSystem(size_t worker_count) :
+	queued_count_(0),
+	stopping_(false)
+{
+	for (size_t i = 0; i <= worker_count; i++)
+	{
+		queues_.push_back(std::make_unique<Queue>());
+	}
+
+	for (size_t i = 0; i < worker_count; i++)
+	{
+		workers_.emplace_back(&JobSystem::WorkerLoop, this, i + 1);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopping_ = true;
+	}
+
+	condition_.notify_all();
+	for (auto& worker : workers_)
+	{
+		worker.join();
+	}
+}
+
+JobSystem& JobSystem::GetInstance()
+{
+	// The thread which calls this keeps a core of its own
+	static JobSystem instance(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+	return instance;
+}
+
+void JobSystem::Run(std::function<void()> function, Counter* counter, Counter* dependency)
+{
+	if (counter != nullptr)
+	{
+		counter->pending_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	Job job{ std::move(function), counter };
+	if (dependency != nullptr)
+	{
+		// Park the job at its dependency, unless that has already finished
+		std::lock_guard<std::mutex> lock(dependency->mutex_);
+		if (dependency->pending_.load(std::memory_order_relaxed) != 0)
+		{
+			dependency->dependents_.push_back(std::move(job));
+			return;
+		}
+	}
+
+	Push(std::move(job));
+}
+
+void JobSystem::RunBackground(std::function<void()> function, Counter* counter)
+{
+	if (counter != nullptr)
+	{
+		counter->pending_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(background_queue_.mutex);
+		background_queue_.jobs.push_back({ std::move(function), counter });
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		queued_count_++;
+	}
+
+	condition_.notify_one();
+}
+
+void JobSystem::Push(Job job)
+{
+	Queue& queue = *queues_[current_queue_index];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(std::move(job));
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		queued_count_++;
+	}
+
+	condition_.notify_one();
+}
+
+bool JobSystem::PopJob(size_t queue_index, bool background, Job& job)
+{
+	// Newest job of the own queue first, as its data is most likely still in cache
+	{
+		Queue& queue = *queues_[queue_index];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.jobs.empty())
+		{
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+			queued_count_--;
+			return true;
+		}
+	}
+
+	// Then steal the oldest job of another queue, which is likely to be the largest piece of work
+	for (size_t i = 1; i < queues_.size(); i++)
+	{
+		Queue& queue = *queues_[(queue_index + i) % queues_.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.jobs.empty())
+		{
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+			queued_count_--;
+			return true;
+		}
+	}
+
+	if (background)
+	{
+		std::lock_guard<std::mutex> lock(background_queue_.mutex);
+		if (!background_queue_.jobs.empty())
+		{
+			job = std::move(background_queue_.jobs.front());
+			background_queue_.jobs.pop_front();
+			queued_count_--;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void JobSystem::Execute(Job& job)
+{
+	job.function();
+
+	Counter* counter = job.counter;
+	if (counter == nullptr)
+	{
+		return;
+	}
+
+	// The decrement and taking out the dependents happen under the lock which IsDone takes, so a waiter can't
+	// return and destroy the counter while it is still used here. The counter isn't touched after the lock
+	std::vector<Job> dependents;
+	{
+		std::lock_guard<std::mutex> lock(counter->mutex_);
+		if (counter->pending_.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		{
+			return;
+		}
+
+		// Last job of the group: start the jobs which depend on it
+		dependents.swap(counter->dependents_);
+	}
+
+	for (auto& dependent : dependents)
+	{
+		Push(std::move(dependent));
+	}
+}
+
+void JobSystem::Wait(Counter& counter)
+{
+	Job job;
+	while (!counter.IsDone())
+	{
+		if (PopJob(current_queue_index, false, job))
+		{
+			Execute(job);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::ParallelFor(size_t count, size_t grain_size, const std::function<void(size_t, size_t)>& body)
+{
+	grain_size = std::max<size_t>(grain_size, 1);
+	if (count <= grain_size || workers_.empty())
+	{
+		body(0, count);
+		return;
+	}
+
+	// The calling thread runs the first range itself, and then helps with the others
+	Counter counter;
+	for (size_t begin = grain_size; begin < count; begin += grain_size)
+	{
+		const size_t end = std::min(begin + grain_size, count);
+		Run([&body, begin, end]() { body(begin, end); }, &counter);
+	}
+
+	body(0, grain_size);
+	Wait(counter);
+}
+
+size_t JobSystem::GetWorkerCount() const
+{
+	return workers_.size();
+}
+
+void JobSystem::WorkerLoop(size_t queue_index)
+{
+	current_queue_index = queue_index;
+	Job job;
+	while (true)
+	{
+		if (PopJob(queue_index, true, job))
+		{
+			Execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mutex_);
+		condition_.wait(lock, [this]() { return stopping_ || queued_count_ > 0; });
+		if (stopping_)
+		{
+			return;
+		}
+	}
+}
\ No newline at end of file
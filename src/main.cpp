@@ -11,14 +11,34 @@
 #include <glm/ext.hpp>
 
 // STL includes
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <string>
 #include <memory>
 
 // Local includes
 #include "material.h"
+#include "bounding_volume_hierarchy.h"
+#include "culling_benchmark.h"
 #include "point_light.h"
 #include "obj_model.h"
+#include "job_system.h"
+#include "mesh_arena.h"
+#include "mesh_library.h"
+#include "mirror.h"
+#include "mirror_portal.h"
+#include "mirror_tree.h"
+#include "model_loader.h"
+#include "occlusion_buffer.h"
+#include "occlusion_query_ring.h"
+#include "render_queue.h"
+#include "render_target.h"
+#include "scene_store.h"
 #include "shader_program.h"
+#include "state_cache.h"
+#include "uniform_blocks.h"
+#include "uniform_ring_buffer.h"
 #include "camera.h"
 
 /**
@@ -29,13 +49,39 @@
 #define PLANE_MODEL_PATH ".//models//obj//plane.obj"
 #define INITIAL_WIDTH 1024
 #define INITIAL_HEIGHT 768
+#define DEFAULT_MIN_MIRROR_PIXELS 64
+#define MODEL_UPLOAD_BUDGET (16 * 1024 * 1024)
+#define MIRROR_QUERY_LATENCY 4
+#define DEFAULT_MIRROR_DEPTH 2
+#define MAX_MIRROR_DEPTH 6
+#define DEFAULT_MIRROR_BUDGET 8
+#define MAX_MIRROR_BUDGET 32
+#define BENCHMARK_QUERY_COUNT 100
+#define OCCLUSION_BUFFER_WIDTH 320
+#define OCCLUSION_BUFFER_HEIGHT 192
+#define UNIFORM_RING_CAPACITY (64 * 1024)
+#define UNIFORM_RING_FRAMES 3
+
+/**
+ * Reflection rendering modes
+ */
+enum ReflectionMode
+{
+    REFLECTION_STENCIL,
+    REFLECTION_INSTANCED,
+    REFLECTION_TEXTURE
+};
 
 /**
  * Function definitions
  */
-void TransformModels(const std::vector<std::shared_ptr<ObjModel>>& models);
-void RenderModels(const std::vector<std::shared_ptr<ObjModel>>& models, const std::shared_ptr<PointLight>& active_light, const glm::vec3& plane_normal, float distance, ShaderProgram& shader_program, bool mirror);
-void RenderPlane(const std::vector<std::shared_ptr<ObjModel>>& models, const std::shared_ptr<PointLight>& active_light, const glm::vec3& position, const glm::vec3& normal, ShaderProgram& shader_program);
+size_t RenderModels(const SceneStore& scene, const std::vector<uint8_t>& visibility, const glm::mat4& reflection, const glm::mat4& view_projection, RenderQueue& render_queue, GLsizei instance_count);
+size_t RenderMirrors(const MirrorTree& mirror_tree, const MirrorTree::Node* parent, const std::vector<std::shared_ptr<Mirror>>& mirrors, const std::vector<std::shared_ptr<ObjModel>>& models, const SceneStore& scene, const glm::mat4& view_projection, UniformRingBuffer& uniform_ring, RenderQueue& render_queue, ShaderProgram& shader_program, const UniformHandle<glm::vec4>& clip_plane_uniform, bool clip);
+void SetMirrorPassState(const MirrorTree::Node* node, ShaderProgram& shader_program, const UniformHandle<glm::vec4>& clip_plane_uniform, bool clip);
+glm::mat4 CalculateWorldTransform(const glm::vec3& plane_normal, float distance, bool mirror);
+void RenderPlane(const std::vector<std::shared_ptr<ObjModel>>& models, const glm::mat4& transform, const glm::mat4& reflection, const glm::mat4& view_projection, UniformRingBuffer& uniform_ring);
+void AddMirrorOccluders(OcclusionBuffer& occlusion_buffer, const std::vector<std::shared_ptr<Mirror>>& mirrors, size_t skipped_mirror, const glm::vec4& plane);
+glm::mat4 CalculatePlaneTransform(const glm::vec3& position, const glm::vec3& normal);
 glm::mat4 CalculateRotationMatrix(const glm::mat4& mat, const glm::vec3& vec1, const glm::vec3& vec2);
 glm::mat4 CalculateReflectionMatrix(const glm::vec3& normal);
 
@@ -44,14 +90,6 @@ glm::mat4 CalculateReflectionMatrix(const glm::vec3& normal);
  */
 int main(int, char**)
 {
-	// Scene objects
-    std::vector<std::shared_ptr<ObjModel>> models;
-    std::vector<std::shared_ptr<PointLight>> point_lights;
-    std::vector<std::shared_ptr<Camera>> cameras;
-    uint32_t active_camera = 0;
-    uint32_t active_light = 0;
-    uint32_t active_model = 1;
-
 	// OpenGL objects
     GLFWwindow* window;
     glm::vec4 clear_color(0.45f, 0.55f, 0.60f, 1.00f);
@@ -90,6 +128,9 @@ int main(int, char**)
         return -1;
     }
 
+    // Redundant state changes are dropped by the state cache, which needs the context to be current
+    StateCache& state_cache = StateCache::GetInstance();
+
     // Setup Dear ImGui context
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -103,156 +144,507 @@ int main(int, char**)
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init(glsl_version);
 
-	// Create shader program
-    ShaderProgram shader_program(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH);
-
-	/**
-	 * Create scene objects
-	 */
-
-	// Plane
-	glm::vec3 plane_position(0, 0, 0);
-	glm::vec3 plane_normal(0, 1, -1);
-    auto plane_model = std::make_shared<ObjModel>(PLANE_MODEL_PATH);
-    models.push_back(plane_model);
-    plane_model->GetMaterial().SetAmbientColor(glm::vec3(0.6,0.6,0.6));
-    plane_model->GetMaterial().SetDiffuseColor(glm::vec3(0.6, 0.6, 0.6));
-
-	// Camera
-	auto camera = std::make_shared<Camera>(
-		glm::vec3(0,0,-6), 
-		glm::vec3(0,0,0), 
-		glm::vec3(0,1,0),
-		float(width) / float(height),
-        0.1f,
-        100);
-
-	// Point light
-	auto point_light = std::make_shared<PointLight>(
-        glm::vec3(0, 0, -8),
-        glm::vec3(0.2, 0.2, 0.2),
-        glm::vec3(0.5, 0.5, 0.5));
-
-	// Move scene objects to corresponding lists
-    cameras.push_back(camera);
-	point_lights.push_back(point_light);
-
-    glEnable(GL_DEPTH_TEST);
-
-    /**
-     * Main loop
-     */
-    while (!glfwWindowShouldClose(window))
+    // Everything which owns GL objects lives in this scope, so it is destroyed while the context is current
     {
-        glfwPollEvents();
+		// Scene objects
+        std::vector<std::shared_ptr<ObjModel>> models;
+        SceneStore scene;
+        std::vector<SceneStore::Entity> model_entities;
+        std::vector<std::shared_ptr<PointLight>> point_lights;
+        std::vector<std::shared_ptr<Camera>> cameras;
+        uint32_t active_camera = 0;
+        uint32_t active_light = 0;
+        uint32_t active_model = 1;
+        ObjMesh::LoadOptions load_options;
+        load_options.release_cpu_data = true;
+        int vertex_format = load_options.vertex_format;
+        ModelLoader model_loader;
+        size_t draw_calls = 0;
+        double scene_update_ms = 0;
+        Frustum::BoxList model_bounds;
+        BoundingVolumeHierarchy model_hierarchy;
+        std::vector<CullingBenchmark::Result> benchmark_results;
+        std::vector<uint8_t> model_visibility;
+        std::vector<uint8_t> mirror_model_visibility;
+        size_t visible_models = 0;
+        size_t mirror_visible_models = 0;
+        OcclusionBuffer occlusion_buffer(OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT);
+        bool occlusion_culling = true;
+        size_t occluded_models = 0;
+        size_t mirror_occluded_models = 0;
+        int min_mirror_pixels = DEFAULT_MIN_MIRROR_PIXELS;
+        float mirror_pixels = 0;
+        bool reflection_visible = true;
+        size_t reflection_frames = 0;
+        size_t portal_skipped_frames = 0;
+        int reflection_mode = REFLECTION_STENCIL;
+        std::vector<uint8_t> instanced_model_visibility;
+        int reflection_scale = 1;
+        bool clip_mirrored_models = true;
+        std::vector<std::shared_ptr<Mirror>> mirrors;
+        MirrorTree mirror_tree;
+        int max_mirror_depth = DEFAULT_MIRROR_DEPTH;
+        int mirror_budget = DEFAULT_MIRROR_BUDGET;
+
+		// Create shader program
+        ShaderProgram shader_program(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH);
+        shader_program.SetUniformBlockBinding("Frame", FRAME_UNIFORMS_BINDING);
+        shader_program.SetUniformBlockBinding("Object", OBJECT_UNIFORMS_BINDING);
+
+		// Uniforms set per pass, resolved once
+        const auto reflection_uniform = shader_program.GetUniformHandle<glm::mat4>("reflection");
+        const auto mirror_quad_uniform = shader_program.GetUniformHandle<glm::mat4>("mirror_quad");
+        const auto mirror_eye_uniform = shader_program.GetUniformHandle<glm::vec3>("mirror_eye");
+        const auto mirror_occludes_uniform = shader_program.GetUniformHandle<GLint>("mirror_occludes");
+        const auto clip_plane_uniform = shader_program.GetUniformHandle<glm::vec4>("clip_plane");
+        const auto reflection_texture_uniform = shader_program.GetUniformHandle<GLint>("reflection_texture");
+        const auto reflection_texture_enabled_uniform = shader_program.GetUniformHandle<GLint>("reflection_texture_enabled");
+
+		// Per-frame and per-object uniform blocks, written to a ring of a few frames so the CPU doesn't wait for the GPU
+        UniformRingBuffer uniform_ring(UNIFORM_RING_CAPACITY, UNIFORM_RING_FRAMES);
+
+		// Draws of every pass are sorted by material, mesh and depth before they are submitted
+        RenderQueue render_queue(uniform_ring);
+
+		// Fragments of the reflection pass: fragment shader invocations if pipeline statistics are supported,
+		// otherwise samples passed (which doesn't count fragments that fail the depth or stencil test). Samples
+		// passed queries can't be nested with the occlusion queries of the mirrors, so the stencil mode needs the former
+        const bool pipeline_statistics = GLEW_ARB_pipeline_statistics_query;
+        OcclusionQueryRing reflection_fragment_queries(MIRROR_QUERY_LATENCY, pipeline_statistics ? GL_FRAGMENT_SHADER_INVOCATIONS_ARB : GL_SAMPLES_PASSED);
+
+		// Reflection texture, for the render to texture mode
+        RenderTarget reflection_target;
+
+		/**
+		 * Create scene objects
+		 */
+
+		// Plane
+		glm::vec3 plane_position(0, 0, 0);
+		glm::vec3 plane_normal(0, 1, -1);
+        auto plane_model = std::make_shared<ObjModel>(PLANE_MODEL_PATH, load_options);
+        models.push_back(plane_model);
+        plane_model->GetMaterial().SetAmbientColor(glm::vec3(0.6,0.6,0.6));
+        plane_model->GetMaterial().SetDiffuseColor(glm::vec3(0.6, 0.6, 0.6));
+
+		// Mirrors: the plane, and two mirrors facing each other at both sides of the models
+        const auto& mirror_bounds = plane_model->GetBoundingBox();
+        const glm::vec3 models_center = glm::normalize(plane_normal) * 2.0f;
+        mirrors.push_back(std::make_shared<Mirror>(mirror_bounds.min_coeffs, mirror_bounds.max_coeffs, CalculatePlaneTransform(plane_position, plane_normal), MIRROR_QUERY_LATENCY));
+        for (float side : { -1.0f, 1.0f })
+        {
+            const glm::mat4 side_transform = glm::translate(glm::mat4(1), models_center + glm::vec3(3.0f * side, 0, 0)) * CalculatePlaneTransform(glm::vec3(0), glm::vec3(-side, 0, 0));
+            mirrors.push_back(std::make_shared<Mirror>(mirror_bounds.min_coeffs, mirror_bounds.max_coeffs, side_transform, MIRROR_QUERY_LATENCY));
+        }
+
+		// Camera
+		auto camera = std::make_shared<Camera>(
+			glm::vec3(0,0,-6), 
+			glm::vec3(0,0,0), 
+			glm::vec3(0,1,0),
+			float(width) / float(height),
+            0.1f,
+            100);
+
+		// Point light
+		auto point_light = std::make_shared<PointLight>(
+            glm::vec3(0, 0, -8),
+            glm::vec3(0.2, 0.2, 0.2),
+            glm::vec3(0.5, 0.5, 0.5));
+
+		// Move scene objects to corresponding lists
+        cameras.push_back(camera);
+		point_lights.push_back(point_light);
+
+        state_cache.SetEnabled(GL_DEPTH_TEST, true);
 
         /**
-         * ImGui stuff
+         * Main loop
          */
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
-        ImGui::Begin("Menu");
-        if (ImGui::Button("Load model..."))
+        while (!glfwWindowShouldClose(window))
         {
-            nfdchar_t* file_path_ptr = NULL;
-            nfdresult_t result = NFD_OpenDialog("obj;png,jpg", NULL, &file_path_ptr);
-            if (result == NFD_OKAY)
+            glfwPollEvents();
+
+            /**
+             * ImGui stuff
+             */
+            ImGui_ImplOpenGL3_NewFrame();
+            ImGui_ImplGlfw_NewFrame();
+            ImGui::NewFrame();
+            ImGui::Begin("Menu");
+            if (ImGui::Button("Load model..."))
             {
-                auto model = std::make_shared<ObjModel>(std::string(file_path_ptr));
-                models.push_back(model);
-                model->GetMaterial().SetAmbientColor(model_color);
-                model->GetMaterial().SetDiffuseColor(model_color);
+                nfdchar_t* file_path_ptr = NULL;
+                nfdresult_t result = NFD_OpenDialog("obj;png,jpg", NULL, &file_path_ptr);
+                if (result == NFD_OKAY)
+                {
+                    model_loader.LoadModelAsync(std::string(file_path_ptr), load_options);
+                    free(file_path_ptr);
+                }
+                else if (result == NFD_CANCEL)
+                {
+            	
+                }
+                else
+                {
+            	
+                }
             }
-            else if (result == NFD_CANCEL)
+    	
+            // Background loads
+            for (auto& job : model_loader.GetPendingJobs())
             {
-            	
+                ImGui::ProgressBar(job->progress.GetFraction(), ImVec2(-1, 0), job->file_path.c_str());
             }
-            else
+
+            ImGui::ColorEdit3("Clear color", (float*)&clear_color);
+            if(ImGui::ColorEdit3("Model color", (float*)&model_color))
             {
-            	
+				for(size_t i = 1; i < models.size(); i++)
+                {
+                    models[i]->GetMaterial().SetAmbientColor(model_color);
+                    models[i]->GetMaterial().SetDiffuseColor(model_color);
+                    scene.SetMaterial(model_entities[i - 1], models[i]->GetMaterial());
+				}
             }
-        }
     	
-        ImGui::ColorEdit3("Clear color", (float*)&clear_color);
-        if(ImGui::ColorEdit3("Model color", (float*)&model_color))
-        {
-			for(size_t i = 1; i < models.size(); i++)
+            // Vertex buffer layout, for comparing memory and frame time
+            const char* vertex_formats[] = { "Float (32 bytes)", "Compact (16 bytes)" };
+            if (ImGui::Combo("Vertex format", &vertex_format, vertex_formats, 2))
             {
-                models[i]->GetMaterial().SetAmbientColor(model_color);
-                models[i]->GetMaterial().SetDiffuseColor(model_color);
-			}
-        }
-    	
-        ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
-        ImGui::End();
-        ImGui::Render();
+                load_options.vertex_format = static_cast<ObjMesh::VertexFormat>(vertex_format);
+                model_loader.SetVertexFormat(load_options.vertex_format);
+                for (auto& model : models)
+                {
+                    if (model->GetVertexFormat() != load_options.vertex_format)
+                    {
+                        model_loader.ReloadModelAsync(model);
+                    }
+                }
+            }
 
-		/**
-		 * Scene rendering
-		 */
+            // Models of the same file share a single mesh
+            MeshLibrary& mesh_library = MeshLibrary::GetInstance();
+            ImGui::Text("Models: %zu, meshes: %zu", models.size(), mesh_library.GetMeshCount());
+            ImGui::Text("Vertex/index buffers: %.1f KB", mesh_library.GetBufferSize() / 1024.0f);
+            for (auto vertex_format : { ObjMesh::STANDARD, ObjMesh::COMPACT })
+            {
+                const MeshArena& arena = MeshArena::GetInstance(vertex_format);
+                ImGui::Text("%s arena: %.1f / %.1f KB", vertex_formats[vertex_format], arena.GetUsedSize() / 1024.0f, arena.GetCapacity() / 1024.0f);
+            }
+
+            ImGui::Text("Draw calls: %zu", draw_calls);
+            ImGui::Text("Scene update and culling: %.3f ms (%zu job workers)", scene_update_ms, JobSystem::GetInstance().GetWorkerCount());
+            ImGui::Text("World transforms updated: %zu of %zu", scene.GetUpdatedCount(), scene.GetSize());
+            ImGui::Text("GL state calls: %zu issued, %zu elided", state_cache.GetIssuedCount(), state_cache.GetElidedCount());
+            ImGui::Text("Uniform ring: %.1f KB/frame, stalls: %zu", uniform_ring.GetFrameCapacity() / 1024.0f, uniform_ring.GetStallCount());
+            ImGui::Text("Visible models: %zu, culled: %zu", visible_models, model_bounds.GetSize() - visible_models);
+            ImGui::Text("Visible mirrored models: %zu, culled: %zu", mirror_visible_models, model_bounds.GetSize() - mirror_visible_models);
+            ImGui::Text("Bounding volume hierarchy: %zu nodes, SAH cost %.2fx built, %zu rebuilds", model_hierarchy.GetNodeCount(), model_hierarchy.GetCostRatio(), model_hierarchy.GetRebuildCount());
+
+            // Models hidden behind the mirrors, found on the CPU before anything is submitted
+            ImGui::Checkbox("Occlusion culling", &occlusion_culling);
+            ImGui::Text("Occluded models: %zu, in mirror passes: %zu (%zu occluder triangles)", occluded_models, mirror_occluded_models, occlusion_buffer.GetTriangleCount());
+
+            // Query times per query of the hierarchy against testing every box, on random boxes
+            if (ImGui::Button("Run culling benchmark"))
+            {
+                benchmark_results.clear();
+                for (size_t box_count : { 1000, 10000, 100000 })
+                {
+                    benchmark_results.push_back(CullingBenchmark::Run(box_count, BENCHMARK_QUERY_COUNT));
+                }
+            }
+
+            for (auto& result : benchmark_results)
+            {
+                ImGui::Text("%zu boxes: build %.2f ms, frustum %.3f / %.3f ms, ray %.3f / %.3f ms, box %.3f / %.3f ms (linear / tree, single-threaded)%s",
+                    result.box_count, result.build_ms, result.linear_frustum_ms, result.tree_frustum_ms, result.linear_ray_ms, result.tree_ray_ms,
+                    result.linear_box_ms, result.tree_box_ms, result.matches ? "" : ", results differ");
+            }
+
+            // Stencil: models and reflections in two passes; instanced: both in one instanced draw per model;
+            // texture: reflections rendered at a lower resolution, and sampled by the mirror plane
+            const char* reflection_modes[] = { "Stencil (two passes)", "Instanced (single pass)", "Texture" };
+            const char* reflection_scales[] = { "Full", "1/2", "1/4" };
+            ImGui::Combo("Reflection", &reflection_mode, reflection_modes, 3);
+            if (reflection_mode == REFLECTION_TEXTURE)
+            {
+                ImGui::Combo("Reflection resolution", &reflection_scale, reflection_scales, 3);
+            }
+
+            // Clipping with gl_ClipDistance skips rasterizing what is reflected to the front of the mirror
+            ImGui::Checkbox("Clip at mirror plane", &clip_mirrored_models);
+            const bool measure_fragments = pipeline_statistics || reflection_mode != REFLECTION_STENCIL;
+            reflection_fragment_queries.CollectResults();
+            if (measure_fragments)
+            {
+                ImGui::Text("Reflection pass %s: %llu", pipeline_statistics ? "fragment shader invocations" : "samples passed",
+                    static_cast<unsigned long long>(reflection_fragment_queries.GetLastResult()));
+            }
+
+            // Below this size, the reflection isn't worth a pass of its own
+            ImGui::SliderInt("Min mirror pixels", &min_mirror_pixels, 0, 10000);
+            ImGui::Text("Mirror: %.0f pixels%s", mirror_pixels, reflection_visible ? "" : " (reflection skipped)");
+
+            // Mirrors seen in mirrors are rendered up to the given depth (stencil mode only; the other modes
+            // reflect the first mirror once), and beyond the budget the passes with the least pixels are dropped
+            if (reflection_mode == REFLECTION_STENCIL)
+            {
+                ImGui::SliderInt("Mirror depth", &max_mirror_depth, 1, MAX_MIRROR_DEPTH);
+                ImGui::SliderInt("Mirror pass budget", &mirror_budget, 1, MAX_MIRROR_BUDGET);
+                ImGui::Text("Mirror passes: %zu, dropped: %zu", mirror_tree.GetPassCount(), mirror_tree.GetDroppedCount());
+            }
 
-    	// Prepare new frame
-        glfwGetFramebufferSize(window, &width, &height);
-        glViewport(0, 0, width, height);
-        glClearColor(clear_color.r, clear_color.g, clear_color.b, clear_color.a);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+            // GPU time of every mirror, including everything seen in it (read back a few frames later)
+            for (size_t i = 0; i < mirrors.size(); i++)
+            {
+                mirrors[i]->GetOcclusionQueries().CollectResults();
+                mirrors[i]->GetTimerQueries().CollectResults();
+                bool mirror_enabled = mirrors[i]->IsEnabled();
+                if (ImGui::Checkbox(("Mirror " + std::to_string(i)).c_str(), &mirror_enabled))
+                {
+                    mirrors[i]->SetEnabled(mirror_enabled);
+                }
+
+                ImGui::SameLine();
+                ImGui::Text("%.3f ms", mirrors[i]->GetTimerQueries().GetLastResult() / 1000000.0);
+            }
+
+            // Frames in which the reflection of the first mirror was skipped, either on the CPU by the portal test, or on
+            // the GPU because no sample of the mirror passed the depth test (counted once the query result is back)
+            ImGui::Text("Reflection skipped: portal %zu, occluded %zu / %zu frames", portal_skipped_frames, mirrors[0]->GetOcclusionQueries().GetOccludedCount(), reflection_frames);
+            ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+            ImGui::End();
+            ImGui::Render();
 
-    	// Reset aspect ratio
-        cameras[active_camera]->SetAspectRatio(static_cast<float>(width) / static_cast<float>(height));
+			/**
+			 * Scene rendering
+			 */
+
+        	// Add models whose background load has completed
+            for (auto& model : model_loader.Update(MODEL_UPLOAD_BUDGET))
+            {
+                model->GetMaterial().SetAmbientColor(model_color);
+                model->GetMaterial().SetDiffuseColor(model_color);
+                models.push_back(model);
+                model_entities.push_back(scene.Create(model->GetMesh(), model->GetMaterial(), model->GetLocalTransform()));
+            }
 
-    	// Set shader program to use
-        shader_program.Use();
+            // Models reloaded in another vertex format render their old mesh up to here
+            for (auto& model : model_loader.GetReloadedModels())
+            {
+                const size_t i = std::find(models.begin(), models.end(), model) - models.begin();
+                if (i > 0 && i < models.size())
+                {
+                    scene.SetMesh(model_entities[i - 1], model->GetMesh());
+                }
+            }
 
-        // Set lights
-        //shader_program.SetUniform("point_light.position", point_lights[active_light]->GetPosition());
-        shader_program.SetUniform("point_light.ambient", point_lights[active_light]->GetAmbientLight());
-        shader_program.SetUniform("point_light.diffuse", point_lights[active_light]->GetDiffuseLight());
+        	// Prepare new frame; ImGui changed state behind the back of the state cache
+            state_cache.BeginFrame();
+            glfwGetFramebufferSize(window, &width, &height);
+            glViewport(0, 0, width, height);
+            glClearColor(clear_color.r, clear_color.g, clear_color.b, clear_color.a);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
-        // Set view and projection transformations
-        shader_program.SetUniform("view", cameras[active_camera]->GetViewTransform());
-        shader_program.SetUniform("projection", cameras[active_camera]->GetProjectionTransform());
+        	// Reset aspect ratio
+            cameras[active_camera]->SetAspectRatio(static_cast<float>(width) / static_cast<float>(height));
 
-		// Rotate models around y-axis  
-        TransformModels(models);
+        	// Set shader program to use
+            shader_program.Use();
 
-    	// Render models
-        RenderModels(models, point_lights[active_light], plane_normal, 2.0f, shader_program, false);
+            // Set view and projection transformations, and lights
+            uniform_ring.BeginFrame();
+            const FrameUniforms frame_uniforms(cameras[active_camera]->GetViewTransform(), cameras[active_camera]->GetProjectionTransform(), *point_lights[active_light]);
+            uniform_ring.BindRange(FRAME_UNIFORMS_BINDING, uniform_ring.Write(&frame_uniforms, sizeof(FrameUniforms), 1), sizeof(FrameUniforms));
 
-    	// Enable stencil test
-        glEnable(GL_STENCIL_TEST);
+			// Rotate models around y-axis  
+            const auto scene_update_start = std::chrono::steady_clock::now();
+            scene.MultiplyLocalTransforms(glm::rotate(glm::mat4(1), glm::pi<float>() / 300, glm::vec3(0, 1, 0)));
 
-    	// Write 1 in stencil buffer at all fragments of the next render (mirror)
-        glStencilFunc(GL_ALWAYS, 1, 0xFF);
-        glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-        glStencilMask(0xFF);
+            // All models share the placement above the plane; they are lit there, and drawn reflected in mirror passes.
+            // Only the entities which moved, or whose parent moved, are updated
+            scene.SetRootTransform(CalculateWorldTransform(plane_normal, 2.0f, false));
+            scene.UpdateWorldTransforms();
 
-    	// Do not write to z-buffer (mirror)
-        glDepthMask(GL_FALSE);
+            // Cull model bounds at their unmirrored placement; the mirrored pass uses the camera
+            // frustum reflected through the mirror plane, instead of reflecting every box. The hierarchy is refitted to the boxes
+            scene.UpdateBounds(model_bounds);
+            model_hierarchy.Update(model_bounds);
 
-    	// Render mirror plane
-        RenderPlane(models, point_lights[active_light], plane_position, plane_normal, shader_program);
+            visible_models = model_hierarchy.CullBoxes(cameras[active_camera]->GetFrustum(), model_visibility);
 
-    	// Set teh stencil test to pass only at fragments which were rendered by the mirror plane
-        glStencilFunc(GL_EQUAL, 1, 0xFF);
+            // Cull the models hidden behind mirrors; in instanced mode the first mirror hides them by discarding instead of by depth
+            occluded_models = 0;
+            mirror_occluded_models = 0;
+            if (occlusion_culling)
+            {
+                occlusion_buffer.Clear(frame_uniforms.view_projection);
+                AddMirrorOccluders(occlusion_buffer, mirrors, mirrors.size(), glm::vec4(0, 0, 0, 1));
+                occlusion_buffer.Rasterize();
+                const size_t unoccluded_models = occlusion_buffer.CullBoxes(model_bounds, model_visibility);
+                occluded_models = visible_models - unoccluded_models;
+                visible_models = unoccluded_models;
+            }
+            scene_update_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - scene_update_start).count();
+
+            // The reflection can only be seen through the mirror quad: skip it if the quad faces away or is
+            // (almost) off screen, and otherwise only draw what is inside the portal frustum through the quad
+            MirrorPortal mirror_portal = mirrors[0]->GetPortal();
+            const glm::mat4& view_projection = frame_uniforms.view_projection;
+            reflection_visible =
+                mirrors[0]->IsEnabled() &&
+                mirror_portal.IsFacing(cameras[active_camera]->GetEye()) &&
+                mirror_portal.Project(view_projection, width, height) &&
+                mirror_portal.GetPixelCount() >= min_mirror_pixels;
+            mirror_pixels = mirror_portal.GetPixelCount();
+            mirror_visible_models = 0;
+            reflection_frames++;
+            portal_skipped_frames += reflection_visible ? 0 : 1;
+
+            if (reflection_visible)
+            {
+                const Frustum reflected_frustum = cameras[active_camera]->GetFrustum(mirrors[0]->GetReflection());
+                const Frustum portal_frustum = mirror_portal.CalculateReflectionFrustum(cameras[active_camera]->GetEye(), reflected_frustum);
+                mirror_visible_models = model_hierarchy.CullBoxes(reflected_frustum, portal_frustum, mirror_model_visibility);
+            }
 
-    	// Do not write to stencil buffer
-        glStencilMask(0x00);
+            if (reflection_mode == REFLECTION_INSTANCED)
+            {
+            	// Render mirror plane first: it doesn't write to z-buffer, and the reflected instances are behind it
+                state_cache.DepthMask(GL_FALSE);
+                RenderPlane(models, mirrors[0]->GetTransform(), glm::mat4(1), view_projection, uniform_ring);
+                state_cache.DepthMask(GL_TRUE);
+                draw_calls = 1;
+
+            	// Render every model together with its reflection; the reflected instance masks itself to the mirror quad
+                const glm::mat4& quad_transform = mirror_portal.GetQuadTransform();
+                shader_program.SetUniform(reflection_uniform, mirrors[0]->GetReflection());
+                shader_program.SetUniform(mirror_quad_uniform, quad_transform);
+                shader_program.SetUniform(mirror_eye_uniform, glm::vec3(quad_transform * glm::vec4(cameras[active_camera]->GetEye(), 1.0f)));
+
+                // Both instances are drawn if either of them is visible
+                instanced_model_visibility = model_visibility;
+                for (size_t i = 0; reflection_visible && i < instanced_model_visibility.size(); i++)
+                {
+                    instanced_model_visibility[i] |= mirror_model_visibility[i];
+                }
+
+                // Only the reflected instance is clipped
+                shader_program.SetUniform(clip_plane_uniform, glm::vec4(0, 0, 0, 1));
+                if (clip_mirrored_models)
+                {
+                    state_cache.SetEnabled(GL_CLIP_DISTANCE0, true);
+                }
+
+                // The mirror plane didn't write depth, so the models behind it have to be hidden by the shader
+                shader_program.SetUniform(mirror_occludes_uniform, 1);
+                reflection_fragment_queries.Begin();
+                draw_calls += RenderModels(scene, instanced_model_visibility, glm::mat4(1), view_projection, render_queue, reflection_visible ? 2 : 1);
+                reflection_fragment_queries.End();
+                shader_program.SetUniform(mirror_occludes_uniform, 0);
+                state_cache.SetEnabled(GL_CLIP_DISTANCE0, false);
+            }
+            else if (reflection_mode == REFLECTION_TEXTURE)
+            {
+            	// Render models
+                draw_calls = RenderModels(scene, model_visibility, glm::mat4(1), view_projection, render_queue, 1);
+
+                if (reflection_visible)
+                {
+                	// Render mirrored objects to the reflection texture, only within the (scaled) screen bounds of the mirror
+                    const int divisor = 1 << reflection_scale;
+                    reflection_target.Resize(std::max(width / divisor, 1), std::max(height / divisor, 1));
+                    reflection_target.Bind();
+                    const glm::ivec4& scissor = mirror_portal.GetScissor();
+                    state_cache.SetEnabled(GL_SCISSOR_TEST, true);
+                    state_cache.Scissor(scissor.x / divisor, scissor.y / divisor, scissor.z / divisor + 2, scissor.w / divisor + 2);
+                    glClearColor(0, 0, 0, 0);
+                    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+                	// Clip at the mirror plane with the near plane, so what is reflected to the front of the mirror is not drawn
+                    const glm::mat4 oblique_view_projection = cameras[active_camera]->GetObliqueProjectionTransform(-mirror_portal.GetPlane()) * cameras[active_camera]->GetViewTransform();
+                    reflection_fragment_queries.Begin();
+                    draw_calls += RenderModels(scene, mirror_model_visibility, mirrors[0]->GetReflection(), oblique_view_projection, render_queue, 1);
+                    reflection_fragment_queries.End();
+
+                    state_cache.SetEnabled(GL_SCISSOR_TEST, false);
+                    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                    glViewport(0, 0, width, height);
+                }
+
+            	// Render mirror plane, with the reflection texture projected onto it
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, reflection_target.GetTexture());
+                shader_program.SetUniform(reflection_texture_uniform, 0);
+                shader_program.SetUniform(reflection_texture_enabled_uniform, reflection_visible ? 1 : 0);
+                RenderPlane(models, mirrors[0]->GetTransform(), glm::mat4(1), view_projection, uniform_ring);
+                shader_program.SetUniform(reflection_texture_enabled_uniform, 0);
+                glBindTexture(GL_TEXTURE_2D, 0);
+                draw_calls++;
+            }
+            else
+            {
+            	// Render models
+                draw_calls = RenderModels(scene, model_visibility, glm::mat4(1), view_projection, render_queue, 1);
+
+                // Find the reflection passes of all mirrors, up to the maximum depth and within the budget
+                mirror_tree.Build(mirrors, *cameras[active_camera], model_hierarchy, width, height, max_mirror_depth, static_cast<float>(min_mirror_pixels), mirror_budget);
+
+                // In the passes of the mirrors seen directly, cull the models hidden behind the other mirrors seen in them,
+                // through the reflected camera; only the mirrors in front of a mirror are seen in it
+                for (size_t i = 0; occlusion_culling && i < mirror_tree.GetRoots().size(); i++)
+                {
+                    const size_t root = mirror_tree.GetRoots()[i];
+                    const MirrorTree::Node& node = mirror_tree.GetNodes()[root];
+                    occlusion_buffer.Clear(view_projection * node.reflection);
+                    AddMirrorOccluders(occlusion_buffer, mirrors, node.mirror, mirrors[node.mirror]->GetPortal().GetPlane());
+                    occlusion_buffer.Rasterize();
+                    mirror_occluded_models += mirror_tree.CullOccluded(root, occlusion_buffer, model_bounds);
+                }
+
+            	// Render mirrors, and recursively what is seen in them
+                state_cache.SetEnabled(GL_STENCIL_TEST, true);
+                if (measure_fragments)
+                {
+                    reflection_fragment_queries.Begin();
+                }
+
+                draw_calls += RenderMirrors(mirror_tree, nullptr, mirrors, models, scene, view_projection, uniform_ring, render_queue, shader_program, clip_plane_uniform, clip_mirrored_models);
+
+                if (measure_fragments)
+                {
+                    reflection_fragment_queries.End();
+                }
+
+            	// Disable stencil test, and allow clearing the stencil buffer again
+                state_cache.StencilMask(0xFF);
+                state_cache.SetEnabled(GL_STENCIL_TEST, false);
+            }
 
-    	// Write to z-buffer, so mirrored objects will appear correctly in mirror
-        glDepthMask(GL_TRUE);
+            // The other modes only reflect the first mirror, so the others are plain planes there
+            if (reflection_mode != REFLECTION_STENCIL)
+            {
+                for (size_t i = 1; i < mirrors.size(); i++)
+                {
+                    RenderPlane(models, mirrors[i]->GetTransform(), glm::mat4(1), view_projection, uniform_ring);
+                    draw_calls++;
+                }
+            }
 
-    	// Render mirrored objects
-        RenderModels(models, point_lights[active_light], plane_normal, 2.0f, shader_program, true);
+            // The uniform blocks of this frame are written
+            uniform_ring.EndFrame();
 
-    	// Disable stencil test
-        glDisable(GL_STENCIL_TEST);
+            // Render ImGui
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
-        // Render ImGui
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        	// Swap buffers
+            glfwSwapBuffers(window);
+        }
 
-    	// Swap buffers
-        glfwSwapBuffers(window);
+        // Meshes are freed below, while the context is current; the arenas don't shrink anymore
+        MeshArena::Shutdown();
     }
 
     /**
@@ -271,106 +663,262 @@ int main(int, char**)
     return 0;
 }
 
-void RenderPlane(const std::vector<std::shared_ptr<ObjModel>>& models, const std::shared_ptr<PointLight>& active_light, const glm::vec3& position, const glm::vec3& normal, ShaderProgram& shader_program)
+void RenderPlane(const std::vector<std::shared_ptr<ObjModel>>& models, const glm::mat4& transform, const glm::mat4& reflection, const glm::mat4& view_projection, UniformRingBuffer& uniform_ring)
 {
     auto model = models[0];
 
-	// Set light position
-	shader_program.SetUniform("point_light.position", active_light->GetPosition());
-	
-    // Set material
-    shader_program.SetUniform("material.ambient", model->GetMaterial().GetAmbientColor());
-    shader_program.SetUniform("material.diffuse", model->GetMaterial().GetDiffuseColor());
-
-	// Scale plane
-	glm::mat4 local_transform = glm::translate(CalculateRotationMatrix(glm::scale(glm::mat4(1), glm::vec3(2, 2, 2)), glm::vec3(0,1,0), normal), position);
-    model->SetLocalTransform(local_transform);
+	// Place plane; it is lit at its unreflected placement, and drawn at the reflected one when it is seen in a mirror
+    model->SetLocalTransform(transform);
 
-    // Update model transform uniform
-    shader_program.SetUniform("model", model->GetModelTransform());
+    // Upload and bind the object uniforms of the plane
+    const ObjectUniforms object_uniforms(model->GetModelTransform(), reflection, view_projection, model->GetMaterial());
+    uniform_ring.BindRange(OBJECT_UNIFORMS_BINDING, uniform_ring.Write(&object_uniforms, sizeof(ObjectUniforms), 1), sizeof(ObjectUniforms));
 
 	// Render
     model->Render();
 }
 
-void TransformModels(const std::vector<std::shared_ptr<ObjModel>>& models)
+void AddMirrorOccluders(OcclusionBuffer& occlusion_buffer, const std::vector<std::shared_ptr<Mirror>>& mirrors, size_t skipped_mirror, const glm::vec4& plane)
+{
+    // Mirror quads are opaque and write depth, so they hide what is behind them
+    static const std::array<uint32_t, 6> quad_indices = { 0, 1, 2, 0, 2, 3 };
+    for (size_t m = 0; m < mirrors.size(); m++)
+    {
+        const auto& corners = mirrors[m]->GetPortal().GetCorners();
+        bool in_front = m != skipped_mirror;
+        for (auto& corner : corners)
+        {
+            in_front = in_front && glm::dot(glm::vec3(plane), corner) + plane.w >= 0;
+        }
+
+        if (in_front)
+        {
+            occlusion_buffer.AddOccluder(corners.data(), corners.size(), quad_indices.data(), quad_indices.size(), glm::mat4(1));
+        }
+    }
+}
+
+size_t RenderModels(
+	const SceneStore& scene,
+	const std::vector<uint8_t>& visibility,
+	const glm::mat4& reflection,
+	const glm::mat4& view_projection,
+	RenderQueue& render_queue,
+	GLsizei instance_count)
 {
-    for (size_t i = 1; i < models.size(); i++)
+    // Only the dense arrays of the scene are read, in order
+    const auto& world_transforms = scene.GetWorldTransforms();
+    const auto& normal_matrices = scene.GetNormalMatrices();
+    const auto& bounds_min = scene.GetBoundsMin();
+    const auto& bounds_max = scene.GetBoundsMax();
+    const auto& meshes = scene.GetMeshes();
+    const auto& material_ids = scene.GetMaterialIds();
+
+    // Consecutive models with the same material and transformation share their uniforms
+    size_t object_index = 0;
+    uint32_t object = 0;
+    bool has_object = false;
+
+    for (size_t i = 0; i < scene.GetSize(); i++)
     {
-        auto model = models[i];
-        auto local_transform = model->GetLocalTransform();
-        local_transform = glm::rotate(local_transform, glm::pi<float>() / 300, glm::vec3(0, 1, 0));
-        model->SetLocalTransform(local_transform);
+        // Skip models outside the frustum of this pass
+        if (meshes[i] == nullptr || !meshes[i]->IsLoaded() || !visibility[i])
+        {
+            continue;
+        }
+
+        const Material& material = scene.GetMaterial(material_ids[i]);
+        if (!has_object || world_transforms[object_index] != world_transforms[i] || material_ids[object_index] != material_ids[i])
+        {
+            object_index = i;
+            object = render_queue.AddObject(ObjectUniforms(world_transforms[i], normal_matrices[i], reflection, view_projection, material));
+            has_object = true;
+        }
+
+        // Sort by material and mesh, and then front to back by the depth of the bounding box center
+        const glm::vec4 center = view_projection * reflection * world_transforms[i] * glm::vec4((bounds_min[i] + bounds_max[i]) * 0.5f, 1.0f);
+        const float depth = center.w > 0 ? center.z / center.w * 0.5f + 0.5f : 0.0f;
+        render_queue.Push(RenderQueue::MakeKey(0, 0, render_queue.GetMaterialId(material), *meshes[i], depth), *meshes[i], object);
     }
+
+    // Every call renders a single pass, whose state is already set
+    render_queue.Sort();
+    return render_queue.Submit(instance_count);
 }
 
-void RenderModels(
+size_t RenderMirrors(
+	const MirrorTree& mirror_tree,
+	const MirrorTree::Node* parent,
+	const std::vector<std::shared_ptr<Mirror>>& mirrors,
 	const std::vector<std::shared_ptr<ObjModel>>& models,
-	const std::shared_ptr<PointLight>& active_light,
-	const glm::vec3& plane_normal,
-	float distance,
+	const SceneStore& scene,
+	const glm::mat4& view_projection,
+	UniformRingBuffer& uniform_ring,
+	RenderQueue& render_queue,
 	ShaderProgram& shader_program,
-	bool mirror)
+	const UniformHandle<glm::vec4>& clip_plane_uniform,
+	bool clip)
 {
-	auto light_position = active_light->GetPosition();
-	glm::vec3 normalized_plane_normal = glm::normalize(plane_normal);
-	float light_distance = glm::dot(active_light->GetPosition(), normalized_plane_normal);
-
-	if (mirror)
+	// The mirrors seen at this level; the stencil value inside them is one more than that of the level
+	const auto& nodes = mirror_tree.GetNodes();
+	const auto& children = parent != nullptr ? parent->children : mirror_tree.GetRoots();
+	const GLint level = parent != nullptr ? parent->level : 0;
+	const glm::mat4 reflection = parent != nullptr ? parent->reflection : glm::mat4(1);
+	StateCache& state_cache = StateCache::GetInstance();
+	size_t draw_calls = 0;
+
+	// Mirrors without a pass of their own are drawn as plain planes
+	SetMirrorPassState(parent, shader_program, clip_plane_uniform, clip);
+	state_cache.StencilFunc(GL_EQUAL, level, 0xFF);
+	state_cache.StencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+	state_cache.StencilMask(0x00);
+	for (size_t m = 0; m < mirrors.size(); m++)
 	{
-		light_position = light_position - 2.0f * light_distance * normalized_plane_normal;
+		bool has_pass = parent != nullptr && parent->mirror == m;
+		for (auto child : children)
+		{
+			has_pass = has_pass || nodes[child].mirror == m;
+		}
+
+		if (!has_pass)
+		{
+			RenderPlane(models, mirrors[m]->GetTransform(), reflection, view_projection, uniform_ring);
+			draw_calls++;
+		}
 	}
 
-	shader_program.SetUniform("point_light.position", glm::vec3(light_position));
+	for (auto child : children)
+	{
+		const MirrorTree::Node& node = nodes[child];
+		Mirror& mirror = *mirrors[node.mirror];
+
+		// Only mirrors which are seen directly are timed and gated by their occlusion query, as neither can be nested
+		const bool timed = parent == nullptr;
+		if (timed)
+		{
+			mirror.GetTimerQueries().Begin();
+		}
 
+		// Mark the visible pixels of the mirror by incrementing their stencil value, without writing to z-buffer
+		state_cache.StencilFunc(GL_EQUAL, level, 0xFF);
+		state_cache.StencilOp(GL_KEEP, GL_KEEP, GL_INCR);
+		state_cache.StencilMask(0xFF);
+		state_cache.DepthMask(GL_FALSE);
+		if (timed)
+		{
+			mirror.GetOcclusionQueries().Begin();
+		}
 
+		RenderPlane(models, mirror.GetTransform(), reflection, view_projection, uniform_ring);
+		if (timed)
+		{
+			mirror.GetOcclusionQueries().End();
 
-    for (size_t i = 1; i < models.size(); i++)
-    {
-        auto model = models[i];
+			// The GPU discards the reflection if the mirror was fully occluded, without the CPU waiting on the query
+			glBeginConditionalRender(mirror.GetOcclusionQueries().GetCurrentQuery(), GL_QUERY_WAIT);
+		}
 
-        // Set material
-        const float factor = mirror ? 1.0 : 1.0;
-        shader_program.SetUniform("material.ambient", factor * model->GetMaterial().GetAmbientColor());
-        shader_program.SetUniform("material.diffuse", factor * model->GetMaterial().GetDiffuseColor());
+		// Reset z-buffer inside the mirror, so the reflection isn't hidden by what is behind the mirror
+		state_cache.StencilFunc(GL_EQUAL, node.level, 0xFF);
+		state_cache.StencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+		state_cache.StencilMask(0x00);
+		state_cache.ColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		state_cache.DepthMask(GL_TRUE);
+		state_cache.DepthFunc(GL_ALWAYS);
+		state_cache.DepthRange(1.0, 1.0);
+		RenderPlane(models, mirror.GetTransform(), reflection, view_projection, uniform_ring);
+		state_cache.DepthRange(0.0, 1.0);
+		state_cache.DepthFunc(GL_LESS);
+		state_cache.ColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+		// Render what is seen in the mirror, and the mirrors seen in it
+		SetMirrorPassState(&node, shader_program, clip_plane_uniform, clip);
+		draw_calls += RenderModels(scene, node.visibility, node.reflection, view_projection, render_queue, 1);
+		draw_calls += RenderMirrors(mirror_tree, &node, mirrors, models, scene, view_projection, uniform_ring, render_queue, shader_program, clip_plane_uniform, clip);
+		if (timed)
+		{
+			glEndConditionalRender();
+		}
 
-    	// Determine y-axis offset
+		// Write the mirror to z-buffer, and restore the stencil value of this level
+		SetMirrorPassState(parent, shader_program, clip_plane_uniform, clip);
+		state_cache.StencilFunc(GL_EQUAL, node.level, 0xFF);
+		state_cache.StencilOp(GL_KEEP, GL_KEEP, GL_DECR);
+		state_cache.StencilMask(0xFF);
+		state_cache.ColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		state_cache.DepthFunc(GL_ALWAYS);
+		RenderPlane(models, mirror.GetTransform(), reflection, view_projection, uniform_ring);
+		state_cache.DepthFunc(GL_LESS);
+		state_cache.ColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		draw_calls += 3;
+
+		if (timed)
+		{
+			mirror.GetTimerQueries().End();
+		}
+	}
 
-		
+	return draw_calls;
+}
 
+void SetMirrorPassState(const MirrorTree::Node* node, ShaderProgram& shader_program, const UniformHandle<glm::vec4>& clip_plane_uniform, bool clip)
+{
+	StateCache& state_cache = StateCache::GetInstance();
 
-		glm::vec3 offset = normalized_plane_normal * distance;
-        glm::mat4 world_transform = glm::mat4(1);
+	// Outside of any mirror, nothing is clipped
+	if (node == nullptr)
+	{
+		state_cache.SetEnabled(GL_SCISSOR_TEST, false);
+		state_cache.SetEnabled(GL_CLIP_DISTANCE0, false);
+		return;
+	}
 
-    	// If requested, mirror across the XZ plane
-        if (mirror)
-        {
-			//glm::mat4 rot = CalculateRotationMatrix(glm::mat4(1), glm::vec3(0, 1, 0), -plane_normal);
+	// Inside a mirror, clip what is in front of it, and draw only within its screen bounds
+	state_cache.SetEnabled(GL_SCISSOR_TEST, true);
+	state_cache.Scissor(node->scissor.x, node->scissor.y, node->scissor.z, node->scissor.w);
+	shader_program.SetUniform(clip_plane_uniform, -node->plane);
+	if (clip)
+	{
+		state_cache.SetEnabled(GL_CLIP_DISTANCE0, true);
+	}
+	else
+	{
+		state_cache.SetEnabled(GL_CLIP_DISTANCE0, false);
+	}
+}
 
-			glm::mat4 reflection = CalculateReflectionMatrix(normalized_plane_normal);
+glm::mat4 CalculateWorldTransform(const glm::vec3& plane_normal, float distance, bool mirror)
+{
+	glm::vec3 normalized_plane_normal = glm::normalize(plane_normal);
 
-			//world_transform = reflection;
+	// Determine offset along the plane normal
+	glm::vec3 offset = normalized_plane_normal * distance;
+	glm::mat4 world_transform = glm::mat4(1);
 
-			world_transform = reflection * glm::translate(glm::mat4(1), offset);
-			//world_transform = rot;
-        }
-		else
-		{
-			world_transform = glm::translate(world_transform, offset);
-		}
+	// If requested, mirror across the plane
+	if (mirror)
+	{
+		//glm::mat4 rot = CalculateRotationMatrix(glm::mat4(1), glm::vec3(0, 1, 0), -plane_normal);
 
-    	// Place the model above the XZ plane
-        //world_transform = glm::translate(world_transform, glm::vec3(0, offset, 0));
+		glm::mat4 reflection = CalculateReflectionMatrix(normalized_plane_normal);
 
-    	// Set world transform
-        model->SetWorldTransform(world_transform);
+		//world_transform = reflection;
 
-    	// Update model transform uniform
-        shader_program.SetUniform("model", model->GetModelTransform());
+		world_transform = reflection * glm::translate(glm::mat4(1), offset);
+		//world_transform = rot;
+	}
+	else
+	{
+		world_transform = glm::translate(world_transform, offset);
+	}
 
-    	// Render
-        model->Render();
-    }
+	return world_transform;
+}
+
+glm::mat4 CalculatePlaneTransform(const glm::vec3& position, const glm::vec3& normal)
+{
+	// Scale plane, and turn its +Y normal to the given normal
+	return glm::translate(CalculateRotationMatrix(glm::scale(glm::mat4(1), glm::vec3(2, 2, 2)), glm::vec3(0,1,0), normal), position);
 }
 
 glm::mat4 CalculateRotationMatrix(const glm::mat4& mat, const glm::vec3& vec1, const glm::vec3& vec2)
@@ -0,0 +1,176 @@
+#include "mapped_file.h"
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& file_path) :
+	data_(nullptr),
+	size_(0),
+	open_(false),
+#ifdef _WIN32
+	file_handle_(INVALID_HANDLE_VALUE),
+	mapping_handle_(nullptr)
+#else
+	file_descriptor_(-1)
+#endif
+{
+	Map(file_path);
+}
+
+MappedFile::~MappedFile()
+{
+	Unmap();
+}
+
+bool MappedFile::IsOpen() const
+{
+	return open_;
+}
+
+const char* MappedFile::GetData() const
+{
+	return data_;
+}
+
+size_t MappedFile::GetSize() const
+{
+	return size_;
+}
+
+#ifdef _WIN32
+
+void MappedFile::Map(const std::string& file_path)
+{
+	file_handle_ = CreateFileA(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file_handle_ == INVALID_HANDLE_VALUE)
+	{
+		std::cerr << "Error opening file for mapping: " << file_path << std::endl;
+		return;
+	}
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file_handle_, &file_size))
+	{
+		std::cerr << "Error querying file size: " << file_path << std::endl;
+		Unmap();
+		return;
+	}
+
+	size_ = static_cast<size_t>(file_size.QuadPart);
+	open_ = true;
+
+	// Empty files cannot be mapped, but are still valid (empty) content
+	if (size_ == 0)
+	{
+		return;
+	}
+
+	mapping_handle_ = CreateFileMappingA(file_handle_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping_handle_ == nullptr)
+	{
+		std::cerr << "Error mapping file: " << file_path << std::endl;
+		Unmap();
+		return;
+	}
+
+	data_ = static_cast<const char*>(MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0));
+	if (data_ == nullptr)
+	{
+		std::cerr << "Error mapping file: " << file_path << std::endl;
+		Unmap();
+	}
+}
+
+void MappedFile::Unmap()
+{
+	if (data_ != nullptr)
+	{
+		UnmapViewOfFile(data_);
+		data_ = nullptr;
+	}
+
+	if (mapping_handle_ != nullptr)
+	{
+		CloseHandle(mapping_handle_);
+		mapping_handle_ = nullptr;
+	}
+
+	if (file_handle_ != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(file_handle_);
+		file_handle_ = INVALID_HANDLE_VALUE;
+	}
+
+	size_ = 0;
+	open_ = false;
+}
+
+#else
+
+void MappedFile::Map(const std::string& file_path)
+{
+	file_descriptor_ = open(file_path.c_str(), O_RDONLY);
+	if (file_descriptor_ < 0)
+	{
+		std::cerr << "Error opening file for mapping: " << file_path << std::endl;
+		return;
+	}
+
+	struct stat file_stat;
+	if (fstat(file_descriptor_, &file_stat) != 0)
+	{
+		std::cerr << "Error querying file size: " << file_path << std::endl;
+		Unmap();
+		return;
+	}
+
+	size_ = static_cast<size_t>(file_stat.st_size);
+	open_ = true;
+
+	// Empty files cannot be mapped, but are still valid (empty) content
+	if (size_ == 0)
+	{
+		return;
+	}
+
+	void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file_descriptor_, 0);
+	if (data == MAP_FAILED)
+	{
+		std::cerr << "Error mapping file: " << file_path << std::endl;
+		Unmap();
+		return;
+	}
+
+	// The file is scanned front to back exactly once
+	madvise(data, size_, MADV_SEQUENTIAL);
+	data_ = static_cast<const char*>(data);
+}
+
+void MappedFile::Unmap()
+{
+	if (data_ != nullptr)
+	{
+		munmap(const_cast<char*>(data_), size_);
+		data_ = nullptr;
+	}
+
+	if (file_descriptor_ >= 0)
+	{
+		close(file_descriptor_);
+		file_descriptor_ = -1;
+	}
+
+	size_ = 0;
+	open_ = false;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,294 @@
+#include "mesh_arena.h"
+#include "state_cache.h"
+#include <algorithm>
+#include <cstddef>
+
+// Initial (and smallest) capacities of the shared buffers
+#define ARENA_MIN_VERTEX_CAPACITY (64 * 1024)
+#define ARENA_MIN_INDEX_CAPACITY (256 * 1024)
+
+// Index offsets must be aligned to the largest index type
+#define ARENA_INDEX_ALIGNMENT sizeof(uint32_t)
+
+MeshArena::Allocation::Allocation() :
+	vertex_offset(0),
+	vertex_count(0),
+	index_offset(0),
+	index_size(0),
+	used(false)
+{
+
+}
+
+MeshArena::MeshArena(ObjMesh::VertexFormat vertex_format) :
+	vertex_format_(vertex_format),
+	vertex_size_(vertex_format == ObjMesh::COMPACT ? sizeof(ObjMesh::CompactVertex) : sizeof(ObjMesh::Vertex)),
+	vao_(0),
+	vbo_(0),
+	ibo_(0),
+	vertex_allocator_(0),
+	index_allocator_(0),
+	shut_down_(false)
+{
+	glGenVertexArrays(1, &vao_);
+	Reallocate(ARENA_MIN_VERTEX_CAPACITY, ARENA_MIN_INDEX_CAPACITY);
+}
+
+MeshArena::~MeshArena()
+{
+	// Nothing is left to delete if the arenas were shut down before the context was destroyed
+	if (!shut_down_)
+	{
+		DeleteObjects();
+	}
+}
+
+MeshArena& MeshArena::GetInstance(ObjMesh::VertexFormat vertex_format)
+{
+	static MeshArena standard_arena(ObjMesh::STANDARD);
+	static MeshArena compact_arena(ObjMesh::COMPACT);
+	return vertex_format == ObjMesh::COMPACT ? compact_arena : standard_arena;
+}
+
+void MeshArena::Shutdown()
+{
+	for (auto vertex_format : { ObjMesh::STANDARD, ObjMesh::COMPACT })
+	{
+		MeshArena& arena = GetInstance(vertex_format);
+		if (!arena.shut_down_)
+		{
+			arena.DeleteObjects();
+			arena.shut_down_ = true;
+		}
+	}
+}
+
+void MeshArena::DeleteObjects()
+{
+	StateCache& state_cache = StateCache::GetInstance();
+	state_cache.DeleteBuffer(vbo_);
+	state_cache.DeleteBuffer(ibo_);
+	state_cache.DeleteVertexArray(vao_);
+	vbo_ = 0;
+	ibo_ = 0;
+	vao_ = 0;
+}
+
+uint32_t MeshArena::Allocate(size_t vertex_count, size_t index_size)
+{
+	// Round index data up to the alignment, so compaction never needs padding between allocations
+	index_size = (index_size + ARENA_INDEX_ALIGNMENT - 1) / ARENA_INDEX_ALIGNMENT * ARENA_INDEX_ALIGNMENT;
+
+	Allocation allocation;
+	allocation.vertex_count = vertex_count;
+	allocation.index_size = index_size;
+	allocation.vertex_offset = vertex_allocator_.Allocate(vertex_count, 1);
+	allocation.index_offset = index_allocator_.Allocate(index_size, ARENA_INDEX_ALIGNMENT);
+
+	if (allocation.vertex_offset == FreeListAllocator::INVALID_OFFSET ||
+		allocation.index_offset == FreeListAllocator::INVALID_OFFSET)
+	{
+		if (allocation.vertex_offset != FreeListAllocator::INVALID_OFFSET)
+		{
+			vertex_allocator_.Free(allocation.vertex_offset, vertex_count);
+		}
+
+		if (allocation.index_offset != FreeListAllocator::INVALID_OFFSET)
+		{
+			index_allocator_.Free(allocation.index_offset, index_size);
+		}
+
+		// Too fragmented or too small: compact, and grow if the live data plus the new mesh don't fit.
+		// Compaction leaves all free space at the end, so the allocation can't fail afterwards.
+		size_t vertex_capacity = vertex_allocator_.GetCapacity();
+		while (vertex_capacity < vertex_allocator_.GetUsedSize() + vertex_count)
+		{
+			vertex_capacity *= 2;
+		}
+
+		size_t index_capacity = index_allocator_.GetCapacity();
+		while (index_capacity < index_allocator_.GetUsedSize() + index_size)
+		{
+			index_capacity *= 2;
+		}
+
+		Reallocate(vertex_capacity, index_capacity);
+		allocation.vertex_offset = vertex_allocator_.Allocate(vertex_count, 1);
+		allocation.index_offset = index_allocator_.Allocate(index_size, ARENA_INDEX_ALIGNMENT);
+	}
+
+	allocation.used = true;
+
+	uint32_t allocation_id = static_cast<uint32_t>(allocations_.size());
+	if (!free_allocation_ids_.empty())
+	{
+		allocation_id = free_allocation_ids_.back();
+		free_allocation_ids_.pop_back();
+		allocations_[allocation_id] = allocation;
+	}
+	else
+	{
+		allocations_.push_back(allocation);
+	}
+
+	return allocation_id;
+}
+
+void MeshArena::Free(uint32_t allocation_id)
+{
+	Allocation& allocation = allocations_[allocation_id];
+	vertex_allocator_.Free(allocation.vertex_offset, allocation.vertex_count);
+	index_allocator_.Free(allocation.index_offset, allocation.index_size);
+	allocation = Allocation();
+	free_allocation_ids_.push_back(allocation_id);
+
+	// The buffers are gone when shutting down, and nothing is loaded anymore
+	if (shut_down_)
+	{
+		return;
+	}
+
+	// Give memory back once the buffers are mostly empty; halving (instead of shrinking to fit)
+	// leaves room for new meshes, so a load right after an unload doesn't reallocate again
+	const size_t vertex_capacity = vertex_allocator_.GetCapacity();
+	const size_t index_capacity = index_allocator_.GetCapacity();
+	if ((vertex_capacity > ARENA_MIN_VERTEX_CAPACITY && vertex_allocator_.GetUsedSize() < vertex_capacity / 4) ||
+		(index_capacity > ARENA_MIN_INDEX_CAPACITY && index_allocator_.GetUsedSize() < index_capacity / 4))
+	{
+		Reallocate(
+			std::max<size_t>(ARENA_MIN_VERTEX_CAPACITY, std::max(vertex_capacity / 2, 2 * vertex_allocator_.GetUsedSize())),
+			std::max<size_t>(ARENA_MIN_INDEX_CAPACITY, std::max(index_capacity / 2, 2 * index_allocator_.GetUsedSize())));
+	}
+}
+
+const MeshArena::Allocation& MeshArena::GetAllocation(uint32_t allocation_id) const
+{
+	return allocations_[allocation_id];
+}
+
+void MeshArena::WriteVertices(uint32_t allocation_id, size_t offset, const void* data, size_t size)
+{
+	// The copy write binding is shadowed by the state cache, and left bound for the next write
+	StateCache::GetInstance().BindBuffer(GL_COPY_WRITE_BUFFER, vbo_);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, allocations_[allocation_id].vertex_offset * vertex_size_ + offset, size, data);
+}
+
+void MeshArena::WriteIndices(uint32_t allocation_id, size_t offset, const void* data, size_t size)
+{
+	StateCache::GetInstance().BindBuffer(GL_COPY_WRITE_BUFFER, ibo_);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, allocations_[allocation_id].index_offset + offset, size, data);
+}
+
+GLuint MeshArena::GetVertexArray() const
+{
+	return vao_;
+}
+
+size_t MeshArena::GetUsedSize() const
+{
+	return vertex_allocator_.GetUsedSize() * vertex_size_ + index_allocator_.GetUsedSize();
+}
+
+size_t MeshArena::GetCapacity() const
+{
+	return vertex_allocator_.GetCapacity() * vertex_size_ + index_allocator_.GetCapacity();
+}
+
+void MeshArena::Reallocate(size_t vertex_capacity, size_t index_capacity)
+{
+	// Create the new buffers; their data is copied from the old ones on the GPU
+	StateCache& state_cache = StateCache::GetInstance();
+	GLuint vbo = 0;
+	glGenBuffers(1, &vbo);
+	state_cache.BindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+	glBufferData(GL_COPY_WRITE_BUFFER, vertex_capacity * vertex_size_, nullptr, GL_STATIC_DRAW);
+
+	GLuint ibo = 0;
+	glGenBuffers(1, &ibo);
+	state_cache.BindBuffer(GL_COPY_WRITE_BUFFER, ibo);
+	glBufferData(GL_COPY_WRITE_BUFFER, index_capacity, nullptr, GL_STATIC_DRAW);
+
+	// Pack live allocations in their current order, which keeps the copies mostly sequential
+	vertex_allocator_.Reset(vertex_capacity);
+	index_allocator_.Reset(index_capacity);
+	for (auto& allocation : allocations_)
+	{
+		if (!allocation.used)
+		{
+			continue;
+		}
+
+		const size_t vertex_offset = vertex_allocator_.Allocate(allocation.vertex_count, 1);
+		const size_t index_offset = index_allocator_.Allocate(allocation.index_size, ARENA_INDEX_ALIGNMENT);
+
+		if (allocation.vertex_count > 0)
+		{
+			state_cache.BindBuffer(GL_COPY_READ_BUFFER, vbo_);
+			state_cache.BindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+				allocation.vertex_offset * vertex_size_, vertex_offset * vertex_size_, allocation.vertex_count * vertex_size_);
+		}
+
+		if (allocation.index_size > 0)
+		{
+			state_cache.BindBuffer(GL_COPY_READ_BUFFER, ibo_);
+			state_cache.BindBuffer(GL_COPY_WRITE_BUFFER, ibo);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+				allocation.index_offset, index_offset, allocation.index_size);
+		}
+
+		allocation.vertex_offset = vertex_offset;
+		allocation.index_offset = index_offset;
+	}
+
+	state_cache.BindBuffer(GL_COPY_READ_BUFFER, 0);
+	state_cache.BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	// Cleanup previous allocated buffers
+	if (vbo_ != 0)
+	{
+		state_cache.DeleteBuffer(vbo_);
+	}
+
+	if (ibo_ != 0)
+	{
+		state_cache.DeleteBuffer(ibo_);
+	}
+
+	vbo_ = vbo;
+	ibo_ = ibo;
+	SetVertexAttributes();
+}
+
+void MeshArena::SetVertexAttributes() const
+{
+	StateCache& state_cache = StateCache::GetInstance();
+	state_cache.BindVertexArray(vao_);
+	state_cache.BindBuffer(GL_ARRAY_BUFFER, vbo_);
+	if (vertex_format_ == ObjMesh::COMPACT)
+	{
+		// Positions are 16-bit normalized (the model is normalized to the unit cube), normals are
+		// packed 10:10:10:2 signed normalized, and uvs are half floats
+		glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, sizeof(ObjMesh::CompactVertex), (GLvoid*)offsetof(ObjMesh::CompactVertex, position));
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(ObjMesh::CompactVertex), (GLvoid*)offsetof(ObjMesh::CompactVertex, normal));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(ObjMesh::CompactVertex), (GLvoid*)offsetof(ObjMesh::CompactVertex, uv));
+		glEnableVertexAttribArray(2);
+	}
+	else
+	{
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ObjMesh::Vertex), (GLvoid*)0);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(ObjMesh::Vertex), (GLvoid*)(3 * sizeof(GLfloat)));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(ObjMesh::Vertex), (GLvoid*)(6 * sizeof(GLfloat)));
+		glEnableVertexAttribArray(2);
+	}
+
+	// Not shadowed, as it belongs to the vertex array, but still counted by the cache
+	state_cache.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_);
+
+	// Unbind vertex array so it won't be altered mistakenly
+	state_cache.BindVertexArray(0);
+}
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include "mesh_cache_file.h"
+#include "utils.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+// Bump whenever the loader output or the file layout changes
+#define MESH_CACHE_VERSION 2
+#define MESH_CACHE_MAGIC "PRMESH\0"
+#define MESH_CACHE_EXTENSION ".meshcache"
+
+MeshCacheFile::MeshCacheFile(const std::string& cache_path) :
+	file_(cache_path),
+	header_(nullptr)
+{
+	static_assert(sizeof(Header) % alignof(ObjMesh::Vertex) == 0, "Vertex data must stay aligned after the header");
+
+	if (file_.IsOpen() && file_.GetSize() >= sizeof(Header))
+	{
+		header_ = reinterpret_cast<const Header*>(file_.GetData());
+	}
+}
+
+MeshCacheFile::~MeshCacheFile()
+{
+
+}
+
+bool MeshCacheFile::IsValid(uint64_t source_key) const
+{
+	if (header_ == nullptr)
+	{
+		return false;
+	}
+
+	if (std::memcmp(header_->magic, MESH_CACHE_MAGIC, sizeof(header_->magic)) != 0 ||
+		header_->version != MESH_CACHE_VERSION ||
+		header_->vertex_size != sizeof(ObjMesh::Vertex) ||
+		header_->source_key != source_key)
+	{
+		return false;
+	}
+
+	// Reject truncated files
+	const uint64_t expected_size =
+		sizeof(Header) +
+		header_->vertex_count * sizeof(ObjMesh::Vertex) +
+		header_->index_count * sizeof(uint32_t);
+
+	return expected_size == file_.GetSize();
+}
+
+const ObjMesh::Vertex* MeshCacheFile::GetVertices() const
+{
+	return reinterpret_cast<const ObjMesh::Vertex*>(file_.GetData() + sizeof(Header));
+}
+
+size_t MeshCacheFile::GetVertexCount() const
+{
+	return static_cast<size_t>(header_->vertex_count);
+}
+
+const uint32_t* MeshCacheFile::GetIndices() const
+{
+	return reinterpret_cast<const uint32_t*>(file_.GetData() + sizeof(Header) + header_->vertex_count * sizeof(ObjMesh::Vertex));
+}
+
+size_t MeshCacheFile::GetIndexCount() const
+{
+	return static_cast<size_t>(header_->index_count);
+}
+
+ObjMesh::BoundingBox MeshCacheFile::GetBoundingBox() const
+{
+	ObjMesh::BoundingBox bounding_box;
+	bounding_box.min_coeffs = glm::vec3(header_->bounding_box_min[0], header_->bounding_box_min[1], header_->bounding_box_min[2]);
+	bounding_box.max_coeffs = glm::vec3(header_->bounding_box_max[0], header_->bounding_box_max[1], header_->bounding_box_max[2]);
+	return bounding_box;
+}
+
+bool MeshCacheFile::Write(
+	const std::string& cache_path,
+	uint64_t source_key,
+	const std::vector<ObjMesh::Vertex>& vertices,
+	const std::vector<uint32_t>& indices,
+	const ObjMesh::BoundingBox& bounding_box)
+{
+	Header header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+	header.version = MESH_CACHE_VERSION;
+	header.vertex_size = sizeof(ObjMesh::Vertex);
+	header.source_key = source_key;
+	header.vertex_count = vertices.size();
+	header.index_count = indices.size();
+	for (int i = 0; i < 3; i++)
+	{
+		header.bounding_box_min[i] = bounding_box.min_coeffs[i];
+		header.bounding_box_max[i] = bounding_box.max_coeffs[i];
+	}
+
+	// Write to a temporary file first, so that a concurrent or interrupted
+	// load never observes a partially written cache
+	const std::string temp_path = cache_path + ".tmp";
+	std::ofstream fs(temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (fs.fail())
+	{
+		std::cerr << "Error writing mesh cache: " << cache_path << std::endl;
+		return false;
+	}
+
+	fs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	fs.write(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(ObjMesh::Vertex));
+	fs.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(uint32_t));
+	fs.close();
+
+	std::error_code error;
+	if (fs.fail())
+	{
+		std::cerr << "Error writing mesh cache: " << cache_path << std::endl;
+		std::filesystem::remove(temp_path, error);
+		return false;
+	}
+
+	std::filesystem::rename(temp_path, cache_path, error);
+	if (error)
+	{
+		std::cerr << "Error writing mesh cache: " << cache_path << std::endl;
+		std::filesystem::remove(temp_path, error);
+		return false;
+	}
+
+	return true;
+}
+
+std::string MeshCacheFile::GetCachePath(const std::string& source_path)
+{
+	return source_path + MESH_CACHE_EXTENSION;
+}
+
+uint64_t MeshCacheFile::CalculateSourceKey(const char* source_data, size_t source_size, uint32_t load_flags)
+{
+	const uint64_t seed = (static_cast<uint64_t>(MESH_CACHE_VERSION) << 32) | load_flags;
+	return Utils::HashBytes(source_data, source_size, seed);
+}
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include "mesh_library.h"
+#include "mapped_file.h"
+#include "mesh_cache_file.h"
+#include <filesystem>
+
+MeshLibrary::MeshLibrary()
+{
+
+}
+
+MeshLibrary& MeshLibrary::GetInstance()
+{
+	static MeshLibrary instance;
+	return instance;
+}
+
+std::shared_ptr<ObjMesh> MeshLibrary::AcquireMesh(const std::string& file_path, const ObjMesh::LoadOptions& load_options)
+{
+	// The same file may be opened through different relative paths
+	const std::string path = GetCanonicalPath(file_path);
+	const uint64_t source_key = GetSourceKey(path, load_options);
+	const std::string key = CalculateKey(path, load_options, source_key);
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto mesh = meshes_[key].lock();
+	if (mesh == nullptr)
+	{
+		mesh = std::make_shared<ObjMesh>(file_path, load_options, source_key);
+		meshes_[key] = mesh;
+	}
+
+	// A load of a mesh which is already loading reports the progress of the running load
+	if (load_options.progress != nullptr)
+	{
+		mesh->AttachProgress(load_options.progress);
+	}
+
+	// Forget meshes which are no longer referenced by any model
+	for (auto it = meshes_.begin(); it != meshes_.end();)
+	{
+		if (it->second.expired())
+		{
+			it = meshes_.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	return mesh;
+}
+
+size_t MeshLibrary::GetMeshCount()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	size_t mesh_count = 0;
+	for (auto& [key, weak_mesh] : meshes_)
+	{
+		if (!weak_mesh.expired())
+		{
+			mesh_count++;
+		}
+	}
+
+	return mesh_count;
+}
+
+size_t MeshLibrary::GetBufferSize()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	size_t buffer_size = 0;
+	for (auto& [key, weak_mesh] : meshes_)
+	{
+		if (auto mesh = weak_mesh.lock())
+		{
+			buffer_size += mesh->GetBufferSize();
+		}
+	}
+
+	return buffer_size;
+}
+
+uint64_t MeshLibrary::GetSourceKey(const std::string& path, const ObjMesh::LoadOptions& load_options)
+{
+	// Only hash the content again when the file changed on disk since it was last hashed
+	const uint32_t cache_flags = ObjMesh::GetCacheFlags(load_options);
+	const std::string key = path + "|" + std::to_string(cache_flags);
+	std::error_code time_error;
+	std::error_code size_error;
+	const auto write_time = std::filesystem::last_write_time(path, time_error);
+	const auto file_size = std::filesystem::file_size(path, size_error);
+	const bool stat_valid = !time_error && !size_error;
+	if (stat_valid)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto it = source_keys_.find(key);
+		if (it != source_keys_.end() && it->second.write_time == write_time && it->second.file_size == file_size)
+		{
+			return it->second.key;
+		}
+	}
+
+	if (load_options.progress != nullptr)
+	{
+		load_options.progress->stage = ObjMesh::HASHING;
+	}
+
+	// Hash outside of the lock, so other files can be acquired meanwhile
+	uint64_t source_key = 0;
+	{
+		MappedFile source_file(path);
+		source_key = MeshCacheFile::CalculateSourceKey(source_file.GetData(), source_file.GetSize(), cache_flags);
+	}
+
+	if (stat_valid)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		source_keys_[key] = { write_time, file_size, source_key };
+	}
+
+	return source_key;
+}
+
+std::string MeshLibrary::GetCanonicalPath(const std::string& file_path)
+{
+	std::error_code error;
+	auto canonical_path = std::filesystem::weakly_canonical(file_path, error);
+	return error ? file_path : canonical_path.string();
+}
+
+std::string MeshLibrary::CalculateKey(const std::string& path, const ObjMesh::LoadOptions& load_options, uint64_t source_key)
+{
+	// The source key covers the content and the data changing options; the rest only changes how the mesh is kept
+	return path + "|" + std::to_string(source_key) +
+		"|" + std::to_string(load_options.vertex_format) +
+		"|" + std::to_string(load_options.release_cpu_data);
+}
\ No newline at end of file
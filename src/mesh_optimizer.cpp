@@ -0,0 +1,358 @@
+#include "mesh_optimizer.h"
+#include "utils.h"
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+#define INVALID_VERTEX std::numeric_limits<uint32_t>::max()
+
+std::vector<uint32_t> MeshOptimizer::OptimizeVertexCache(
+	const std::vector<uint32_t>& indices,
+	size_t vertex_count,
+	size_t cache_size,
+	std::vector<uint32_t>* clusters)
+{
+	const size_t triangle_count = indices.size() / 3;
+
+	// Build vertex to triangle adjacency in compressed (offset + list) form
+	std::vector<uint32_t> adjacency_offsets(vertex_count + 1, 0);
+	for (auto index : indices)
+	{
+		adjacency_offsets[index + 1]++;
+	}
+
+	std::partial_sum(adjacency_offsets.begin(), adjacency_offsets.end(), adjacency_offsets.begin());
+
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> live_triangles(vertex_count);
+	std::vector<uint32_t> fill_offsets(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		adjacency[fill_offsets[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	for (size_t v = 0; v < vertex_count; v++)
+	{
+		live_triangles[v] = adjacency_offsets[v + 1] - adjacency_offsets[v];
+	}
+
+	std::vector<uint32_t> cache_timestamps(vertex_count, 0);
+	std::vector<bool> emitted(triangle_count, false);
+	std::vector<uint32_t> dead_end;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> result;
+	dead_end.reserve(indices.size());
+	result.reserve(indices.size());
+
+	if (clusters != nullptr)
+	{
+		clusters->clear();
+	}
+
+	uint32_t timestamp = static_cast<uint32_t>(cache_size) + 1;
+	size_t input_cursor = 0;
+	uint32_t current_vertex = INVALID_VERTEX;
+
+	// Start from the first vertex which is referenced by any triangle
+	for (; input_cursor < vertex_count; input_cursor++)
+	{
+		if (live_triangles[input_cursor] > 0)
+		{
+			current_vertex = static_cast<uint32_t>(input_cursor);
+			if (clusters != nullptr)
+			{
+				clusters->push_back(0);
+			}
+			break;
+		}
+	}
+
+	while (current_vertex != INVALID_VERTEX)
+	{
+		// Emit all remaining triangles around the fanning vertex
+		candidates.clear();
+		for (uint32_t k = adjacency_offsets[current_vertex]; k < adjacency_offsets[current_vertex + 1]; k++)
+		{
+			const uint32_t triangle = adjacency[k];
+			if (emitted[triangle])
+			{
+				continue;
+			}
+
+			for (int j = 0; j < 3; j++)
+			{
+				const uint32_t v = indices[3 * triangle + j];
+				result.push_back(v);
+				dead_end.push_back(v);
+				candidates.push_back(v);
+				live_triangles[v]--;
+
+				// Count a cache miss if the vertex is no longer in the FIFO
+				if (timestamp - cache_timestamps[v] > cache_size)
+				{
+					cache_timestamps[v] = timestamp++;
+				}
+			}
+
+			emitted[triangle] = true;
+		}
+
+		// Prefer the candidate that entered the cache earliest, and will still be in it after fanning around it
+		uint32_t next_vertex = INVALID_VERTEX;
+		int64_t best_priority = -1;
+		for (auto v : candidates)
+		{
+			if (live_triangles[v] == 0)
+			{
+				continue;
+			}
+
+			int64_t priority = 0;
+			if (timestamp - cache_timestamps[v] + 2 * live_triangles[v] <= cache_size)
+			{
+				priority = timestamp - cache_timestamps[v];
+			}
+
+			if (priority > best_priority)
+			{
+				best_priority = priority;
+				next_vertex = v;
+			}
+		}
+
+		if (next_vertex != INVALID_VERTEX)
+		{
+			current_vertex = next_vertex;
+			continue;
+		}
+
+		// Dead end: fall back to the most recently referenced vertex with live triangles
+		while (!dead_end.empty() && next_vertex == INVALID_VERTEX)
+		{
+			const uint32_t v = dead_end.back();
+			dead_end.pop_back();
+			if (live_triangles[v] > 0)
+			{
+				next_vertex = v;
+			}
+		}
+
+		// Otherwise, continue with the next vertex in input order
+		for (; input_cursor < vertex_count && next_vertex == INVALID_VERTEX; input_cursor++)
+		{
+			if (live_triangles[input_cursor] > 0)
+			{
+				next_vertex = static_cast<uint32_t>(input_cursor);
+			}
+		}
+
+		// Every dead end skip breaks locality, which starts a new cluster
+		if (next_vertex != INVALID_VERTEX && clusters != nullptr)
+		{
+			clusters->push_back(static_cast<uint32_t>(result.size() / 3));
+		}
+
+		current_vertex = next_vertex;
+	}
+
+	return result;
+}
+
+std::vector<uint32_t> MeshOptimizer::GenerateSoftBoundaries(
+	const std::vector<uint32_t>& indices,
+	size_t vertex_count,
+	const std::vector<uint32_t>& clusters,
+	size_t cache_size,
+	float threshold)
+{
+	const size_t triangle_count = indices.size() / 3;
+	std::vector<size_t> cache_timestamps(vertex_count, 0);
+	size_t timestamp = cache_size + 1;
+	std::vector<uint32_t> soft_clusters;
+
+	// Simulate a FIFO cache; returns the number of misses of a single triangle
+	auto simulate_triangle = [&](size_t triangle)
+	{
+		uint32_t misses = 0;
+		for (int j = 0; j < 3; j++)
+		{
+			const uint32_t v = indices[3 * triangle + j];
+			if (timestamp - cache_timestamps[v] > cache_size)
+			{
+				cache_timestamps[v] = timestamp++;
+				misses++;
+			}
+		}
+
+		return misses;
+	};
+
+	// Flushing the cache is done by moving the clock forward past every cached entry
+	auto flush_cache = [&]()
+	{
+		timestamp += cache_size + 1;
+	};
+
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		const size_t start = clusters[c];
+		const size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangle_count;
+
+		// Cache efficiency of the whole hard cluster
+		flush_cache();
+		size_t cluster_misses = 0;
+		for (size_t t = start; t < end; t++)
+		{
+			cluster_misses += simulate_triangle(t);
+		}
+
+		const float cluster_acmr = static_cast<float>(cluster_misses) / static_cast<float>(end - start);
+
+		// Split as soon as the running ACMR of the current sub-cluster is good enough
+		flush_cache();
+		soft_clusters.push_back(static_cast<uint32_t>(start));
+		size_t sub_cluster_start = start;
+		size_t sub_cluster_misses = 0;
+		for (size_t t = start; t < end; t++)
+		{
+			sub_cluster_misses += simulate_triangle(t);
+			const size_t sub_cluster_size = t + 1 - sub_cluster_start;
+
+			if (t + 1 < end && sub_cluster_misses <= sub_cluster_size * cluster_acmr * threshold)
+			{
+				soft_clusters.push_back(static_cast<uint32_t>(t + 1));
+				sub_cluster_start = t + 1;
+				sub_cluster_misses = 0;
+				flush_cache();
+			}
+		}
+	}
+
+	return soft_clusters;
+}
+
+std::vector<uint32_t> MeshOptimizer::OptimizeOverdraw(
+	const std::vector<uint32_t>& indices,
+	const std::vector<glm::vec3>& positions,
+	const std::vector<uint32_t>& clusters,
+	size_t cache_size,
+	float threshold)
+{
+	const size_t triangle_count = indices.size() / 3;
+	if (triangle_count == 0 || clusters.empty())
+	{
+		return indices;
+	}
+
+	const auto soft_clusters = GenerateSoftBoundaries(indices, positions.size(), clusters, cache_size, threshold);
+	const size_t cluster_count = soft_clusters.size();
+
+	// Area weighted centroid and average normal of every cluster, and the centroid of the entire mesh
+	std::vector<glm::vec3> cluster_centroids(cluster_count, glm::vec3(0));
+	std::vector<glm::vec3> cluster_normals(cluster_count, glm::vec3(0));
+	glm::vec3 mesh_centroid(0);
+	float mesh_area = 0;
+
+	for (size_t c = 0; c < cluster_count; c++)
+	{
+		const size_t start = soft_clusters[c];
+		const size_t end = c + 1 < cluster_count ? soft_clusters[c + 1] : triangle_count;
+
+		float cluster_area = 0;
+		for (size_t t = start; t < end; t++)
+		{
+			const glm::vec3& p0 = positions[indices[3 * t + 0]];
+			const glm::vec3& p1 = positions[indices[3 * t + 1]];
+			const glm::vec3& p2 = positions[indices[3 * t + 2]];
+
+			const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			const float area = glm::length(normal);
+
+			cluster_centroids[c] += (p0 + p1 + p2) * (area / 3.0f);
+			cluster_normals[c] += normal;
+			cluster_area += area;
+		}
+
+		mesh_centroid += cluster_centroids[c];
+		mesh_area += cluster_area;
+
+		if (cluster_area > 0)
+		{
+			cluster_centroids[c] /= cluster_area;
+		}
+	}
+
+	if (mesh_area > 0)
+	{
+		mesh_centroid /= mesh_area;
+	}
+
+	// Clusters facing away from the mesh center are likely to occlude others, so draw them first
+	std::vector<float> sort_keys(cluster_count, 0);
+	for (size_t c = 0; c < cluster_count; c++)
+	{
+		const float normal_length = glm::length(cluster_normals[c]);
+		if (normal_length > 0)
+		{
+			sort_keys[c] = glm::dot(cluster_centroids[c] - mesh_centroid, cluster_normals[c] / normal_length);
+		}
+	}
+
+	std::vector<uint32_t> cluster_order(cluster_count);
+	std::iota(cluster_order.begin(), cluster_order.end(), 0);
+	std::stable_sort(cluster_order.begin(), cluster_order.end(), [&sort_keys](uint32_t a, uint32_t b)
+	{
+		return sort_keys[a] > sort_keys[b];
+	});
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	for (auto c : cluster_order)
+	{
+		const size_t start = soft_clusters[c];
+		const size_t end = c + 1 < cluster_count ? soft_clusters[c + 1] : triangle_count;
+		result.insert(result.end(), indices.begin() + 3 * start, indices.begin() + 3 * end);
+	}
+
+	return result;
+}
+
+std::vector<uint32_t> MeshOptimizer::OptimizeVertexFetch(std::vector<uint32_t>& indices, size_t vertex_count, size_t& unique_vertex_count)
+{
+	std::vector<uint32_t> remap(vertex_count, INVALID_VERTEX);
+	uint32_t next_vertex = 0;
+
+	for (auto& index : indices)
+	{
+		if (remap[index] == INVALID_VERTEX)
+		{
+			remap[index] = next_vertex++;
+		}
+
+		index = remap[index];
+	}
+
+	unique_vertex_count = next_vertex;
+	return remap;
+}
+
+float MeshOptimizer::CalculateAcmr(const std::vector<uint32_t>& indices, size_t cache_size)
+{
+	const size_t triangle_count = indices.size() / 3;
+	if (triangle_count == 0)
+	{
+		return 0;
+	}
+
+	return static_cast<float>(Utils::SimulateVertexCache(indices, cache_size)) / static_cast<float>(triangle_count);
+}
+
+float MeshOptimizer::CalculateAtvr(const std::vector<uint32_t>& indices, size_t vertex_count, size_t cache_size)
+{
+	if (vertex_count == 0)
+	{
+		return 0;
+	}
+
+	return static_cast<float>(Utils::SimulateVertexCache(indices, cache_size)) / static_cast<float>(vertex_count);
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include "mirror.h"
+
+Mirror::Mirror(const glm::vec3& min_coeffs, const glm::vec3& max_coeffs, const glm::mat4& transform, size_t query_latency) :
+	transform_(transform),
+	portal_(min_coeffs, max_coeffs, transform),
+	reflection_(1.0f),
+	enabled_(true),
+	occlusion_queries_(query_latency, GL_ANY_SAMPLES_PASSED),
+	timer_queries_(query_latency, GL_TIME_ELAPSED)
+{
+	// x' = x - 2 * (dot(n, x) + d) * n, for the normalized plane (n, d)
+	const glm::vec4& plane = portal_.GetPlane();
+	const glm::vec3 normal(plane);
+	for (int column = 0; column < 3; column++)
+	{
+		glm::vec3 axis(0);
+		axis[column] = 1.0f;
+		reflection_[column] = glm::vec4(axis - 2.0f * normal[column] * normal, 0.0f);
+	}
+
+	reflection_[3] = glm::vec4(-2.0f * plane.w * normal, 1.0f);
+}
+
+Mirror::~Mirror()
+{
+
+}
+
+const glm::mat4& Mirror::GetTransform() const
+{
+	return transform_;
+}
+
+const MirrorPortal& Mirror::GetPortal() const
+{
+	return portal_;
+}
+
+const glm::mat4& Mirror::GetReflection() const
+{
+	return reflection_;
+}
+
+void Mirror::SetEnabled(bool enabled)
+{
+	enabled_ = enabled;
+}
+
+bool Mirror::IsEnabled() const
+{
+	return enabled_;
+}
+
+OcclusionQueryRing& Mirror::GetOcclusionQueries()
+{
+	return occlusion_queries_;
+}
+
+OcclusionQueryRing& Mirror::GetTimerQueries()
+{
+	return timer_queries_;
+}
\ No newline at end of file
@@ -0,0 +1,184 @@
+#include "mirror_portal.h"
+#include <algorithm>
+#include <cmath>
+
+// Clip space w below which a point counts as behind the camera
+#define PORTAL_NEAR_W 1e-5f
+
+MirrorPortal::MirrorPortal(const glm::vec3& min_coeffs, const glm::vec3& max_coeffs, const glm::mat4& transform) :
+	pixel_count_(0),
+	scissor_(0, 0, 0, 0)
+{
+	const float y = (min_coeffs.y + max_coeffs.y) * 0.5f;
+	corners_[0] = glm::vec3(transform * glm::vec4(min_coeffs.x, y, min_coeffs.z, 1.0f));
+	corners_[1] = glm::vec3(transform * glm::vec4(max_coeffs.x, y, min_coeffs.z, 1.0f));
+	corners_[2] = glm::vec3(transform * glm::vec4(max_coeffs.x, y, max_coeffs.z, 1.0f));
+	corners_[3] = glm::vec3(transform * glm::vec4(min_coeffs.x, y, max_coeffs.z, 1.0f));
+
+	// Local Z cross X is local +Y
+	const glm::vec3 normal = glm::normalize(glm::cross(corners_[3] - corners_[0], corners_[1] - corners_[0]));
+	plane_ = glm::vec4(normal, -glm::dot(normal, corners_[0]));
+	quad_transform_ = glm::inverse(glm::mat4(
+		glm::vec4(corners_[1] - corners_[0], 0.0f),
+		glm::vec4(normal, 0.0f),
+		glm::vec4(corners_[3] - corners_[0], 0.0f),
+		glm::vec4(corners_[0], 1.0f)));
+}
+
+MirrorPortal::~MirrorPortal()
+{
+
+}
+
+const glm::vec4& MirrorPortal::GetPlane() const
+{
+	return plane_;
+}
+
+const std::array<glm::vec3, 4>& MirrorPortal::GetCorners() const
+{
+	return corners_;
+}
+
+const glm::mat4& MirrorPortal::GetQuadTransform() const
+{
+	return quad_transform_;
+}
+
+bool MirrorPortal::IsFacing(const glm::vec3& eye) const
+{
+	return glm::dot(glm::vec3(plane_), eye) + plane_.w > 0;
+}
+
+bool MirrorPortal::Project(const glm::mat4& view_projection, int width, int height)
+{
+	pixel_count_ = 0;
+	scissor_ = glm::ivec4(0, 0, 0, 0);
+
+	// Clip the quad against the camera plane in clip space, so corners behind the camera don't flip
+	std::vector<glm::vec4> clip_corners;
+	for (size_t i = 0; i < corners_.size(); i++)
+	{
+		const glm::vec4 current = view_projection * glm::vec4(corners_[i], 1.0f);
+		const glm::vec4 next = view_projection * glm::vec4(corners_[(i + 1) % corners_.size()], 1.0f);
+		if (current.w > PORTAL_NEAR_W)
+		{
+			clip_corners.push_back(current);
+		}
+
+		if ((current.w > PORTAL_NEAR_W) != (next.w > PORTAL_NEAR_W))
+		{
+			const float t = (PORTAL_NEAR_W - current.w) / (next.w - current.w);
+			clip_corners.push_back(current + (next - current) * t);
+		}
+	}
+
+	// Project to window coordinates, and clip to the viewport
+	std::vector<glm::vec2> polygon;
+	for (auto& corner : clip_corners)
+	{
+		const glm::vec2 ndc = glm::vec2(corner) / corner.w;
+		polygon.push_back(glm::vec2((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height));
+	}
+
+	polygon = ClipPolygon(polygon, 0, 0.0f, false);
+	polygon = ClipPolygon(polygon, 0, static_cast<float>(width), true);
+	polygon = ClipPolygon(polygon, 1, 0.0f, false);
+	polygon = ClipPolygon(polygon, 1, static_cast<float>(height), true);
+	if (polygon.size() < 3)
+	{
+		return false;
+	}
+
+	// Shoelace formula for the area, and the bounds for the scissor rectangle
+	glm::vec2 min_coeffs = polygon[0];
+	glm::vec2 max_coeffs = polygon[0];
+	float area = 0;
+	for (size_t i = 0; i < polygon.size(); i++)
+	{
+		const glm::vec2& current = polygon[i];
+		const glm::vec2& next = polygon[(i + 1) % polygon.size()];
+		area += current.x * next.y - next.x * current.y;
+		min_coeffs = glm::min(min_coeffs, current);
+		max_coeffs = glm::max(max_coeffs, current);
+	}
+
+	pixel_count_ = std::abs(area) * 0.5f;
+	const glm::ivec2 scissor_min = glm::ivec2(glm::floor(min_coeffs));
+	const glm::ivec2 scissor_max = glm::ivec2(glm::ceil(max_coeffs));
+	scissor_ = glm::ivec4(scissor_min, scissor_max - scissor_min);
+	return pixel_count_ > 0;
+}
+
+float MirrorPortal::GetPixelCount() const
+{
+	return pixel_count_;
+}
+
+const glm::ivec4& MirrorPortal::GetScissor() const
+{
+	return scissor_;
+}
+
+Frustum MirrorPortal::CalculateReflectionFrustum(const glm::vec3& eye, const Frustum& reflected_camera_frustum) const
+{
+	// The quad lies on the mirror plane, so it is its own reflection
+	const glm::vec3 normal(plane_);
+	const glm::vec3 reflected_eye = eye - 2.0f * (glm::dot(normal, eye) + plane_.w) * normal;
+
+	// A point seen through the middle of the quad, which must be inside every side plane
+	glm::vec3 center(0);
+	for (auto& corner : corners_)
+	{
+		center += corner * 0.25f;
+	}
+
+	const glm::vec3 inside_point = center + (center - reflected_eye);
+
+	std::array<glm::vec4, 6> planes;
+	for (size_t i = 0; i < corners_.size(); i++)
+	{
+		const glm::vec3& a = corners_[i];
+		const glm::vec3& b = corners_[(i + 1) % corners_.size()];
+		glm::vec3 side_normal = glm::cross(a - reflected_eye, b - reflected_eye);
+		glm::vec4 side_plane(side_normal, -glm::dot(side_normal, reflected_eye));
+		if (glm::dot(glm::vec3(side_plane), inside_point) + side_plane.w < 0)
+		{
+			side_plane = -side_plane;
+		}
+
+		planes[i] = side_plane;
+	}
+
+	planes[4] = plane_;
+	planes[5] = reflected_camera_frustum.GetPlane(5);
+	return Frustum(planes);
+}
+
+std::vector<glm::vec2> MirrorPortal::ClipPolygon(const std::vector<glm::vec2>& polygon, int axis, float bound, bool keep_below)
+{
+	// Sutherland-Hodgman against a single axis aligned line
+	auto inside = [&](const glm::vec2& point)
+	{
+		return keep_below ? point[axis] <= bound : point[axis] >= bound;
+	};
+
+	std::vector<glm::vec2> result;
+	for (size_t i = 0; i < polygon.size(); i++)
+	{
+		const glm::vec2& current = polygon[i];
+		const glm::vec2& next = polygon[(i + 1) % polygon.size()];
+		if (inside(current))
+		{
+			result.push_back(current);
+		}
+
+		if (inside(current) != inside(next))
+		{
+			const float t = (bound - current[axis]) / (next[axis] - current[axis]);
+			result.push_back(current + (next - current) * t);
+		}
+	}
+
+	return result;
+}
\ No newline at end of file
@@ -0,0 +1,195 @@
+#include "mirror_tree.h"
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <numeric>
+
+const size_t MirrorTree::NO_PARENT = std::numeric_limits<size_t>::max();
+
+MirrorTree::MirrorTree() :
+	pass_count_(0),
+	dropped_count_(0)
+{
+
+}
+
+MirrorTree::~MirrorTree()
+{
+
+}
+
+void MirrorTree::Build(
+	const std::vector<std::shared_ptr<Mirror>>& mirrors,
+	const Camera& camera,
+	const BoundingVolumeHierarchy& hierarchy,
+	int width,
+	int height,
+	int max_depth,
+	float min_pixel_count,
+	size_t budget)
+{
+	nodes_.clear();
+	roots_.clear();
+
+	// Breadth first, so a node always comes after its parent
+	AddNodes(NO_PARENT, mirrors, camera, hierarchy, width, height, min_pixel_count);
+	size_t level_start = 0;
+	for (int level = 2; level <= max_depth; level++)
+	{
+		const size_t level_end = nodes_.size();
+		for (size_t i = level_start; i < level_end; i++)
+		{
+			AddNodes(i, mirrors, camera, hierarchy, width, height, min_pixel_count);
+		}
+
+		level_start = level_end;
+	}
+
+	// Keep the largest passes. A node is never larger than its parent, and comes after it on ties,
+	// so the parent of every kept node is kept as well
+	std::vector<size_t> order(nodes_.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b)
+	{
+		return nodes_[a].pixel_count > nodes_[b].pixel_count;
+	});
+
+	pass_count_ = std::min(budget, nodes_.size());
+	dropped_count_ = nodes_.size() - pass_count_;
+	for (size_t i = 0; i < pass_count_; i++)
+	{
+		const Node& node = nodes_[order[i]];
+		auto& siblings = node.parent == NO_PARENT ? roots_ : nodes_[node.parent].children;
+		siblings.push_back(order[i]);
+	}
+}
+
+const std::vector<MirrorTree::Node>& MirrorTree::GetNodes() const
+{
+	return nodes_;
+}
+
+const std::vector<size_t>& MirrorTree::GetRoots() const
+{
+	return roots_;
+}
+
+size_t MirrorTree::CullOccluded(size_t node, const OcclusionBuffer& occlusion_buffer, const Frustum::BoxList& boxes)
+{
+	const size_t visible_count = nodes_[node].visible_count;
+	nodes_[node].visible_count = occlusion_buffer.CullBoxes(boxes, nodes_[node].visibility);
+	return visible_count - nodes_[node].visible_count;
+}
+
+size_t MirrorTree::GetPassCount() const
+{
+	return pass_count_;
+}
+
+size_t MirrorTree::GetDroppedCount() const
+{
+	return dropped_count_;
+}
+
+void MirrorTree::AddNodes(
+	size_t parent,
+	const std::vector<std::shared_ptr<Mirror>>& mirrors,
+	const Camera& camera,
+	const BoundingVolumeHierarchy& hierarchy,
+	int width,
+	int height,
+	float min_pixel_count)
+{
+	const bool has_parent = parent != NO_PARENT;
+	const glm::mat4 parent_reflection = has_parent ? nodes_[parent].reflection : glm::mat4(1.0f);
+	const float parent_pixel_count = has_parent ? nodes_[parent].pixel_count : std::numeric_limits<float>::max();
+	const glm::ivec4 parent_scissor = has_parent ? nodes_[parent].scissor : glm::ivec4(0, 0, width, height);
+	const int level = has_parent ? nodes_[parent].level + 1 : 1;
+
+	// Work in the space in which the mirrors are seen, where they are at their own placement
+	const glm::vec3 eye = glm::vec3(glm::inverse(parent_reflection) * glm::vec4(camera.GetEye(), 1.0f));
+	const glm::mat4 view_projection = camera.GetProjectionTransform() * camera.GetViewTransform() * parent_reflection;
+	const glm::mat4 plane_transform = glm::transpose(glm::inverse(parent_reflection));
+
+	// Everything which can be seen through the parent mirror, in this space; its near plane is the plane of the
+	// parent mirror, so mirrors behind it are rejected as well as the ones beside the quad
+	std::array<glm::vec4, 6> parent_portal_planes;
+	if (has_parent)
+	{
+		const Node& parent_node = nodes_[parent];
+		const glm::vec3 parent_eye = glm::vec3(glm::inverse(parent_node.parent_reflection) * glm::vec4(camera.GetEye(), 1.0f));
+		const Frustum parent_portal_frustum = mirrors[parent_node.mirror]->GetPortal().CalculateReflectionFrustum(parent_eye, camera.GetFrustum(parent_reflection));
+		for (int i = 0; i < 6; i++)
+		{
+			parent_portal_planes[i] = parent_portal_frustum.GetPlane(i);
+		}
+	}
+
+	for (size_t m = 0; m < mirrors.size(); m++)
+	{
+		// A flat mirror can't see itself
+		if (!mirrors[m]->IsEnabled() || (has_parent && nodes_[parent].mirror == m))
+		{
+			continue;
+		}
+
+		MirrorPortal portal = mirrors[m]->GetPortal();
+		if (!portal.IsFacing(eye) || (has_parent && IsQuadOutside(parent_portal_planes, portal.GetCorners())) ||
+			!portal.Project(view_projection, width, height))
+		{
+			continue;
+		}
+
+		// A mirror seen through another one can't cover more of the screen than that one
+		Node node;
+		node.scissor = IntersectScissors(portal.GetScissor(), parent_scissor);
+		node.pixel_count = std::min(portal.GetPixelCount(), parent_pixel_count);
+		if (node.scissor.z <= 0 || node.scissor.w <= 0 || node.pixel_count < min_pixel_count)
+		{
+			continue;
+		}
+
+		node.mirror = m;
+		node.parent = parent;
+		node.level = level;
+		node.parent_reflection = parent_reflection;
+		node.reflection = parent_reflection * mirrors[m]->GetReflection();
+		node.plane = plane_transform * portal.GetPlane();
+
+		// Cull against the camera frustum in the reflected space, and against the frustum through the mirror
+		const Frustum reflected_frustum = camera.GetFrustum(node.reflection);
+		const Frustum portal_frustum = portal.CalculateReflectionFrustum(eye, reflected_frustum);
+		node.visible_count = hierarchy.CullBoxes(reflected_frustum, portal_frustum, node.visibility);
+
+		nodes_.push_back(std::move(node));
+	}
+}
+
+bool MirrorTree::IsQuadOutside(const std::array<glm::vec4, 6>& planes, const std::array<glm::vec3, 4>& corners)
+{
+	// Conservative: only outside if all corners are behind the same plane
+	for (auto& plane : planes)
+	{
+		bool outside = true;
+		for (auto& corner : corners)
+		{
+			outside = outside && glm::dot(glm::vec3(plane), corner) + plane.w < 0;
+		}
+
+		if (outside)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+glm::ivec4 MirrorTree::IntersectScissors(const glm::ivec4& a, const glm::ivec4& b)
+{
+	const int min_x = std::max(a.x, b.x);
+	const int min_y = std::max(a.y, b.y);
+	const int max_x = std::min(a.x + a.z, b.x + b.z);
+	const int max_y = std::min(a.y + a.w, b.y + b.w);
+	return glm::ivec4(min_x, min_y, max_x - min_x, max_y - min_y);
+}
\ No newline at end of file
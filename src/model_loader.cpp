@@ -0,0 +1,154 @@
+#include "model_loader.h"
+#include <algorithm>
+
+ModelLoader::Job::Job(const std::string& file_path, const ObjMesh::LoadOptions& load_options) :
+	file_path(file_path),
+	load_options(load_options)
+{
+	// The worker only runs the CPU stage, and reports its progress here
+	this->load_options.defer_upload = true;
+	this->load_options.progress = &progress;
+}
+
+ModelLoader::Job::~Job()
+{
+	// The mesh may be shared with models which outlive the job, and must not report to its progress anymore
+	if (model != nullptr && model->GetMesh() != nullptr)
+	{
+		model->GetMesh()->DetachProgress(&progress);
+	}
+}
+
+ModelLoader::ModelLoader() :
+	vertex_format_(ObjMesh::STANDARD),
+	stopping_(false)
+{
+
+}
+
+ModelLoader::~ModelLoader()
+{
+	// Loads which are running finish, the others return right away
+	stopping_ = true;
+	JobSystem::GetInstance().Wait(load_counter_);
+}
+
+void ModelLoader::LoadModelAsync(const std::string& file_path, const ObjMesh::LoadOptions& load_options)
+{
+	auto job = std::make_shared<Job>(file_path, load_options);
+	pending_jobs_.push_back(job);
+	QueueJob(job);
+}
+
+void ModelLoader::ReloadModelAsync(const std::shared_ptr<ObjModel>& model)
+{
+	// A reload which is on its way already picks up the current vertex format
+	for (auto& job : pending_jobs_)
+	{
+		if (job->target == model)
+		{
+			return;
+		}
+	}
+
+	auto job = std::make_shared<Job>(model->GetFilePath(), model->GetLoadOptions());
+	job->target = model;
+	pending_jobs_.push_back(job);
+	QueueJob(job);
+}
+
+void ModelLoader::QueueJob(const std::shared_ptr<Job>& job)
+{
+	// Several models load at the same time, each on a worker of its own
+	JobSystem::GetInstance().RunBackground([this, job]() { LoadModel(job); }, &load_counter_);
+}
+
+std::vector<std::shared_ptr<ObjModel>> ModelLoader::Update(size_t upload_budget)
+{
+	// Take over the jobs whose CPU stage has finished
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		uploading_jobs_.insert(uploading_jobs_.end(), loaded_jobs_.begin(), loaded_jobs_.end());
+		loaded_jobs_.clear();
+	}
+
+	// Jobs which were loaded in a previous vertex format are loaded again on a worker, instead of converting them here.
+	// Reloads of models which are back in the current format aren't needed anymore
+	for (auto it = uploading_jobs_.begin(); it != uploading_jobs_.end();)
+	{
+		auto job = *it;
+		if (job->load_options.vertex_format == vertex_format_)
+		{
+			++it;
+			continue;
+		}
+
+		it = uploading_jobs_.erase(it);
+		job->model->GetMesh()->DetachProgress(&job->progress);
+		job->model.reset();
+		if (job->target != nullptr && job->target->GetVertexFormat() == vertex_format_)
+		{
+			pending_jobs_.erase(std::find(pending_jobs_.begin(), pending_jobs_.end(), job));
+			continue;
+		}
+
+		job->progress.stage = ObjMesh::QUEUED;
+		QueueJob(job);
+	}
+
+	// Upload one model at a time, so at most upload_budget bytes are copied per frame
+	std::vector<std::shared_ptr<ObjModel>> models;
+	reloaded_models_.clear();
+	if (!uploading_jobs_.empty())
+	{
+		auto job = uploading_jobs_.front();
+		if (job->model->UploadModelData(upload_budget))
+		{
+			uploading_jobs_.pop_front();
+			pending_jobs_.erase(std::find(pending_jobs_.begin(), pending_jobs_.end(), job));
+			if (job->target != nullptr)
+			{
+				job->target->SetMesh(job->model->GetMesh());
+				reloaded_models_.push_back(job->target);
+			}
+			else
+			{
+				models.push_back(job->model);
+			}
+		}
+	}
+
+	return models;
+}
+
+const std::vector<std::shared_ptr<ModelLoader::Job>>& ModelLoader::GetPendingJobs() const
+{
+	return pending_jobs_;
+}
+
+const std::vector<std::shared_ptr<ObjModel>>& ModelLoader::GetReloadedModels() const
+{
+	return reloaded_models_;
+}
+
+void ModelLoader::SetVertexFormat(ObjMesh::VertexFormat vertex_format)
+{
+	vertex_format_ = vertex_format;
+}
+
+void ModelLoader::LoadModel(const std::shared_ptr<Job>& job)
+{
+	if (stopping_)
+	{
+		return;
+	}
+
+	// CPU stage only; no GL calls are made on this thread
+	job->load_options.vertex_format = vertex_format_;
+	job->model = std::make_shared<ObjModel>(job->file_path, job->load_options);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		loaded_jobs_.push_back(job);
+	}
+}
\ No newline at end of file
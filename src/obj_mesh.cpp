@@ -0,0 +1,910 @@
+#include "obj_mesh.h"
+#include "obj_parser.h"
+#include "mapped_file.h"
+#include "mesh_arena.h"
+#include "mesh_cache_file.h"
+#include "mesh_optimizer.h"
+#include "state_cache.h"
+#include "utils.h"
+#include <istream>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <glm/gtc/packing.hpp>
+#include <limits>
+#include <unordered_map>
+
+// Post-transform vertex cache size assumed when estimating vertex shader invocations
+#define VERTEX_CACHE_SIZE 32
+
+// Cache size targeted by triangle reordering; smaller than the estimate above, so the order stays good on smaller caches
+#define OPTIMIZER_CACHE_SIZE 16
+
+// Largest ACMR increase (relative to the cache optimized order) accepted to reduce overdraw
+#define OVERDRAW_THRESHOLD 1.05f
+
+namespace
+{
+	struct VertexKey
+	{
+		uint32_t position_index;
+		uint32_t normal_index;
+		uint32_t uv_index;
+
+		bool operator==(const VertexKey& other) const
+		{
+			return position_index == other.position_index &&
+				normal_index == other.normal_index &&
+				uv_index == other.uv_index;
+		}
+	};
+
+	struct VertexKeyHash
+	{
+		size_t operator()(const VertexKey& key) const
+		{
+			uint64_t hash = key.position_index;
+			hash = hash * 0x9E3779B185EBCA87ULL + key.normal_index;
+			hash = hash * 0x9E3779B185EBCA87ULL + key.uv_index;
+			return static_cast<size_t>(hash ^ (hash >> 29));
+		}
+	};
+}
+
+ObjMesh::ObjMesh(const std::string& file_path, const LoadOptions& load_options, uint64_t source_key) :
+	allocation_id_(0),
+	allocated_(false),
+	vertex_count_(0),
+	index_count_(0),
+	index_type_(GL_UNSIGNED_INT),
+	buffer_size_(0),
+	load_options_(load_options),
+	file_path_(file_path),
+	source_key_(source_key),
+	upload_vertex_data_(nullptr),
+	upload_vertex_size_(0),
+	upload_index_data_(nullptr),
+	upload_index_size_(0),
+	upload_offset_(0),
+	upload_pending_(false),
+	upload_started_(false),
+	progress_finished_(false),
+	loaded_(false)
+{
+	// Callers attach their progress objects instead, as the mesh may be shared by several loads
+	load_options_.progress = nullptr;
+}
+
+ObjMesh::~ObjMesh()
+{
+	{
+		std::lock_guard<std::mutex> lock(progress_mutex_);
+		for (auto progress : attached_progress_)
+		{
+			progress->shared = nullptr;
+		}
+	}
+
+	DestroyBuffers();
+}
+
+void ObjMesh::PrepareUpload(const Vertex* vertices, size_t vertex_count, const uint32_t* indices, size_t index_count)
+{
+	// Convert the data to its GPU layout here, so the render thread only has to copy it
+	if (load_options_.vertex_format == COMPACT)
+	{
+		compact_vertices_ = CompressVertices(vertices, vertex_count);
+		upload_vertex_data_ = compact_vertices_.data();
+		upload_vertex_size_ = sizeof(CompactVertex) * vertex_count;
+	}
+	else
+	{
+		upload_vertex_data_ = vertices;
+		upload_vertex_size_ = sizeof(Vertex) * vertex_count;
+	}
+
+	// Use 16-bit indices whenever all vertices are addressable by them
+	index_type_ = GL_UNSIGNED_INT;
+	upload_index_data_ = indices;
+	upload_index_size_ = sizeof(uint32_t) * index_count;
+	if (index_count > 0 && vertex_count <= std::numeric_limits<uint16_t>::max() + size_t(1))
+	{
+		short_indices_.assign(indices, indices + index_count);
+		index_type_ = GL_UNSIGNED_SHORT;
+		upload_index_data_ = short_indices_.data();
+		upload_index_size_ = sizeof(uint16_t) * index_count;
+	}
+
+	vertex_count_ = static_cast<GLsizei>(vertex_count);
+	index_count_ = static_cast<GLsizei>(index_count);
+	buffer_size_ = upload_vertex_size_ + upload_index_size_;
+	upload_offset_ = 0;
+	upload_pending_ = true;
+	upload_started_ = false;
+	progress_.upload_bytes = upload_vertex_size_ + upload_index_size_;
+}
+
+bool ObjMesh::UploadData(size_t byte_budget)
+{
+	if (!upload_pending_)
+	{
+		return loaded_;
+	}
+
+	if (!upload_started_)
+	{
+		// Cleanup previous allocated buffers
+		DestroyBuffers();
+		SetLoadStage(UPLOADING);
+		upload_started_ = true;
+
+		// Reserve space in the shared buffers of the vertex format; the data is copied from CPU below, possibly over several calls
+		allocation_id_ = MeshArena::GetInstance(load_options_.vertex_format).Allocate(vertex_count_, upload_index_size_);
+		allocated_ = true;
+	}
+
+	// Copy the next part of the vertex data, followed by the index data
+	MeshArena& arena = MeshArena::GetInstance(load_options_.vertex_format);
+	const size_t total_size = upload_vertex_size_ + upload_index_size_;
+	while (byte_budget > 0 && upload_offset_ < total_size)
+	{
+		const bool vertex_part = upload_offset_ < upload_vertex_size_;
+		const size_t offset = vertex_part ? upload_offset_ : upload_offset_ - upload_vertex_size_;
+		const size_t size = std::min(byte_budget, (vertex_part ? upload_vertex_size_ : upload_index_size_) - offset);
+		const char* data = static_cast<const char*>(vertex_part ? upload_vertex_data_ : upload_index_data_);
+
+		if (vertex_part)
+		{
+			arena.WriteVertices(allocation_id_, offset, data + offset, size);
+		}
+		else
+		{
+			arena.WriteIndices(allocation_id_, offset, data + offset, size);
+		}
+
+		upload_offset_ += size;
+		byte_budget -= size;
+	}
+
+	progress_.uploaded_bytes = upload_offset_;
+
+	if (upload_offset_ < total_size)
+	{
+		return false;
+	}
+
+	// Upload complete; release the upload-only copies and the mapped cache
+	upload_pending_ = false;
+	upload_started_ = false;
+	upload_vertex_data_ = nullptr;
+	upload_index_data_ = nullptr;
+	compact_vertices_.clear();
+	compact_vertices_.shrink_to_fit();
+	short_indices_.clear();
+	short_indices_.shrink_to_fit();
+	cache_file_.reset();
+
+	// Nothing but the GPU buffers is needed to render
+	if (load_options_.release_cpu_data)
+	{
+		ReleaseCpuData();
+	}
+
+	// Mesh successfully loaded; the progress objects belong to the callers, and are not used past this point
+	SetLoadStage(FINISHED);
+	{
+		std::lock_guard<std::mutex> lock(progress_mutex_);
+		for (auto progress : attached_progress_)
+		{
+			progress->stage = FINISHED;
+			progress->shared = nullptr;
+		}
+
+		attached_progress_.clear();
+		progress_finished_ = true;
+	}
+
+	loaded_ = true;
+	return true;
+}
+
+bool ObjMesh::IsLoaded() const
+{
+	return loaded_;
+}
+
+void ObjMesh::SetLoadStage(LoadStage stage)
+{
+	progress_.stage = stage;
+}
+
+void ObjMesh::AttachProgress(LoadProgress* progress)
+{
+	std::lock_guard<std::mutex> lock(progress_mutex_);
+	if (progress_finished_)
+	{
+		progress->stage = FINISHED;
+		return;
+	}
+
+	progress->shared = &progress_;
+	attached_progress_.push_back(progress);
+}
+
+void ObjMesh::DetachProgress(LoadProgress* progress)
+{
+	std::lock_guard<std::mutex> lock(progress_mutex_);
+	auto it = std::find(attached_progress_.begin(), attached_progress_.end(), progress);
+	if (it != attached_progress_.end())
+	{
+		progress->shared = nullptr;
+		attached_progress_.erase(it);
+	}
+}
+
+void ObjMesh::PrintBufferStatistics(size_t corner_count) const
+{
+	// Without an index buffer, every face corner is its own vertex and runs the vertex shader once
+	const size_t soup_bytes = corner_count * sizeof(Vertex);
+	const size_t index_size = index_type_ == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+	const size_t vbo_bytes = upload_vertex_size_;
+	const size_t ibo_bytes = index_count_ * index_size;
+	const size_t invocations = index_count_ > 0 ? Utils::SimulateVertexCache(indices_, VERTEX_CACHE_SIZE) : vertex_count_;
+
+	std::cout << "Buffers of " << file_path_ << ": "
+		<< "unindexed " << soup_bytes << " bytes / " << corner_count << " vertex shader invocations, "
+		<< "current " << vbo_bytes << " + " << ibo_bytes << " bytes / ~" << invocations << " vertex shader invocations "
+		<< "(" << vertex_count_ << " unique vertices, FIFO" << VERTEX_CACHE_SIZE << " estimate)" << std::endl;
+}
+
+uint32_t ObjMesh::GetCacheFlags(const LoadOptions& load_options)
+{
+	// Every option that changes the final vertex/index data must be part of the cache key
+	uint32_t flags = 0;
+	if (load_options.deduplicate_vertices)
+	{
+		flags |= 1 << 0;
+
+		if (load_options.optimize_mesh)
+		{
+			flags |= 1 << 1;
+		}
+	}
+
+	return flags;
+}
+
+void ObjMesh::OptimizeMesh()
+{
+	load_statistics_.acmr_before = MeshOptimizer::CalculateAcmr(indices_, VERTEX_CACHE_SIZE);
+	load_statistics_.atvr_before = MeshOptimizer::CalculateAtvr(indices_, vertices_.size(), VERTEX_CACHE_SIZE);
+
+	std::vector<glm::vec3> positions(vertices_.size());
+	for (size_t i = 0; i < vertices_.size(); i++)
+	{
+		positions[i] = vertices_[i].position;
+	}
+
+	// Triangle order for the vertex cache, then overdraw aware reordering of its clusters
+	std::vector<uint32_t> clusters;
+	auto indices = MeshOptimizer::OptimizeVertexCache(indices_, vertices_.size(), OPTIMIZER_CACHE_SIZE, &clusters);
+	indices = MeshOptimizer::OptimizeOverdraw(indices, positions, clusters, OPTIMIZER_CACHE_SIZE, OVERDRAW_THRESHOLD);
+
+	// Some exporters already write a well ordered mesh; keep that order if it's better
+	if (MeshOptimizer::CalculateAcmr(indices, VERTEX_CACHE_SIZE) < load_statistics_.acmr_before)
+	{
+		indices_ = std::move(indices);
+	}
+
+	// Vertex buffer order by first use
+	size_t unique_vertex_count = 0;
+	const auto remap = MeshOptimizer::OptimizeVertexFetch(indices_, vertices_.size(), unique_vertex_count);
+	std::vector<Vertex> vertices(unique_vertex_count);
+	for (size_t i = 0; i < vertices_.size(); i++)
+	{
+		if (remap[i] < unique_vertex_count)
+		{
+			vertices[remap[i]] = vertices_[i];
+		}
+	}
+
+	vertices_ = std::move(vertices);
+
+	load_statistics_.acmr_after = MeshOptimizer::CalculateAcmr(indices_, VERTEX_CACHE_SIZE);
+	load_statistics_.atvr_after = MeshOptimizer::CalculateAtvr(indices_, vertices_.size(), VERTEX_CACHE_SIZE);
+	std::cout << "Optimized " << file_path_ << ": "
+		<< "ACMR " << load_statistics_.acmr_before << " -> " << load_statistics_.acmr_after << ", "
+		<< "ATVR " << load_statistics_.atvr_before << " -> " << load_statistics_.atvr_after
+		<< " (FIFO" << VERTEX_CACHE_SIZE << ")" << std::endl;
+}
+
+void ObjMesh::ReleaseCpuData()
+{
+	// Swap with empty vectors, since clear() keeps the capacity
+	std::vector<glm::vec3>().swap(positions_);
+	std::vector<glm::vec3>().swap(normals_);
+	std::vector<glm::vec2>().swap(uvs_);
+	std::vector<uint32_t>().swap(position_indices_);
+	std::vector<uint32_t>().swap(normal_indices_);
+	std::vector<uint32_t>().swap(uv_indices_);
+	std::vector<Vertex>().swap(vertices_);
+	std::vector<uint32_t>().swap(indices_);
+}
+
+void ObjMesh::DestroyBuffers()
+{
+	if (allocated_)
+	{
+		MeshArena::GetInstance(load_options_.vertex_format).Free(allocation_id_);
+		allocated_ = false;
+	}
+
+	loaded_ = false;
+}
+
+const std::vector<glm::vec3>& ObjMesh::GetVertices() const
+{
+	return positions_;
+}
+
+const std::vector<uint32_t>& ObjMesh::GetVertexIndices() const
+{
+	return position_indices_;
+}
+
+const std::vector<glm::vec3>& ObjMesh::GetNormals() const
+{
+	return normals_;
+}
+
+const std::vector<uint32_t>& ObjMesh::GetNormalIndices() const
+{
+	return normal_indices_;
+}
+
+const std::vector<glm::vec2>& ObjMesh::GetUvs() const
+{
+	return uvs_;
+}
+
+const std::vector<uint32_t>& ObjMesh::GetUvIndices() const
+{
+	return uv_indices_;
+}
+
+void ObjMesh::ParseVertexPosition(std::istream& line_stream)
+{
+	positions_.push_back(Vec3FromStream(line_stream));
+}
+
+void ObjMesh::ParseVertexNormal(std::istream& line_stream)
+{
+	normals_.push_back(Vec3FromStream(line_stream));
+}
+
+void ObjMesh::ParseVertexTexture(std::istream& line_stream)
+{
+	uvs_.push_back(Vec2FromStream(line_stream));
+}
+
+void ObjMesh::ParseFace(std::istream& line_stream)
+{
+	char back_slash;
+	for (int i = 0; i < 3; i++)
+	{
+		uint32_t vertex_index;
+		uint32_t normal_index;
+		uint32_t uv_index;
+
+		// Read the next vertex index
+		line_stream >> std::ws >> vertex_index >> std::ws;
+		position_indices_.push_back(vertex_index - 1);
+
+		// Continue if next char is not a back-slash, since normal/texture indices do not exist
+		if (line_stream.peek() != '/')
+		{
+			continue;
+		}
+
+		// Otherwise, consume the next back-slash
+		line_stream >> back_slash >> std::ws;
+		if (line_stream.peek() == '/')
+		{
+			// If we had two consecutive back-slashes, then only vertex/normal indices exist
+			// Therefore, read the next normal index, and continue
+			line_stream >> back_slash >> std::ws >> normal_index;
+			normal_indices_.push_back(normal_index - 1);
+			continue;
+		}
+
+		// Read the next uv index
+		line_stream >> uv_index;
+		uv_indices_.push_back(uv_index - 1);
+
+		// If no additional back-slash follows, then only vertex/texture indices exist
+		if (line_stream.peek() != '/')
+		{
+			continue;
+		}
+
+		// Otherwise, read the next back-slash, and then read the next normal index
+		line_stream >> back_slash >> normal_index;
+		normal_indices_.push_back(normal_index - 1);
+	}
+}
+
+void ObjMesh::ParseStream()
+{
+	auto ss_file = Utils::TextFileToStream(file_path_);
+
+	// While we haven't reached the end of file
+	while (!ss_file.eof())
+	{
+		// Read the next line
+		std::string current_line;
+		std::getline(ss_file, current_line);
+		std::istringstream ss_line(current_line);
+		
+		// Read the line type (single character)
+		std::string line_type;
+		ss_line >> std::ws >> line_type;
+
+		// Parse the OBJ file data based on the line type
+		if (line_type == "v")
+		{
+			ParseVertexPosition(ss_line);
+		}
+		else if (line_type == "vn")
+		{
+			ParseVertexNormal(ss_line);
+		}
+		else if (line_type == "vt")
+		{
+			ParseVertexTexture(ss_line);
+		}
+		else if (line_type == "f")
+		{
+			ParseFace(ss_line);
+		}
+		else if (line_type == "#" || line_type == "")
+		{
+			// Comment or an empty line
+		}
+		else
+		{
+			std::cerr << "Cannot parse OBJ line: " << current_line << std::endl;
+		}
+	}
+}
+
+void ObjMesh::ParseMapped()
+{
+	MappedFile file(file_path_);
+	if (!file.IsOpen())
+	{
+		return;
+	}
+
+	// Tokenize the mapped file in place
+	std::atomic<size_t>* parsed_bytes = &progress_.parsed_bytes;
+	ObjParser::Result result;
+	if (load_options_.parse_mode == PARALLEL)
+	{
+		ObjParser::ParseParallel(file.GetData(), file.GetData() + file.GetSize(), load_options_.thread_count, result, parsed_bytes);
+	}
+	else
+	{
+		ObjParser::Parse(file.GetData(), file.GetData() + file.GetSize(), result, parsed_bytes);
+	}
+
+	positions_ = std::move(result.positions);
+	normals_ = std::move(result.normals);
+	uvs_ = std::move(result.uvs);
+	position_indices_ = std::move(result.position_indices);
+	normal_indices_ = std::move(result.normal_indices);
+	uv_indices_ = std::move(result.uv_indices);
+}
+
+bool ObjMesh::LoadCache(const std::string& cache_path)
+{
+	auto cache_file = std::make_unique<MeshCacheFile>(cache_path);
+	if (!cache_file->IsValid(source_key_))
+	{
+		return false;
+	}
+
+	// Upload the mapped data directly, without keeping a CPU side copy; the mapping is kept until the upload is done
+	cache_file_ = std::move(cache_file);
+	bounding_box_ = cache_file_->GetBoundingBox();
+	PrepareUpload(cache_file_->GetVertices(), cache_file_->GetVertexCount(), cache_file_->GetIndices(), cache_file_->GetIndexCount());
+	return true;
+}
+
+void ObjMesh::LoadData()
+{
+	std::call_once(load_once_, [this]()
+	{
+		LoadDataOnce();
+	});
+}
+
+void ObjMesh::LoadDataOnce()
+{
+	const auto load_start = std::chrono::steady_clock::now();
+	std::error_code error;
+	const auto file_size = std::filesystem::file_size(file_path_, error);
+	load_statistics_ = LoadStatistics();
+	load_statistics_.file_size = error ? 0 : static_cast<size_t>(file_size);
+	progress_.total_bytes = load_statistics_.file_size;
+
+	// Use the binary cache if it was built from the same source content by the same loader version
+	const std::string cache_path = MeshCacheFile::GetCachePath(file_path_);
+	if (load_options_.use_cache && LoadCache(cache_path))
+	{
+		const std::chrono::duration<double> load_duration = std::chrono::steady_clock::now() - load_start;
+		load_statistics_.load_seconds = load_duration.count();
+		load_statistics_.cache_hit = true;
+		std::cout << "Loaded " << file_path_ << " from cache in " << load_statistics_.load_seconds * 1000.0 << " ms" << std::endl;
+		return;
+	}
+
+	// Parse the OBJ file, and measure parsing throughput
+	SetLoadStage(PARSING);
+	const auto parse_start = std::chrono::steady_clock::now();
+	if (load_options_.parse_mode == STREAM)
+	{
+		ParseStream();
+	}
+	else
+	{
+		ParseMapped();
+	}
+
+	const std::chrono::duration<double> parse_duration = std::chrono::steady_clock::now() - parse_start;
+	load_statistics_.parse_seconds = parse_duration.count();
+	std::cout << "Parsed " << file_path_ << ": "
+		<< load_statistics_.file_size / (1024.0 * 1024.0) << " MB in "
+		<< load_statistics_.parse_seconds * 1000.0 << " ms ("
+		<< load_statistics_.GetParseThroughput() << " MB/s)" << std::endl;
+
+	// Normalize positions to the unit cube
+	SetLoadStage(PROCESSING);
+	positions_ = NormalizePositions(positions_);
+
+	// Calculate axis aligned bounding box
+	bounding_box_ = CalculateBoundingBox(positions_);
+
+	// Estimate vertex normals in case they were not provided in the OBJ file
+	if(normals_.empty())
+	{
+		normals_ = Utils::CalculateVertexNormals(positions_, position_indices_);
+		normal_indices_ = position_indices_;
+	}
+
+	// Interleave positions, normals and uvs into a single vector
+	if (load_options_.deduplicate_vertices)
+	{
+		vertices_ = IndexData(positions_, normals_, uvs_, position_indices_, normal_indices_, uv_indices_, indices_);
+
+		// Reorder triangles and vertices for the post-transform cache, overdraw and vertex fetch
+		if (load_options_.optimize_mesh)
+		{
+			OptimizeMesh();
+		}
+	}
+	else
+	{
+		vertices_ = InterleaveData(positions_, normals_, uvs_, position_indices_, normal_indices_, uv_indices_);
+		indices_.clear();
+	}
+
+	// Prepare GPU buffers of the newly loaded mesh
+	PrepareUpload(vertices_.data(), vertices_.size(), indices_.data(), indices_.size());
+	PrintBufferStatistics(position_indices_.size());
+
+	// Store the final data for the next load
+	if (load_options_.use_cache && !vertices_.empty())
+	{
+		MeshCacheFile::Write(cache_path, source_key_, vertices_, indices_, bounding_box_);
+	}
+
+	const std::chrono::duration<double> load_duration = std::chrono::steady_clock::now() - load_start;
+	load_statistics_.load_seconds = load_duration.count();
+}
+
+glm::vec3 ObjMesh::Vec3FromStream(std::istream& line_stream)
+{
+	float x, y, z;
+	line_stream >> x >> std::ws >> y >> std::ws >> z;
+	return glm::vec3(x, y, z);
+}
+
+glm::vec2 ObjMesh::Vec2FromStream(std::istream& line_stream)
+{
+	float x, y;
+	line_stream >> x >> std::ws >> y;
+	return glm::vec2(x, y);
+}
+
+const std::string& ObjMesh::GetFilePath() const
+{
+	return file_path_;
+}
+
+const ObjMesh::LoadOptions& ObjMesh::GetLoadOptions() const
+{
+	return load_options_;
+}
+
+ObjMesh::VertexFormat ObjMesh::GetVertexFormat() const
+{
+	return load_options_.vertex_format;
+}
+
+size_t ObjMesh::GetBufferSize() const
+{
+	return buffer_size_;
+}
+
+void ObjMesh::Render() const
+{
+	if (loaded_)
+	{
+		const MeshArena& arena = MeshArena::GetInstance(load_options_.vertex_format);
+		const MeshArena::Allocation& allocation = arena.GetAllocation(allocation_id_);
+		StateCache::GetInstance().BindVertexArray(arena.GetVertexArray());
+		if (index_count_ > 0)
+		{
+			glDrawElementsBaseVertex(GL_TRIANGLES, index_count_, index_type_, (GLvoid*)allocation.index_offset, static_cast<GLint>(allocation.vertex_offset));
+		}
+		else
+		{
+			glDrawArrays(GL_TRIANGLES, static_cast<GLint>(allocation.vertex_offset), vertex_count_);
+		}
+	}
+}
+
+GLsizei ObjMesh::GetVertexCount() const
+{
+	return vertex_count_;
+}
+
+GLsizei ObjMesh::GetIndexCount() const
+{
+	return index_count_;
+}
+
+GLenum ObjMesh::GetIndexType() const
+{
+	return index_type_;
+}
+
+uint32_t ObjMesh::GetAllocationId() const
+{
+	return allocation_id_;
+}
+
+std::vector<ObjMesh::Vertex> ObjMesh::InterleaveData(
+	const std::vector<glm::vec3>& positions,
+	const std::vector<glm::vec3>& normals,
+	const std::vector<glm::vec2>& uvs,
+	const std::vector<uint32_t>& position_indices,
+	const std::vector<uint32_t>& normal_indices,
+	const std::vector<uint32_t>& uv_indices)
+{
+	std::vector<Vertex> vertices;
+	vertices.reserve(position_indices.size());
+	for(size_t i = 0; i < position_indices.size(); i++)
+	{
+		Vertex vertex;
+		vertex.position = positions[position_indices[i]];
+		vertex.normal = normals[normal_indices[i]];
+		vertex.uv = glm::vec2(0);
+
+		if (!uv_indices.empty())
+		{
+			vertex.uv = uvs[uv_indices[i]];
+		}
+
+		vertices.push_back(vertex);
+	}
+
+	return vertices;
+}
+
+std::vector<ObjMesh::CompactVertex> ObjMesh::CompressVertices(const Vertex* vertices, size_t vertex_count)
+{
+	std::vector<CompactVertex> compact_vertices(vertex_count);
+	for (size_t i = 0; i < vertex_count; i++)
+	{
+		const glm::vec3 position = glm::clamp(vertices[i].position, -1.0f, 1.0f);
+		compact_vertices[i].position = glm::packSnorm4x16(glm::vec4(position, 0.0f));
+
+		// OBJ normals need not be unit length, and clamping each component to [-1, 1] would turn them
+		const glm::vec3& normal = vertices[i].normal;
+		const glm::vec3 unit_normal = glm::dot(normal, normal) > 0.0f ? glm::normalize(normal) : glm::vec3(0.0f);
+		compact_vertices[i].normal = glm::packSnorm3x10_1x2(glm::vec4(unit_normal, 0.0f));
+		compact_vertices[i].uv = glm::packHalf2x16(vertices[i].uv);
+	}
+
+	return compact_vertices;
+}
+
+std::vector<ObjMesh::Vertex> ObjMesh::IndexData(
+	const std::vector<glm::vec3>& positions,
+	const std::vector<glm::vec3>& normals,
+	const std::vector<glm::vec2>& uvs,
+	const std::vector<uint32_t>& position_indices,
+	const std::vector<uint32_t>& normal_indices,
+	const std::vector<uint32_t>& uv_indices,
+	std::vector<uint32_t>& indices)
+{
+	std::vector<Vertex> vertices;
+	std::unordered_map<VertexKey, uint32_t, VertexKeyHash> vertex_map;
+	vertex_map.reserve(position_indices.size());
+	indices.clear();
+	indices.reserve(position_indices.size());
+
+	// Emit one vertex per unique (position, normal, uv) index tuple, and index it from every corner sharing it
+	for (size_t i = 0; i < position_indices.size(); i++)
+	{
+		VertexKey key;
+		key.position_index = position_indices[i];
+		key.normal_index = normal_indices[i];
+		key.uv_index = uv_indices.empty() ? 0 : uv_indices[i];
+
+		const auto [it, inserted] = vertex_map.try_emplace(key, static_cast<uint32_t>(vertices.size()));
+		if (inserted)
+		{
+			Vertex vertex;
+			vertex.position = positions[key.position_index];
+			vertex.normal = normals[key.normal_index];
+			vertex.uv = uv_indices.empty() ? glm::vec2(0) : uvs[key.uv_index];
+			vertices.push_back(vertex);
+		}
+
+		indices.push_back(it->second);
+	}
+
+	return vertices;
+}
+
+std::vector<glm::vec3> ObjMesh::NormalizePositions(const std::vector<glm::vec3>& positions)
+{
+	std::vector<glm::vec3> normalized_positions;
+	glm::vec3 center(0);
+
+	for(auto& position : positions)
+	{
+		center += position;
+	}
+
+	center = center / static_cast<float>(positions.size());
+
+	for (auto& position : positions)
+	{
+		normalized_positions.push_back(position - center);
+	}
+
+	glm::vec3 max_coeff(0);
+	for (auto& position : normalized_positions)
+	{
+		max_coeff = glm::max(max_coeff, glm::abs(position));
+	}
+
+	for (auto& position : normalized_positions)
+	{
+		float factor = std::max(std::max(max_coeff.x, max_coeff.y), max_coeff.z);
+		if (factor > std::numeric_limits<float>::epsilon())
+		{
+			position /= factor;
+		}
+	}
+
+	return normalized_positions;
+}
+
+ObjMesh::BoundingBox ObjMesh::CalculateBoundingBox(const std::vector<glm::vec3>& positions)
+{
+	BoundingBox bounding_box;
+	for (auto& position : positions)
+	{
+		bounding_box.max_coeffs = glm::max(bounding_box.max_coeffs, position);
+		bounding_box.min_coeffs = glm::min(bounding_box.min_coeffs, position);
+	}
+
+	return bounding_box;
+}
+
+const ObjMesh::BoundingBox& ObjMesh::GetBoundingBox() const
+{
+	return bounding_box_;
+}
+
+const ObjMesh::LoadStatistics& ObjMesh::GetLoadStatistics() const
+{
+	return load_statistics_;
+}
+
+ObjMesh::BoundingBox::BoundingBox() :
+	max_coeffs(glm::vec3(0)),
+	min_coeffs(glm::vec3(0))
+{
+	
+}
+
+ObjMesh::LoadOptions::LoadOptions() :
+	parse_mode(PARALLEL),
+	thread_count(0),
+	use_cache(true),
+	deduplicate_vertices(true),
+	optimize_mesh(true),
+	vertex_format(STANDARD),
+	release_cpu_data(false),
+	defer_upload(false),
+	progress(nullptr)
+{
+	
+}
+
+ObjMesh::LoadStatistics::LoadStatistics() :
+	file_size(0),
+	parse_seconds(0),
+	load_seconds(0),
+	cache_hit(false),
+	acmr_before(0),
+	acmr_after(0),
+	atvr_before(0),
+	atvr_after(0)
+{
+	
+}
+
+double ObjMesh::LoadStatistics::GetParseThroughput() const
+{
+	if (parse_seconds <= 0)
+	{
+		return 0;
+	}
+
+	return (file_size / (1024.0 * 1024.0)) / parse_seconds;
+}
+
+ObjMesh::LoadProgress::LoadProgress() :
+	stage(QUEUED),
+	total_bytes(0),
+	parsed_bytes(0),
+	upload_bytes(0),
+	uploaded_bytes(0),
+	shared(nullptr)
+{
+
+}
+
+float ObjMesh::LoadProgress::GetFraction() const
+{
+	if (const LoadProgress* shared_progress = shared.load())
+	{
+		return shared_progress->GetFraction();
+	}
+
+	// Rough share of the total load time spent in each stage
+	switch (stage.load())
+	{
+	case QUEUED:
+		return 0.0f;
+	case HASHING:
+		return 0.02f;
+	case PARSING:
+		return 0.05f + 0.7f * (total_bytes > 0 ? static_cast<float>(parsed_bytes) / static_cast<float>(total_bytes) : 0.0f);
+	case PROCESSING:
+		return 0.75f;
+	case UPLOADING:
+		return 0.9f + 0.1f * (upload_bytes > 0 ? static_cast<float>(uploaded_bytes) / static_cast<float>(upload_bytes) : 0.0f);
+	default:
+		return 1.0f;
+	}
+}
\ No newline at end of file
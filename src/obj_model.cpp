@@ -1,278 +1,132 @@
 #include "obj_model.h"
-#include "utils.h"
-#include <istream>
-#include <iostream>
-#include <sstream>
-#include <algorithm>
+#include "mesh_library.h"
+#include <limits>
 
 ObjModel::ObjModel(const std::string& file_path) :
-	vao_(0),
-	vbo_(0),
-	ibo_(0),
-	loaded_(false),
-	material_(glm::vec3(1,1,1), glm::vec3(1,1,1)),
-	world_transform_(glm::mat4(1.0)),
-	local_transform_(glm::mat4(1.0))
+	ObjModel(file_path, ObjMesh::LoadOptions())
 {
-	LoadModel(file_path);
+	
 }
 
 ObjModel::ObjModel(const std::string& file_path, const Material& material) :
-	ObjModel(file_path)
-{
-	SetMaterial(material);
-}
-
-ObjModel::~ObjModel()
-{
-	DestroyBuffers();
-}
-
-void ObjModel::CreateBuffers()
+	ObjModel(file_path, material, ObjMesh::LoadOptions())
 {
-	// Cleanup previous allocated buffers
-	DestroyBuffers();
-
-	// Create VAO (vertex array object) and assign attributes
-	glGenVertexArrays(1, &vao_);
-	glBindVertexArray(vao_);
-
-	// Create VBO (vertex buffer object) on GPU, and copy vertex data from CPU
-	glGenBuffers(1, &vbo_);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices_.size(), &vertices_[0], GL_STATIC_DRAW);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)0);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)(3 * sizeof(GLfloat)));
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)(6 * sizeof(GLfloat)));
-	glEnableVertexAttribArray(2);
-
-	// Create IBO (index buffer object)
-	//glGenBuffers(1, &ibo_);
-	//glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_);
-	//glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * position_indices_.size(), &position_indices_[0], GL_STATIC_DRAW);
-
-	// Unbind vertex array so it won't be altered mistakenly
-	glBindVertexArray(0);
+	
 }
 
-void ObjModel::DestroyBuffers()
+ObjModel::ObjModel(const std::string& file_path, const ObjMesh::LoadOptions& load_options) :
+	material_(glm::vec3(1,1,1), glm::vec3(1,1,1)),
+	world_transform_(glm::mat4(1.0)),
+	local_transform_(glm::mat4(1.0)),
+	model_transform_(glm::mat4(1.0)),
+	model_transform_dirty_(false),
+	load_options_(load_options),
+	file_path_(file_path)
 {
-
-	if (vbo_ != 0)
-	{
-		glDeleteBuffers(1, &vbo_);
-		vbo_ = 0;
-	}
-
-	if (ibo_ != 0)
+	if (load_options_.defer_upload)
 	{
-		glDeleteBuffers(1, &ibo_);
-		ibo_ = 0;
+		AcquireMesh(file_path);
 	}
-	
-	if (vao_ != 0)
+	else
 	{
-		glDeleteVertexArrays(1, &vao_);
-		vao_ = 0;
+		LoadModel(file_path);
 	}
 
-	loaded_ = false;
-}
-
-const std::vector<glm::vec3>& ObjModel::GetVertices() const
-{
-	return positions_;
+	// The progress object belongs to the caller, and is only used by the first load
+	load_options_.progress = nullptr;
 }
 
-const std::vector<uint32_t>& ObjModel::GetVertexIndices() const
+ObjModel::ObjModel(const std::string& file_path, const Material& material, const ObjMesh::LoadOptions& load_options) :
+	ObjModel(file_path, load_options)
 {
-	return position_indices_;
-}
-
-const std::vector<glm::vec3>& ObjModel::GetNormals() const
-{
-	return normals_;
+	SetMaterial(material);
 }
 
-const std::vector<uint32_t>& ObjModel::GetNormalIndices() const
+ObjModel::~ObjModel()
 {
-	return normal_indices_;
+	
 }
 
-const std::vector<glm::vec2>& ObjModel::GetUvs() const
+void ObjModel::AcquireMesh(const std::string& file_path)
 {
-	return uvs_;
+	// Run the CPU stage, unless another model already did (or is doing it right now)
+	file_path_ = file_path;
+	mesh_ = MeshLibrary::GetInstance().AcquireMesh(file_path, load_options_);
+	mesh_->LoadData();
 }
 
-const std::vector<uint32_t>& ObjModel::GetUvIndices() const
+void ObjModel::LoadModel(const std::string& file_path)
 {
-	return uv_indices_;
+	AcquireMesh(file_path);
+	UploadModelData(std::numeric_limits<size_t>::max());
 }
 
-void ObjModel::ParseVertexPosition(std::istream& line_stream)
+bool ObjModel::UploadModelData(size_t byte_budget)
 {
-	positions_.push_back(Vec3FromStream(line_stream));
+	// Uploading a shared mesh which is already on the GPU returns right away
+	return mesh_ != nullptr && mesh_->UploadData(byte_budget);
 }
 
-void ObjModel::ParseVertexNormal(std::istream& line_stream)
+bool ObjModel::IsLoaded() const
 {
-	normals_.push_back(Vec3FromStream(line_stream));
+	return mesh_ != nullptr && mesh_->IsLoaded();
 }
 
-void ObjModel::ParseVertexTexture(std::istream& line_stream)
+void ObjModel::UnloadModel()
 {
-	uvs_.push_back(Vec2FromStream(line_stream));
+	mesh_.reset();
 }
 
-void ObjModel::ParseFace(std::istream& line_stream)
+void ObjModel::Render() const
 {
-	char back_slash;
-	for (int i = 0; i < 3; i++)
+	if (IsLoaded())
 	{
-		uint32_t vertex_index;
-		uint32_t normal_index;
-		uint32_t uv_index;
-
-		// Read the next vertex index
-		line_stream >> std::ws >> vertex_index >> std::ws;
-		position_indices_.push_back(vertex_index - 1);
-
-		// Continue if next char is not a back-slash, since normal/texture indices do not exist
-		if (line_stream.peek() != '/')
-		{
-			continue;
-		}
-
-		// Otherwise, consume the next back-slash
-		line_stream >> back_slash >> std::ws;
-		if (line_stream.peek() == '/')
-		{
-			// If we had two consecutive back-slashes, then only vertex/normal indices exist
-			// Therefore, read the next normal index, and continue
-			line_stream >> back_slash >> std::ws >> normal_index;
-			normal_indices_.push_back(normal_index - 1);
-			continue;
-		}
-
-		// Read the next uv index
-		line_stream >> uv_index;
-		uv_indices_.push_back(uv_index - 1);
-
-		// If no additional back-slash follows, then only vertex/texture indices exist
-		if (line_stream.peek() != '/')
-		{
-			continue;
-		}
-
-		// Otherwise, read the next back-slash, and then read the next normal index
-		line_stream >> back_slash >> normal_index;
-		normal_indices_.push_back(normal_index - 1);
+		mesh_->Render();
 	}
 }
 
-void ObjModel::LoadModel(const std::string& file_path)
+void ObjModel::SetVertexFormat(ObjMesh::VertexFormat vertex_format)
 {
-	auto ss_file = Utils::TextFileToStream(file_path);
-
-	// While we haven't reached the end of file
-	while (!ss_file.eof())
-	{
-		// Read the next line
-		std::string current_line;
-		std::getline(ss_file, current_line);
-		std::istringstream ss_line(current_line);
-		
-		// Read the line type (single character)
-		std::string line_type;
-		ss_line >> std::ws >> line_type;
-
-		// Parse the OBJ file data based on the line type
-		if (line_type == "v")
-		{
-			ParseVertexPosition(ss_line);
-		}
-		else if (line_type == "vn")
-		{
-			ParseVertexNormal(ss_line);
-		}
-		else if (line_type == "vt")
-		{
-			ParseVertexTexture(ss_line);
-		}
-		else if (line_type == "f")
-		{
-			ParseFace(ss_line);
-		}
-		else if (line_type == "#" || line_type == "")
-		{
-			// Comment or an empty line
-		}
-		else
-		{
-			std::cerr << "Cannot parse OBJ line: " << current_line << std::endl;
-		}
-	}
-
-	// Normalize positions to the unit cube
-	positions_ = NormalizePositions(positions_);
-
-	// Calculate axis aligned bounding box
-	bounding_box_ = CalculateBoundingBox(positions_);
-
-	// Estimate vertex normals in case they were not provided in the OBJ file
-	if(normals_.empty())
+	if (load_options_.vertex_format == vertex_format)
 	{
-		normals_ = Utils::CalculateVertexNormals(positions_, position_indices_);
-		normal_indices_ = position_indices_;
+		return;
 	}
 
-	// Interleave positions, normals and uvs into a single vector
-	vertices_ = InterleaveData(positions_, normals_, uvs_, position_indices_, normal_indices_, uv_indices_);
+	// Switch to the mesh in the new layout; it is shared as well, so only the first model actually reloads it
+	load_options_.vertex_format = vertex_format;
+	UnloadModel();
+	LoadModel(file_path_);
+}
 
-	// Initialize buffers on GPU with newly loaded model
-	CreateBuffers();
+ObjMesh::VertexFormat ObjModel::GetVertexFormat() const
+{
+	return load_options_.vertex_format;
+}
 
-	// Model successfully loaded
-	loaded_ = true;
+void ObjModel::SetMesh(const std::shared_ptr<ObjMesh>& mesh)
+{
+	mesh_ = mesh;
+	load_options_.vertex_format = mesh->GetVertexFormat();
 }
 
-glm::vec3 ObjModel::Vec3FromStream(std::istream& line_stream)
+const std::string& ObjModel::GetFilePath() const
 {
-	float x, y, z;
-	line_stream >> x >> std::ws >> y >> std::ws >> z;
-	return glm::vec3(x, y, z);
+	return file_path_;
 }
 
-glm::vec2 ObjModel::Vec2FromStream(std::istream& line_stream)
+const ObjMesh::LoadOptions& ObjModel::GetLoadOptions() const
 {
-	float x, y;
-	line_stream >> x >> std::ws >> y;
-	return glm::vec2(x, y);
+	return load_options_;
 }
 
-void ObjModel::UnloadModel()
+size_t ObjModel::GetBufferSize() const
 {
-	if(loaded_)
-	{
-		DestroyBuffers();
-		positions_.clear();
-		normals_.clear();
-		position_indices_.clear();
-		normal_indices_.clear();
-		loaded_ = false;
-	}
+	return mesh_ != nullptr ? mesh_->GetBufferSize() : 0;
 }
 
-void ObjModel::Render() const
+const std::shared_ptr<ObjMesh>& ObjModel::GetMesh() const
 {
-	if (loaded_)
-	{
-		glBindVertexArray(vao_);
-		glDrawArrays(GL_TRIANGLES, 0, vertices_.size());
-		glBindVertexArray(0);
-	}
+	return mesh_;
 }
 
 Material& ObjModel::GetMaterial()
@@ -288,11 +142,13 @@ void ObjModel::SetMaterial(const Material& material)
 void ObjModel::SetLocalTransform(const glm::mat4& local_transform)
 {
 	local_transform_ = local_transform;
+	model_transform_dirty_ = true;
 }
 
 void ObjModel::SetWorldTransform(const glm::mat4& world_transform)
 {
 	world_transform_ = world_transform;
+	model_transform_dirty_ = true;
 }
 
 const glm::mat4& ObjModel::GetLocalTransform() const
@@ -305,92 +161,25 @@ const glm::mat4& ObjModel::GetWorldTransform() const
 	return world_transform_;
 }
 
-glm::mat4 ObjModel::GetModelTransform() const
-{
-	return world_transform_ * local_transform_;
-}
-
-std::vector<ObjModel::Vertex> ObjModel::InterleaveData(
-	std::vector<glm::vec3> positions,
-	std::vector<glm::vec3> normals,
-	std::vector<glm::vec2> uvs,
-	std::vector<uint32_t> position_indices,
-	std::vector<uint32_t> normal_indices,
-	std::vector<uint32_t> uv_indices)
-{
-	std::vector<Vertex> vertices;
-	for(size_t i = 0; i < position_indices.size(); i++)
-	{
-		Vertex vertex;
-		vertex.position = positions[position_indices[i]];
-		vertex.normal = normals[normal_indices[i]];
-
-		if (!uv_indices.empty())
-		{
-			vertex.uv = uvs[uv_indices[i]];
-		}
-
-		vertices.push_back(vertex);
-	}
-
-	return vertices;
-}
-
-std::vector<glm::vec3> ObjModel::NormalizePositions(const std::vector<glm::vec3>& positions)
-{
-	std::vector<glm::vec3> normalized_positions;
-	glm::vec3 center(0);
-
-	for(auto& position : positions)
-	{
-		center += position;
-	}
-
-	center = center / static_cast<float>(positions.size());
-
-	for (auto& position : positions)
-	{
-		normalized_positions.push_back(position - center);
-	}
-
-	glm::vec3 max_coeff(0);
-	for (auto& position : normalized_positions)
-	{
-		max_coeff = glm::max(max_coeff, glm::abs(position));
-	}
-
-	for (auto& position : normalized_positions)
-	{
-		float factor = std::max(std::max(max_coeff.x, max_coeff.y), max_coeff.z);
-		if (factor > std::numeric_limits<float>::epsilon())
-		{
-			position /= factor;
-		}
-	}
-
-	return normalized_positions;
-}
-
-ObjModel::BoundingBox ObjModel::CalculateBoundingBox(const std::vector<glm::vec3>& positions)
+const glm::mat4& ObjModel::GetModelTransform() const
 {
-	BoundingBox bounding_box;
-	for (auto& position : positions)
+	if (model_transform_dirty_)
 	{
-		bounding_box.max_coeffs = glm::max(bounding_box.max_coeffs, position);
-		bounding_box.min_coeffs = glm::min(bounding_box.min_coeffs, position);
+		model_transform_ = world_transform_ * local_transform_;
+		model_transform_dirty_ = false;
 	}
 
-	return bounding_box;
+	return model_transform_;
 }
 
-const ObjModel::BoundingBox& ObjModel::GetBoundingBox() const
+const ObjMesh::BoundingBox& ObjModel::GetBoundingBox() const
 {
-	return bounding_box_;
+	static const ObjMesh::BoundingBox empty_bounding_box;
+	return mesh_ != nullptr ? mesh_->GetBoundingBox() : empty_bounding_box;
 }
 
-ObjModel::BoundingBox::BoundingBox() :
-	max_coeffs(glm::vec3(0)),
-	min_coeffs(glm::vec3(0))
+const ObjMesh::LoadStatistics& ObjModel::GetLoadStatistics() const
 {
-	
+	static const ObjMesh::LoadStatistics empty_load_statistics;
+	return mesh_ != nullptr ? mesh_->GetLoadStatistics() : empty_load_statistics;
 }
\ No newline at end of file
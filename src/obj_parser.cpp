@@ -0,0 +1,363 @@
+#include "obj_parser.h"
+#include "job_system.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+
+// Buffers are not split into chunks smaller than this, so small files are parsed serially
+#define MIN_CHUNK_SIZE (1 << 20)
+
+// Granularity of parse progress reports
+#define PROGRESS_REPORT_SIZE (1 << 20)
+
+namespace
+{
+	// Copy a chunk's array into its slot of the stitched array
+	template <typename T>
+	void CopyChunk(const std::vector<T>& source, std::vector<T>& destination, size_t offset)
+	{
+		std::copy(source.begin(), source.end(), destination.begin() + offset);
+	}
+}
+
+void ObjParser::Parse(const char* begin, const char* end, Result& result, std::atomic<size_t>* parsed_bytes)
+{
+	const char* line_begin = begin;
+	const char* reported = begin;
+
+	// Split the buffer into lines, without copying them
+	while (line_begin < end)
+	{
+		const char* line_end = static_cast<const char*>(std::memchr(line_begin, '\n', end - line_begin));
+		if (line_end == nullptr)
+		{
+			line_end = end;
+		}
+
+		ParseLine(line_begin, line_end, result);
+		line_begin = line_end + 1;
+
+		if (parsed_bytes != nullptr && std::min(line_begin, end) - reported >= PROGRESS_REPORT_SIZE)
+		{
+			*parsed_bytes += std::min(line_begin, end) - reported;
+			reported = std::min(line_begin, end);
+		}
+	}
+
+	if (parsed_bytes != nullptr)
+	{
+		*parsed_bytes += std::min(line_begin, end) - reported;
+	}
+}
+
+void ObjParser::ParseParallel(const char* begin, const char* end, unsigned int chunk_limit, Result& result, std::atomic<size_t>* parsed_bytes)
+{
+	// The job system workers and the calling thread
+	JobSystem& job_system = JobSystem::GetInstance();
+	if (chunk_limit == 0)
+	{
+		chunk_limit = static_cast<unsigned int>(job_system.GetWorkerCount() + 1);
+	}
+
+	const size_t size = end - begin;
+	const size_t chunk_count = std::max<size_t>(1, std::min<size_t>(chunk_limit, size / MIN_CHUNK_SIZE));
+	if (chunk_count == 1)
+	{
+		Parse(begin, end, result, parsed_bytes);
+		return;
+	}
+
+	// Parse every chunk independently. OBJ indices are absolute, so faces
+	// in one chunk may freely reference vertices parsed by another chunk.
+	const auto boundaries = SplitLines(begin, end, chunk_count);
+
+	// Chunks run as jobs; waiting for them never picks up background jobs, so this is safe within a model load
+	std::vector<Result> chunk_results(boundaries.size() - 1);
+	job_system.ParallelFor(chunk_results.size(), 1, [&boundaries, &chunk_results, parsed_bytes](size_t chunk_begin, size_t chunk_end)
+	{
+		for (size_t i = chunk_begin; i < chunk_end; i++)
+		{
+			Parse(boundaries[i], boundaries[i + 1], chunk_results[i], parsed_bytes);
+		}
+	});
+
+	Stitch(chunk_results, result);
+}
+
+std::vector<const char*> ObjParser::SplitLines(const char* begin, const char* end, size_t chunk_count)
+{
+	const size_t chunk_size = (end - begin) / chunk_count;
+
+	std::vector<const char*> boundaries;
+	boundaries.push_back(begin);
+	for (size_t i = 1; i < chunk_count; i++)
+	{
+		// Move each nominal boundary forward to the start of the next line
+		const char* boundary = std::max(boundaries.back(), begin + i * chunk_size);
+		const char* line_end = static_cast<const char*>(std::memchr(boundary, '\n', end - boundary));
+		if (line_end == nullptr)
+		{
+			break;
+		}
+
+		boundaries.push_back(line_end + 1);
+	}
+
+	boundaries.push_back(end);
+	return boundaries;
+}
+
+void ObjParser::Stitch(const std::vector<Result>& chunk_results, Result& result)
+{
+	// Exclusive prefix sums of the per-chunk array sizes give each chunk's offset in the stitched arrays
+	const size_t chunk_count = chunk_results.size();
+	std::vector<size_t> position_offsets(chunk_count + 1, 0);
+	std::vector<size_t> normal_offsets(chunk_count + 1, 0);
+	std::vector<size_t> uv_offsets(chunk_count + 1, 0);
+	std::vector<size_t> position_index_offsets(chunk_count + 1, 0);
+	std::vector<size_t> normal_index_offsets(chunk_count + 1, 0);
+	std::vector<size_t> uv_index_offsets(chunk_count + 1, 0);
+	for (size_t i = 0; i < chunk_count; i++)
+	{
+		position_offsets[i + 1] = position_offsets[i] + chunk_results[i].positions.size();
+		normal_offsets[i + 1] = normal_offsets[i] + chunk_results[i].normals.size();
+		uv_offsets[i + 1] = uv_offsets[i] + chunk_results[i].uvs.size();
+		position_index_offsets[i + 1] = position_index_offsets[i] + chunk_results[i].position_indices.size();
+		normal_index_offsets[i + 1] = normal_index_offsets[i] + chunk_results[i].normal_indices.size();
+		uv_index_offsets[i + 1] = uv_index_offsets[i] + chunk_results[i].uv_indices.size();
+	}
+
+	result.positions.resize(position_offsets[chunk_count]);
+	result.normals.resize(normal_offsets[chunk_count]);
+	result.uvs.resize(uv_offsets[chunk_count]);
+	result.position_indices.resize(position_index_offsets[chunk_count]);
+	result.normal_indices.resize(normal_index_offsets[chunk_count]);
+	result.uv_indices.resize(uv_index_offsets[chunk_count]);
+
+	// Copy all chunks into their slots concurrently
+	JobSystem::GetInstance().ParallelFor(chunk_count, 1, [&](size_t chunk_begin, size_t chunk_end)
+	{
+		for (size_t i = chunk_begin; i < chunk_end; i++)
+		{
+			CopyChunk(chunk_results[i].positions, result.positions, position_offsets[i]);
+			CopyChunk(chunk_results[i].normals, result.normals, normal_offsets[i]);
+			CopyChunk(chunk_results[i].uvs, result.uvs, uv_offsets[i]);
+			CopyChunk(chunk_results[i].position_indices, result.position_indices, position_index_offsets[i]);
+			CopyChunk(chunk_results[i].normal_indices, result.normal_indices, normal_index_offsets[i]);
+			CopyChunk(chunk_results[i].uv_indices, result.uv_indices, uv_index_offsets[i]);
+		}
+	});
+}
+
+void ObjParser::ParseLine(const char* begin, const char* end, Result& result)
+{
+	// Read the line type
+	const char* type_begin = SkipSpaces(begin, end);
+	const char* type_end = SkipToken(type_begin, end);
+	const std::string_view line_type(type_begin, type_end - type_begin);
+	const char* cursor = type_end;
+
+	// Parse the OBJ file data based on the line type
+	if (line_type == "v" || line_type == "vn")
+	{
+		glm::vec3 vec(0);
+		for (int i = 0; i < 3 && cursor != nullptr; i++)
+		{
+			cursor = ParseFloat(cursor, end, vec[i]);
+		}
+
+		if (line_type == "v")
+		{
+			result.positions.push_back(vec);
+		}
+		else
+		{
+			result.normals.push_back(vec);
+		}
+	}
+	else if (line_type == "vt")
+	{
+		glm::vec2 vec(0);
+		for (int i = 0; i < 2 && cursor != nullptr; i++)
+		{
+			cursor = ParseFloat(cursor, end, vec[i]);
+		}
+
+		result.uvs.push_back(vec);
+	}
+	else if (line_type == "f")
+	{
+		if (!ParseFace(cursor, end, result))
+		{
+			ReportError(std::string_view(begin, end - begin));
+		}
+	}
+	else if (line_type == "#" || line_type.empty())
+	{
+		// Comment or an empty line
+	}
+	else
+	{
+		ReportError(std::string_view(begin, end - begin));
+	}
+}
+
+bool ObjParser::ParseFace(const char* begin, const char* end, Result& result)
+{
+	// Only the first three corners are read (triangles), same as ObjMesh::ParseFace.
+	// Corners are parsed up-front so that a malformed face never leaves the index vectors misaligned.
+	uint32_t vertex_indices[3];
+	uint32_t normal_indices[3];
+	uint32_t uv_indices[3];
+	bool has_normal[3] = { false, false, false };
+	bool has_uv[3] = { false, false, false };
+
+	const char* cursor = begin;
+	for (int i = 0; i < 3; i++)
+	{
+		// Read the next vertex index
+		cursor = ParseIndex(cursor, end, vertex_indices[i]);
+		if (cursor == nullptr)
+		{
+			return false;
+		}
+
+		// Continue if next char is not a back-slash, since normal/texture indices do not exist
+		cursor = SkipSpaces(cursor, end);
+		if (cursor == end || *cursor != '/')
+		{
+			continue;
+		}
+
+		// Otherwise, consume the next back-slash
+		cursor = SkipSpaces(cursor + 1, end);
+		if (cursor != end && *cursor == '/')
+		{
+			// If we had two consecutive back-slashes, then only vertex/normal indices exist
+			cursor = ParseIndex(cursor + 1, end, normal_indices[i]);
+			if (cursor == nullptr)
+			{
+				return false;
+			}
+
+			has_normal[i] = true;
+			continue;
+		}
+
+		// Read the next uv index
+		cursor = ParseIndex(cursor, end, uv_indices[i]);
+		if (cursor == nullptr)
+		{
+			return false;
+		}
+
+		has_uv[i] = true;
+
+		// If no additional back-slash follows, then only vertex/texture indices exist
+		if (cursor == end || *cursor != '/')
+		{
+			continue;
+		}
+
+		// Otherwise, read the next normal index
+		cursor = ParseIndex(cursor + 1, end, normal_indices[i]);
+		if (cursor == nullptr)
+		{
+			return false;
+		}
+
+		has_normal[i] = true;
+	}
+
+	for (int i = 0; i < 3; i++)
+	{
+		result.position_indices.push_back(vertex_indices[i] - 1);
+
+		if (has_uv[i])
+		{
+			result.uv_indices.push_back(uv_indices[i] - 1);
+		}
+
+		if (has_normal[i])
+		{
+			result.normal_indices.push_back(normal_indices[i] - 1);
+		}
+	}
+
+	return true;
+}
+
+const char* ObjParser::SkipSpaces(const char* begin, const char* end)
+{
+	while (begin != end && IsSpace(*begin))
+	{
+		begin++;
+	}
+
+	return begin;
+}
+
+const char* ObjParser::SkipToken(const char* begin, const char* end)
+{
+	while (begin != end && !IsSpace(*begin))
+	{
+		begin++;
+	}
+
+	return begin;
+}
+
+const char* ObjParser::ParseFloat(const char* begin, const char* end, float& value)
+{
+	const char* cursor = SkipSpaces(begin, end);
+
+	// std::from_chars does not accept an explicit plus sign, while operator>> does
+	if (cursor != end && *cursor == '+')
+	{
+		cursor++;
+	}
+
+	const auto [ptr, ec] = std::from_chars(cursor, end, value);
+	if (ec != std::errc())
+	{
+		return nullptr;
+	}
+
+	return ptr;
+}
+
+const char* ObjParser::ParseIndex(const char* begin, const char* end, uint32_t& value)
+{
+	const char* cursor = SkipSpaces(begin, end);
+
+	if (cursor != end && *cursor == '+')
+	{
+		cursor++;
+	}
+
+	const auto [ptr, ec] = std::from_chars(cursor, end, value);
+	if (ec != std::errc() || value == 0)
+	{
+		// OBJ indices are 1-based; relative (negative) indices are not supported
+		return nullptr;
+	}
+
+	return ptr;
+}
+
+bool ObjParser::IsSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+void ObjParser::ReportError(std::string_view line)
+{
+	// Drop the carriage return of CRLF files, so the message stays on a single line
+	if (!line.empty() && line.back() == '\r')
+	{
+		line.remove_suffix(1);
+	}
+
+	std::cerr << "Cannot parse OBJ line: " << line << std::endl;
+}
\ No newline at end of file
@@ -0,0 +1,438 @@
+#include "occlusion_buffer.h"
+#include "job_system.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define OCCLUSION_BUFFER_USE_SSE
+#endif
+
+// Tiles are rasterized in parallel; their width is a multiple of the four pixels done at a time
+#define OCCLUSION_TILE_WIDTH 64
+#define OCCLUSION_TILE_HEIGHT 32
+
+// Blocks which keep their farthest depth, for rejecting boxes without reading single pixels
+#define OCCLUSION_BLOCK_SIZE 8
+
+// Boxes per culling job
+#define OCCLUSION_CULL_GRAIN 1024
+
+OcclusionBuffer::OcclusionBuffer(int width, int height) :
+	width_((std::max(width, 1) + OCCLUSION_TILE_WIDTH - 1) / OCCLUSION_TILE_WIDTH * OCCLUSION_TILE_WIDTH),
+	height_((std::max(height, 1) + OCCLUSION_TILE_HEIGHT - 1) / OCCLUSION_TILE_HEIGHT * OCCLUSION_TILE_HEIGHT),
+	tile_columns_(width_ / OCCLUSION_TILE_WIDTH),
+	tile_rows_(height_ / OCCLUSION_TILE_HEIGHT),
+	block_columns_(width_ / OCCLUSION_BLOCK_SIZE),
+	view_projection_(1.0f),
+	tile_triangles_(static_cast<size_t>(tile_columns_) * tile_rows_),
+	depth_(static_cast<size_t>(width_) * height_, 1.0f),
+	block_depth_(depth_.size() / (OCCLUSION_BLOCK_SIZE * OCCLUSION_BLOCK_SIZE), 1.0f)
+{
+
+}
+
+OcclusionBuffer::~OcclusionBuffer()
+{
+
+}
+
+void OcclusionBuffer::Clear(const glm::mat4& view_projection)
+{
+	view_projection_ = view_projection;
+	triangles_.clear();
+	std::fill(depth_.begin(), depth_.end(), 1.0f);
+	std::fill(block_depth_.begin(), block_depth_.end(), 1.0f);
+}
+
+void OcclusionBuffer::AddOccluder(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, const glm::mat4& transform)
+{
+	AddOccluder(positions.data(), positions.size(), indices.data(), indices.size(), transform);
+}
+
+void OcclusionBuffer::AddOccluder(const glm::vec3* positions, size_t position_count, const uint32_t* indices, size_t index_count, const glm::mat4& transform)
+{
+	const glm::mat4 clip_transform = view_projection_ * transform;
+	clip_positions_.resize(position_count);
+	for (size_t i = 0; i < position_count; i++)
+	{
+		clip_positions_[i] = clip_transform * glm::vec4(positions[i], 1.0f);
+	}
+
+	// Edges which only one triangle uses are on the outline of the occluder
+	auto get_edge = [indices](size_t triangle, int i)
+	{
+		const uint64_t from = indices[triangle + i];
+		const uint64_t to = indices[triangle + (i + 1) % 3];
+		return std::min(from, to) << 32 | std::max(from, to);
+	};
+
+	edges_.clear();
+	for (size_t i = 0; i + 2 < index_count; i += 3)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			edges_.push_back(get_edge(i, j));
+		}
+	}
+
+	std::sort(edges_.begin(), edges_.end());
+	for (size_t i = 0; i + 2 < index_count; i += 3)
+	{
+		std::array<bool, 3> outline;
+		for (int j = 0; j < 3; j++)
+		{
+			const auto range = std::equal_range(edges_.begin(), edges_.end(), get_edge(i, j));
+			outline[j] = range.second - range.first == 1;
+		}
+
+		AddClipTriangle({ clip_positions_[indices[i]], clip_positions_[indices[i + 1]], clip_positions_[indices[i + 2]] }, outline);
+	}
+}
+
+void OcclusionBuffer::AddClipTriangle(const std::array<glm::vec4, 3>& vertices, const std::array<bool, 3>& outline)
+{
+	// Skip triangles which are entirely outside one of the side planes
+	const glm::vec4& a = vertices[0];
+	const glm::vec4& b = vertices[1];
+	const glm::vec4& c = vertices[2];
+	for (int axis = 0; axis < 2; axis++)
+	{
+		if ((a[axis] > a.w && b[axis] > b.w && c[axis] > c.w) || (a[axis] < -a.w && b[axis] < -b.w && c[axis] < -c.w))
+		{
+			return;
+		}
+	}
+
+	// Clip against the near plane (z >= -w), which leaves a polygon of up to four vertices. Every vertex keeps
+	// whether the edge to the next one is on the outline; the edge along the near plane is
+	std::array<glm::vec4, 4> polygon;
+	std::array<bool, 4> polygon_outline;
+	size_t vertex_count = 0;
+	for (size_t i = 0; i < 3; i++)
+	{
+		const glm::vec4& current = vertices[i];
+		const glm::vec4& next = vertices[(i + 1) % 3];
+		const float current_distance = current.z + current.w;
+		const float next_distance = next.z + next.w;
+		if (current_distance >= 0)
+		{
+			polygon_outline[vertex_count] = outline[i];
+			polygon[vertex_count++] = current;
+		}
+
+		if ((current_distance >= 0) != (next_distance >= 0))
+		{
+			const float t = current_distance / (current_distance - next_distance);
+			polygon_outline[vertex_count] = current_distance >= 0 ? true : outline[i];
+			polygon[vertex_count++] = current + (next - current) * t;
+		}
+	}
+
+	// To pixel coordinates and depth in [0, 1]
+	std::array<glm::vec3, 4> screen;
+	for (size_t i = 0; i < vertex_count; i++)
+	{
+		const float w = std::max(polygon[i].w, std::numeric_limits<float>::min());
+		screen[i] = glm::vec3(
+			(polygon[i].x / w * 0.5f + 0.5f) * static_cast<float>(width_),
+			(polygon[i].y / w * 0.5f + 0.5f) * static_cast<float>(height_),
+			polygon[i].z / w * 0.5f + 0.5f);
+	}
+
+	// Fan; the diagonals of a clipped quad are inside it
+	for (size_t i = 2; i < vertex_count; i++)
+	{
+		AddScreenTriangle(screen[0], screen[i - 1], screen[i], { i == 2 && polygon_outline[0], polygon_outline[i - 1], i + 1 == vertex_count && polygon_outline[i] });
+	}
+}
+
+void OcclusionBuffer::AddScreenTriangle(glm::vec3 a, glm::vec3 b, glm::vec3 c, std::array<bool, 3> outline)
+{
+	// Both sides occlude, so make every triangle counter clockwise
+	float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	if (std::abs(area) < 1e-6f)
+	{
+		return;
+	}
+
+	if (area < 0)
+	{
+		std::swap(b, c);
+		std::swap(outline[0], outline[2]);
+		area = -area;
+	}
+
+	Triangle triangle;
+	triangle.min_x = std::max(static_cast<int>(std::floor(std::min({ a.x, b.x, c.x }))), 0);
+	triangle.min_y = std::max(static_cast<int>(std::floor(std::min({ a.y, b.y, c.y }))), 0);
+	triangle.max_x = std::min(static_cast<int>(std::ceil(std::max({ a.x, b.x, c.x }))), width_ - 1);
+	triangle.max_y = std::min(static_cast<int>(std::ceil(std::max({ a.y, b.y, c.y }))), height_ - 1);
+	if (triangle.min_x > triangle.max_x || triangle.min_y > triangle.max_y)
+	{
+		return;
+	}
+
+	// Edge functions, positive inside; moving outline edges inward by half a pixel (in the L1 sense)
+	// keeps only the pixels whose square is fully inside, when tested at the pixel center
+	const std::array<glm::vec3, 3> vertices = { a, b, c };
+	for (int i = 0; i < 3; i++)
+	{
+		const glm::vec3& from = vertices[i];
+		const glm::vec3& to = vertices[(i + 1) % 3];
+		const float edge_a = from.y - to.y;
+		const float edge_b = to.x - from.x;
+		const float edge_c = (to.y - from.y) * from.x - (to.x - from.x) * from.y;
+		triangle.edges[i] = glm::vec3(edge_a, edge_b, outline[i] ? edge_c - 0.5f * (std::abs(edge_a) + std::abs(edge_b)) : edge_c);
+	}
+
+	// Depth plane through the vertices, moved back to the farthest depth within a pixel
+	const float dx1 = b.x - a.x;
+	const float dy1 = b.y - a.y;
+	const float dx2 = c.x - a.x;
+	const float dy2 = c.y - a.y;
+	const float depth_x = ((b.z - a.z) * dy2 - (c.z - a.z) * dy1) / area;
+	const float depth_y = ((c.z - a.z) * dx1 - (b.z - a.z) * dx2) / area;
+	const float depth_c = a.z - depth_x * a.x - depth_y * a.y;
+	triangle.depth = glm::vec3(depth_x, depth_y, depth_c + 0.5f * (std::abs(depth_x) + std::abs(depth_y)));
+
+	triangles_.push_back(triangle);
+}
+
+void OcclusionBuffer::Rasterize()
+{
+	if (triangles_.empty())
+	{
+		return;
+	}
+
+	// Bin the triangles to the tiles they overlap
+	for (auto& tile : tile_triangles_)
+	{
+		tile.clear();
+	}
+
+	for (size_t i = 0; i < triangles_.size(); i++)
+	{
+		const Triangle& triangle = triangles_[i];
+		for (int row = triangle.min_y / OCCLUSION_TILE_HEIGHT; row <= triangle.max_y / OCCLUSION_TILE_HEIGHT; row++)
+		{
+			for (int column = triangle.min_x / OCCLUSION_TILE_WIDTH; column <= triangle.max_x / OCCLUSION_TILE_WIDTH; column++)
+			{
+				tile_triangles_[static_cast<size_t>(row) * tile_columns_ + column].push_back(static_cast<uint32_t>(i));
+			}
+		}
+	}
+
+	JobSystem::GetInstance().ParallelFor(tile_triangles_.size(), 1, [this](size_t begin, size_t end)
+	{
+		for (size_t tile = begin; tile < end; tile++)
+		{
+			RasterizeTile(tile);
+		}
+	});
+}
+
+void OcclusionBuffer::RasterizeTile(size_t tile)
+{
+	const int tile_x = static_cast<int>(tile % tile_columns_) * OCCLUSION_TILE_WIDTH;
+	const int tile_y = static_cast<int>(tile / tile_columns_) * OCCLUSION_TILE_HEIGHT;
+	if (tile_triangles_[tile].empty())
+	{
+		return;
+	}
+
+	for (auto index : tile_triangles_[tile])
+	{
+		const Triangle& triangle = triangles_[index];
+
+		// Start at a multiple of four pixels; the edge functions reject what is left of the triangle
+		const int min_x = std::max(triangle.min_x, tile_x) & ~3;
+		const int max_x = std::min(triangle.max_x, tile_x + OCCLUSION_TILE_WIDTH - 1);
+		const int min_y = std::max(triangle.min_y, tile_y);
+		const int max_y = std::min(triangle.max_y, tile_y + OCCLUSION_TILE_HEIGHT - 1);
+		for (int y = min_y; y <= max_y; y++)
+		{
+			const float pixel_y = static_cast<float>(y) + 0.5f;
+			float* row = &depth_[static_cast<size_t>(y) * width_];
+			int x = min_x;
+
+#ifdef OCCLUSION_BUFFER_USE_SSE
+			// Four pixels at a time, which stay within the tile as it starts at a multiple of four;
+			// edge functions and depth are linear in x
+			const __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+			const __m128 zero = _mm_setzero_ps();
+			__m128 row_edges[3];
+			for (int e = 0; e < 3; e++)
+			{
+				row_edges[e] = _mm_set1_ps(triangle.edges[e].y * pixel_y + triangle.edges[e].z);
+			}
+
+			const __m128 row_depth = _mm_set1_ps(triangle.depth.y * pixel_y + triangle.depth.z);
+			for (; x <= max_x; x += 4)
+			{
+				const __m128 pixel_x = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), offsets);
+				__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edges[0].x), pixel_x), row_edges[0]), zero);
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edges[1].x), pixel_x), row_edges[1]), zero));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edges[2].x), pixel_x), row_edges[2]), zero));
+				if (_mm_movemask_ps(inside) == 0)
+				{
+					continue;
+				}
+
+				const __m128 depth = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.depth.x), pixel_x), row_depth);
+				const __m128 current = _mm_loadu_ps(row + x);
+				const __m128 nearest = _mm_min_ps(current, depth);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+			}
+#endif
+
+			// Remaining pixels (or all of them, without SSE)
+			for (; x <= max_x; x++)
+			{
+				const float pixel_x = static_cast<float>(x) + 0.5f;
+				bool inside = true;
+				for (int e = 0; e < 3; e++)
+				{
+					inside = inside && triangle.edges[e].x * pixel_x + triangle.edges[e].y * pixel_y + triangle.edges[e].z >= 0;
+				}
+
+				if (inside)
+				{
+					row[x] = std::min(row[x], triangle.depth.x * pixel_x + triangle.depth.y * pixel_y + triangle.depth.z);
+				}
+			}
+		}
+	}
+
+	// Farthest depth of the blocks of the tile
+	for (int block_y = tile_y; block_y < tile_y + OCCLUSION_TILE_HEIGHT; block_y += OCCLUSION_BLOCK_SIZE)
+	{
+		for (int block_x = tile_x; block_x < tile_x + OCCLUSION_TILE_WIDTH; block_x += OCCLUSION_BLOCK_SIZE)
+		{
+			float farthest = 0;
+			for (int y = block_y; y < block_y + OCCLUSION_BLOCK_SIZE; y++)
+			{
+				for (int x = block_x; x < block_x + OCCLUSION_BLOCK_SIZE; x++)
+				{
+					farthest = std::max(farthest, depth_[static_cast<size_t>(y) * width_ + x]);
+				}
+			}
+
+			block_depth_[static_cast<size_t>(block_y / OCCLUSION_BLOCK_SIZE) * block_columns_ + block_x / OCCLUSION_BLOCK_SIZE] = farthest;
+		}
+	}
+}
+
+bool OcclusionBuffer::IsBoxVisible(const glm::vec3& center, const glm::vec3& extent) const
+{
+	// Screen rectangle and nearest depth of the corners; the nearest point of a box is one of its corners
+	float min_x = std::numeric_limits<float>::max();
+	float min_y = std::numeric_limits<float>::max();
+	float max_x = -std::numeric_limits<float>::max();
+	float max_y = -std::numeric_limits<float>::max();
+	float min_depth = std::numeric_limits<float>::max();
+	for (int corner = 0; corner < 8; corner++)
+	{
+		const glm::vec3 position(
+			center.x + ((corner & 1) != 0 ? extent.x : -extent.x),
+			center.y + ((corner & 2) != 0 ? extent.y : -extent.y),
+			center.z + ((corner & 4) != 0 ? extent.z : -extent.z));
+		const glm::vec4 clip = view_projection_ * glm::vec4(position, 1.0f);
+
+		// Boxes reaching in front of the near plane can't be placed on screen
+		if (clip.z < -clip.w || clip.w <= 0)
+		{
+			return true;
+		}
+
+		const float x = (clip.x / clip.w * 0.5f + 0.5f) * static_cast<float>(width_);
+		const float y = (clip.y / clip.w * 0.5f + 0.5f) * static_cast<float>(height_);
+		min_x = std::min(min_x, x);
+		min_y = std::min(min_y, y);
+		max_x = std::max(max_x, x);
+		max_y = std::max(max_y, y);
+		min_depth = std::min(min_depth, clip.z / clip.w * 0.5f + 0.5f);
+	}
+
+	// Every pixel the rectangle touches; boxes off screen are left to frustum culling
+	const int x0 = std::max(static_cast<int>(std::floor(min_x)), 0);
+	const int y0 = std::max(static_cast<int>(std::floor(min_y)), 0);
+	const int x1 = std::min(static_cast<int>(std::floor(max_x)), width_ - 1);
+	const int y1 = std::min(static_cast<int>(std::floor(max_y)), height_ - 1);
+	if (x0 > x1 || y0 > y1)
+	{
+		return true;
+	}
+
+	for (int block_y = y0 / OCCLUSION_BLOCK_SIZE; block_y <= y1 / OCCLUSION_BLOCK_SIZE; block_y++)
+	{
+		for (int block_x = x0 / OCCLUSION_BLOCK_SIZE; block_x <= x1 / OCCLUSION_BLOCK_SIZE; block_x++)
+		{
+			// The whole block is nearer than the box
+			if (block_depth_[static_cast<size_t>(block_y) * block_columns_ + block_x] < min_depth)
+			{
+				continue;
+			}
+
+			const int pixel_y0 = std::max(block_y * OCCLUSION_BLOCK_SIZE, y0);
+			const int pixel_y1 = std::min(block_y * OCCLUSION_BLOCK_SIZE + OCCLUSION_BLOCK_SIZE - 1, y1);
+			const int pixel_x0 = std::max(block_x * OCCLUSION_BLOCK_SIZE, x0);
+			const int pixel_x1 = std::min(block_x * OCCLUSION_BLOCK_SIZE + OCCLUSION_BLOCK_SIZE - 1, x1);
+			for (int y = pixel_y0; y <= pixel_y1; y++)
+			{
+				for (int x = pixel_x0; x <= pixel_x1; x++)
+				{
+					if (depth_[static_cast<size_t>(y) * width_ + x] >= min_depth)
+					{
+						return true;
+					}
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
+size_t OcclusionBuffer::CullBoxes(const Frustum::BoxList& boxes, std::vector<uint8_t>& visible) const
+{
+	std::atomic<size_t> visible_count(0);
+	JobSystem::GetInstance().ParallelFor(boxes.GetSize(), OCCLUSION_CULL_GRAIN, [&](size_t begin, size_t end)
+	{
+		size_t range_count = 0;
+		for (size_t i = begin; i < end; i++)
+		{
+			if (visible[i] == 0)
+			{
+				continue;
+			}
+
+			const glm::vec3 center(boxes.center_x[i], boxes.center_y[i], boxes.center_z[i]);
+			const glm::vec3 extent(boxes.extent_x[i], boxes.extent_y[i], boxes.extent_z[i]);
+			visible[i] = IsBoxVisible(center, extent) ? 1 : 0;
+			range_count += visible[i];
+		}
+
+		visible_count += range_count;
+	});
+
+	return visible_count;
+}
+
+int OcclusionBuffer::GetWidth() const
+{
+	return width_;
+}
+
+int OcclusionBuffer::GetHeight() const
+{
+	return height_;
+}
+
+size_t OcclusionBuffer::GetTriangleCount() const
+{
+	return triangles_.size();
+}
\ No newline at end of file
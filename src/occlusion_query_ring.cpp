@@ -0,0 +1,91 @@
+#include "occlusion_query_ring.h"
+
+OcclusionQueryRing::OcclusionQueryRing(size_t size, GLenum target) :
+	target_(target),
+	queries_(size, 0),
+	pending_(size, false),
+	current_(0),
+	next_(0),
+	result_count_(0),
+	occluded_count_(0),
+	last_result_(0)
+{
+	glGenQueries(static_cast<GLsizei>(queries_.size()), queries_.data());
+}
+
+OcclusionQueryRing::~OcclusionQueryRing()
+{
+	glDeleteQueries(static_cast<GLsizei>(queries_.size()), queries_.data());
+}
+
+void OcclusionQueryRing::Begin()
+{
+	// A query is only reused after size frames; should it still be in flight, wait for it
+	if (pending_[next_])
+	{
+		CollectResult(next_);
+	}
+
+	current_ = next_;
+	next_ = (next_ + 1) % queries_.size();
+	glBeginQuery(target_, queries_[current_]);
+}
+
+void OcclusionQueryRing::End()
+{
+	glEndQuery(target_);
+	pending_[current_] = true;
+}
+
+GLuint OcclusionQueryRing::GetCurrentQuery() const
+{
+	return queries_[current_];
+}
+
+void OcclusionQueryRing::CollectResults()
+{
+	// Queries finish in order, so stop at the first one which isn't available yet
+	for (size_t i = 0; i < queries_.size(); i++)
+	{
+		const size_t index = (next_ + i) % queries_.size();
+		if (!pending_[index])
+		{
+			continue;
+		}
+
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(queries_[index], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == GL_FALSE)
+		{
+			break;
+		}
+
+		CollectResult(index);
+	}
+}
+
+size_t OcclusionQueryRing::GetResultCount() const
+{
+	return result_count_;
+}
+
+size_t OcclusionQueryRing::GetOccludedCount() const
+{
+	return occluded_count_;
+}
+
+GLuint64 OcclusionQueryRing::GetLastResult() const
+{
+	return last_result_;
+}
+
+void OcclusionQueryRing::CollectResult(size_t index)
+{
+	glGetQueryObjectui64v(queries_[index], GL_QUERY_RESULT, &last_result_);
+	pending_[index] = false;
+	result_count_++;
+	if (last_result_ == 0)
+	{
+		occluded_count_++;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include "render_queue.h"
+#include <algorithm>
+
+// Positions of the fields of the sort key, from the most significant one
+#define KEY_PASS_SHIFT 56
+#define KEY_PROGRAM_SHIFT 48
+#define KEY_MATERIAL_SHIFT 32
+#define KEY_MESH_SHIFT 16
+#define KEY_DEPTH_MAX 0xFFFF
+
+RenderQueue::RenderQueue(UniformRingBuffer& uniform_ring) :
+	uniform_ring_(uniform_ring)
+{
+
+}
+
+RenderQueue::~RenderQueue()
+{
+
+}
+
+uint64_t RenderQueue::MakeKey(uint32_t pass, uint32_t program, uint32_t material, const ObjMesh& mesh, float depth)
+{
+	// Meshes of the same vertex format are next to each other, so the vertex array changes as little as possible
+	const uint64_t mesh_id = (static_cast<uint64_t>(mesh.GetVertexFormat()) << 15) | (mesh.GetAllocationId() & 0x7FFF);
+	const uint64_t quantized_depth = static_cast<uint64_t>(std::clamp(depth, 0.0f, 1.0f) * KEY_DEPTH_MAX);
+
+	return (static_cast<uint64_t>(pass & 0xFF) << KEY_PASS_SHIFT) |
+		(static_cast<uint64_t>(program & 0xFF) << KEY_PROGRAM_SHIFT) |
+		(static_cast<uint64_t>(material & 0xFFFF) << KEY_MATERIAL_SHIFT) |
+		(mesh_id << KEY_MESH_SHIFT) |
+		quantized_depth;
+}
+
+uint32_t RenderQueue::GetMaterialId(const Material& material)
+{
+	// There are only a few materials per frame, so a linear search is enough
+	for (size_t i = 0; i < materials_.size(); i++)
+	{
+		if (materials_[i].GetAmbientColor() == material.GetAmbientColor() && materials_[i].GetDiffuseColor() == material.GetDiffuseColor())
+		{
+			return static_cast<uint32_t>(i);
+		}
+	}
+
+	materials_.push_back(material);
+	return static_cast<uint32_t>(materials_.size() - 1);
+}
+
+uint32_t RenderQueue::AddObject(const ObjectUniforms& uniforms)
+{
+	objects_.push_back(uniforms);
+	return static_cast<uint32_t>(objects_.size() - 1);
+}
+
+void RenderQueue::Push(uint64_t key, const ObjMesh& mesh, uint32_t object)
+{
+	packets_.push_back({ key, &mesh, object });
+}
+
+void RenderQueue::Sort()
+{
+	// Count all bytes of all keys at once
+	const size_t count = packets_.size();
+	uint32_t histograms[8][256] = {};
+	for (const auto& packet : packets_)
+	{
+		for (int digit = 0; digit < 8; digit++)
+		{
+			histograms[digit][(packet.key >> (8 * digit)) & 0xFF]++;
+		}
+	}
+
+	// Stable counting sort by every byte, from the least significant one
+	sorted_packets_.resize(count);
+	for (int digit = 0; digit < 8; digit++)
+	{
+		uint32_t* histogram = histograms[digit];
+		const uint32_t first_byte = count > 0 ? (packets_[0].key >> (8 * digit)) & 0xFF : 0;
+		if (histogram[first_byte] == count)
+		{
+			continue;
+		}
+
+		uint32_t offset = 0;
+		for (int bucket = 0; bucket < 256; bucket++)
+		{
+			const uint32_t bucket_count = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucket_count;
+		}
+
+		for (const auto& packet : packets_)
+		{
+			sorted_packets_[histogram[(packet.key >> (8 * digit)) & 0xFF]++] = packet;
+		}
+
+		packets_.swap(sorted_packets_);
+	}
+}
+
+size_t RenderQueue::Submit(GLsizei instance_count)
+{
+	// Write the uniforms of all objects at once; every run of packets binds the range of its object
+	const GLintptr offset = uniform_ring_.Write(objects_.data(), sizeof(ObjectUniforms), objects_.size());
+	const size_t stride = uniform_ring_.GetStride(sizeof(ObjectUniforms));
+	size_t draw_calls = 0;
+
+	for (size_t i = 0; i < packets_.size(); i++)
+	{
+		const Packet& packet = packets_[i];
+		batch_.Add(*packet.mesh);
+
+		// Submit the batch at the end of a run of packets of the same object
+		if (i + 1 == packets_.size() || packets_[i + 1].object != packet.object)
+		{
+			uniform_ring_.BindRange(OBJECT_UNIFORMS_BINDING, offset + packet.object * stride, sizeof(ObjectUniforms));
+			draw_calls += batch_.Submit(instance_count);
+		}
+	}
+
+	Clear();
+	return draw_calls;
+}
+
+void RenderQueue::Clear()
+{
+	packets_.clear();
+	objects_.clear();
+	materials_.clear();
+}
+
+const std::vector<RenderQueue::Packet>& RenderQueue::GetPackets() const
+{
+	return packets_;
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include "render_target.h"
+#include <iostream>
+
+RenderTarget::RenderTarget() :
+	framebuffer_(0),
+	color_texture_(0),
+	depth_buffer_(0),
+	width_(0),
+	height_(0)
+{
+	glGenFramebuffers(1, &framebuffer_);
+	glGenTextures(1, &color_texture_);
+	glGenRenderbuffers(1, &depth_buffer_);
+}
+
+RenderTarget::~RenderTarget()
+{
+	glDeleteRenderbuffers(1, &depth_buffer_);
+	glDeleteTextures(1, &color_texture_);
+	glDeleteFramebuffers(1, &framebuffer_);
+}
+
+void RenderTarget::Resize(int width, int height)
+{
+	if (width == width_ && height == height_)
+	{
+		return;
+	}
+
+	width_ = width;
+	height_ = height;
+
+	// Linear filtering smooths the upscaling when the target is smaller than the screen
+	glBindTexture(GL_TEXTURE_2D, color_texture_);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width_, height_, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer_);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width_, height_);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color_texture_, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_buffer_);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cerr << "Error creating render target: " << width_ << "x" << height_ << std::endl;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void RenderTarget::Bind() const
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+	glViewport(0, 0, width_, height_);
+}
+
+GLuint RenderTarget::GetTexture() const
+{
+	return color_texture_;
+}
+
+int RenderTarget::GetWidth() const
+{
+	return width_;
+}
+
+int RenderTarget::GetHeight() const
+{
+	return height_;
+}
\ No newline at end of file
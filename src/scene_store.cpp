@@ -0,0 +1,463 @@
+#include "scene_store.h"
+#include "job_system.h"
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define SCENE_STORE_USE_SSE
+#endif
+
+// Entities per batch update job
+#define SCENE_STORE_GRAIN 2048
+
+const SceneStore::Entity SceneStore::INVALID_ENTITY = std::numeric_limits<uint32_t>::max();
+
+namespace
+{
+	// result = a * b; result may be a, but not b
+	inline void MultiplyMatrices(const glm::mat4& a, const glm::mat4& b, glm::mat4& result)
+	{
+#ifdef SCENE_STORE_USE_SSE
+		// Every column of the result is a linear combination of the columns of a
+		const __m128 a0 = _mm_loadu_ps(&a[0][0]);
+		const __m128 a1 = _mm_loadu_ps(&a[1][0]);
+		const __m128 a2 = _mm_loadu_ps(&a[2][0]);
+		const __m128 a3 = _mm_loadu_ps(&a[3][0]);
+		for (int column = 0; column < 4; column++)
+		{
+			const glm::vec4& b_column = b[column];
+			const __m128 sum = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(b_column[0])), _mm_mul_ps(a1, _mm_set1_ps(b_column[1]))),
+				_mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(b_column[2])), _mm_mul_ps(a3, _mm_set1_ps(b_column[3]))));
+			_mm_storeu_ps(&result[column][0], sum);
+		}
+#else
+		result = a * b;
+#endif
+	}
+}
+
+SceneStore::SceneStore() :
+	order_dirty_(false),
+	root_transform_(1.0f),
+	root_dirty_(false),
+	updated_count_(0)
+{
+
+}
+
+SceneStore::~SceneStore()
+{
+
+}
+
+SceneStore::Entity SceneStore::Create(const std::shared_ptr<ObjMesh>& mesh, const Material& material, const glm::mat4& local_transform, Entity parent)
+{
+	Entity entity;
+	if (!free_entities_.empty())
+	{
+		entity = free_entities_.back();
+		free_entities_.pop_back();
+	}
+	else
+	{
+		entity = static_cast<Entity>(indices_.size());
+		indices_.push_back(0);
+	}
+
+	// The levels are found again at the next update
+	order_dirty_ = true;
+
+	indices_[entity] = static_cast<uint32_t>(entities_.size());
+	entities_.push_back(entity);
+	local_transforms_.push_back(local_transform);
+	world_transforms_.push_back(local_transform);
+	normal_matrices_.emplace_back(1.0f);
+	bounds_min_.emplace_back(0);
+	bounds_max_.emplace_back(0);
+	meshes_.push_back(nullptr);
+	mesh_owners_.push_back(nullptr);
+	material_ids_.push_back(AcquireMaterial(material));
+	parents_.push_back(IsValid(parent) ? indices_[parent] : INVALID_ENTITY);
+	dirty_.push_back(1);
+	updated_.push_back(0);
+
+	SetMesh(entity, mesh);
+	return entity;
+}
+
+void SceneStore::Destroy(Entity entity)
+{
+	if (!IsValid(entity))
+	{
+		return;
+	}
+
+	const uint32_t index = indices_[entity];
+	const uint32_t last = static_cast<uint32_t>(entities_.size() - 1);
+	ReleaseMaterial(material_ids_[index]);
+
+	// Attach the children to the parent, and point the children of the last entity to its new slot
+	const uint32_t parent = parents_[index] == last ? index : parents_[index];
+	for (size_t i = 0; i < parents_.size(); i++)
+	{
+		if (parents_[i] == index)
+		{
+			parents_[i] = parent;
+			dirty_[i] = 1;
+		}
+		else if (parents_[i] == last)
+		{
+			parents_[i] = index;
+		}
+	}
+
+	// Move the last entity into the slot of the destroyed one
+	local_transforms_[index] = local_transforms_[last];
+	world_transforms_[index] = world_transforms_[last];
+	normal_matrices_[index] = normal_matrices_[last];
+	bounds_min_[index] = bounds_min_[last];
+	bounds_max_[index] = bounds_max_[last];
+	meshes_[index] = meshes_[last];
+	material_ids_[index] = material_ids_[last];
+	parents_[index] = parents_[last];
+	dirty_[index] = dirty_[last];
+	updated_[index] = updated_[last];
+	mesh_owners_[index] = std::move(mesh_owners_[last]);
+	entities_[index] = entities_[last];
+	indices_[entities_[index]] = index;
+
+	local_transforms_.pop_back();
+	world_transforms_.pop_back();
+	normal_matrices_.pop_back();
+	bounds_min_.pop_back();
+	bounds_max_.pop_back();
+	meshes_.pop_back();
+	material_ids_.pop_back();
+	parents_.pop_back();
+	dirty_.pop_back();
+	updated_.pop_back();
+	mesh_owners_.pop_back();
+	entities_.pop_back();
+
+	indices_[entity] = INVALID_ENTITY;
+	free_entities_.push_back(entity);
+	order_dirty_ = true;
+}
+
+bool SceneStore::IsValid(Entity entity) const
+{
+	return entity < indices_.size() && indices_[entity] != INVALID_ENTITY;
+}
+
+size_t SceneStore::GetIndex(Entity entity) const
+{
+	return indices_[entity];
+}
+
+size_t SceneStore::GetSize() const
+{
+	return entities_.size();
+}
+
+void SceneStore::SetMesh(Entity entity, const std::shared_ptr<ObjMesh>& mesh)
+{
+	const size_t index = indices_[entity];
+	mesh_owners_[index] = mesh;
+	meshes_[index] = mesh.get();
+	if (mesh != nullptr)
+	{
+		bounds_min_[index] = mesh->GetBoundingBox().min_coeffs;
+		bounds_max_[index] = mesh->GetBoundingBox().max_coeffs;
+	}
+
+	// Refresh the box of the entity at the next update
+	dirty_[index] = 1;
+}
+
+void SceneStore::SetMaterial(Entity entity, const Material& material)
+{
+	// Acquire first, so a material which only this entity uses isn't freed and added again
+	const size_t index = indices_[entity];
+	const uint32_t material_id = AcquireMaterial(material);
+	ReleaseMaterial(material_ids_[index]);
+	material_ids_[index] = material_id;
+}
+
+void SceneStore::SetLocalTransform(Entity entity, const glm::mat4& local_transform)
+{
+	const size_t index = indices_[entity];
+	local_transforms_[index] = local_transform;
+	dirty_[index] = 1;
+}
+
+bool SceneStore::SetParent(Entity entity, Entity parent)
+{
+	const uint32_t index = indices_[entity];
+	const uint32_t parent_index = IsValid(parent) ? indices_[parent] : INVALID_ENTITY;
+
+	// Walk up from the new parent; meeting the entity would create a cycle
+	for (uint32_t ancestor = parent_index; ancestor != INVALID_ENTITY; ancestor = parents_[ancestor])
+	{
+		if (ancestor == index)
+		{
+			return false;
+		}
+	}
+
+	parents_[index] = parent_index;
+	dirty_[index] = 1;
+	order_dirty_ = true;
+	return true;
+}
+
+SceneStore::Entity SceneStore::GetParent(Entity entity) const
+{
+	const uint32_t parent_index = parents_[indices_[entity]];
+	return parent_index != INVALID_ENTITY ? entities_[parent_index] : INVALID_ENTITY;
+}
+
+void SceneStore::SetRootTransform(const glm::mat4& root_transform)
+{
+	if (root_transform != root_transform_)
+	{
+		root_transform_ = root_transform;
+		root_dirty_ = true;
+	}
+}
+
+void SceneStore::MultiplyLocalTransforms(const glm::mat4& transform)
+{
+	JobSystem::GetInstance().ParallelFor(local_transforms_.size(), SCENE_STORE_GRAIN, [this, &transform](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			MultiplyMatrices(local_transforms_[i], transform, local_transforms_[i]);
+			dirty_[i] = 1;
+		}
+	});
+}
+
+void SceneStore::UpdateWorldTransforms()
+{
+	if (order_dirty_)
+	{
+		SortByDepth();
+	}
+
+	// Levels are updated one after the other, as every level reads the world transforms of the one before it
+	JobSystem& job_system = JobSystem::GetInstance();
+	for (size_t level = 0; level + 1 < level_offsets_.size(); level++)
+	{
+		const size_t level_begin = level_offsets_[level];
+		job_system.ParallelFor(level_offsets_[level + 1] - level_begin, SCENE_STORE_GRAIN, [this, level_begin](size_t begin, size_t end)
+		{
+			UpdateLevel(level_begin + begin, level_begin + end);
+		});
+	}
+
+	root_dirty_ = false;
+	updated_count_ = 0;
+	for (auto updated : updated_)
+	{
+		updated_count_ += updated;
+	}
+}
+
+void SceneStore::UpdateLevel(size_t begin, size_t end)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		const uint32_t parent = parents_[i];
+		const bool update = dirty_[i] || (parent != INVALID_ENTITY ? updated_[parent] != 0 : root_dirty_);
+		updated_[i] = update ? 1 : 0;
+		if (!update)
+		{
+			continue;
+		}
+
+		MultiplyMatrices(parent != INVALID_ENTITY ? world_transforms_[parent] : root_transform_, local_transforms_[i], world_transforms_[i]);
+		normal_matrices_[i] = glm::mat4(glm::transpose(glm::inverse(glm::mat3(world_transforms_[i]))));
+		dirty_[i] = 0;
+	}
+}
+
+void SceneStore::SortByDepth()
+{
+	const size_t size = entities_.size();
+
+	// Depths, walking up from every entity until an entity whose depth is already known
+	const uint32_t unknown_depth = std::numeric_limits<uint32_t>::max();
+	std::vector<uint32_t> depths(size, unknown_depth);
+	std::vector<uint32_t> chain;
+	for (size_t i = 0; i < size; i++)
+	{
+		uint32_t index = static_cast<uint32_t>(i);
+		while (index != INVALID_ENTITY && depths[index] == unknown_depth)
+		{
+			chain.push_back(index);
+			index = parents_[index];
+		}
+
+		uint32_t depth = index != INVALID_ENTITY ? depths[index] + 1 : 0;
+		while (!chain.empty())
+		{
+			depths[chain.back()] = depth++;
+			chain.pop_back();
+		}
+	}
+
+	// Counting sort by depth, which keeps the order within a level
+	const uint32_t max_depth = size > 0 ? *std::max_element(depths.begin(), depths.end()) : 0;
+	level_offsets_.assign(size > 0 ? max_depth + 2 : 1, 0);
+	for (auto depth : depths)
+	{
+		level_offsets_[depth + 1]++;
+	}
+
+	for (size_t level = 1; level < level_offsets_.size(); level++)
+	{
+		level_offsets_[level] += level_offsets_[level - 1];
+	}
+
+	std::vector<uint32_t> order(size);
+	std::vector<uint32_t> new_indices(size);
+	std::vector<size_t> fill_offsets(level_offsets_.begin(), level_offsets_.end() - 1);
+	for (size_t i = 0; i < size; i++)
+	{
+		const size_t new_index = fill_offsets[depths[i]]++;
+		order[new_index] = static_cast<uint32_t>(i);
+		new_indices[i] = static_cast<uint32_t>(new_index);
+	}
+
+	// Permute every dense array; every entity is updated after the move
+	auto permute = [&order](auto& values)
+	{
+		std::remove_reference_t<decltype(values)> sorted;
+		sorted.reserve(values.size());
+		for (auto index : order)
+		{
+			sorted.push_back(std::move(values[index]));
+		}
+
+		values.swap(sorted);
+	};
+
+	permute(local_transforms_);
+	permute(world_transforms_);
+	permute(normal_matrices_);
+	permute(bounds_min_);
+	permute(bounds_max_);
+	permute(meshes_);
+	permute(material_ids_);
+	permute(mesh_owners_);
+	permute(entities_);
+	permute(parents_);
+	for (size_t i = 0; i < size; i++)
+	{
+		parents_[i] = parents_[i] != INVALID_ENTITY ? new_indices[parents_[i]] : INVALID_ENTITY;
+		indices_[entities_[i]] = static_cast<uint32_t>(i);
+	}
+
+	dirty_.assign(size, 1);
+	updated_.assign(size, 0);
+	order_dirty_ = false;
+}
+
+void SceneStore::UpdateBounds(Frustum::BoxList& boxes) const
+{
+	// A list of another size is filled entirely
+	const bool all = boxes.GetSize() != world_transforms_.size();
+	boxes.Resize(world_transforms_.size());
+	JobSystem::GetInstance().ParallelFor(world_transforms_.size(), SCENE_STORE_GRAIN, [this, &boxes, all](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			if (all || updated_[i])
+			{
+				boxes.Set(i, bounds_min_[i], bounds_max_[i], world_transforms_[i]);
+			}
+		}
+	});
+}
+
+size_t SceneStore::GetUpdatedCount() const
+{
+	return updated_count_;
+}
+
+const std::vector<glm::mat4>& SceneStore::GetLocalTransforms() const
+{
+	return local_transforms_;
+}
+
+const std::vector<glm::mat4>& SceneStore::GetWorldTransforms() const
+{
+	return world_transforms_;
+}
+
+const std::vector<glm::mat4>& SceneStore::GetNormalMatrices() const
+{
+	return normal_matrices_;
+}
+
+const std::vector<glm::vec3>& SceneStore::GetBoundsMin() const
+{
+	return bounds_min_;
+}
+
+const std::vector<glm::vec3>& SceneStore::GetBoundsMax() const
+{
+	return bounds_max_;
+}
+
+const std::vector<const ObjMesh*>& SceneStore::GetMeshes() const
+{
+	return meshes_;
+}
+
+const std::vector<uint32_t>& SceneStore::GetMaterialIds() const
+{
+	return material_ids_;
+}
+
+const Material& SceneStore::GetMaterial(uint32_t material_id) const
+{
+	return materials_[material_id];
+}
+
+uint32_t SceneStore::AcquireMaterial(const Material& material)
+{
+	// There are only a few distinct materials, so a linear search is enough
+	uint32_t free_id = std::numeric_limits<uint32_t>::max();
+	for (size_t i = 0; i < materials_.size(); i++)
+	{
+		if (material_references_[i] == 0)
+		{
+			free_id = static_cast<uint32_t>(i);
+		}
+		else if (materials_[i].GetAmbientColor() == material.GetAmbientColor() && materials_[i].GetDiffuseColor() == material.GetDiffuseColor())
+		{
+			material_references_[i]++;
+			return static_cast<uint32_t>(i);
+		}
+	}
+
+	if (free_id == std::numeric_limits<uint32_t>::max())
+	{
+		free_id = static_cast<uint32_t>(materials_.size());
+		materials_.push_back(material);
+		material_references_.push_back(0);
+	}
+
+	materials_[free_id] = material;
+	material_references_[free_id] = 1;
+	return free_id;
+}
+
+void SceneStore::ReleaseMaterial(uint32_t material_id)
+{
+	material_references_[material_id]--;
+}
\ No newline at end of file
@@ -1,5 +1,8 @@
 #include "shader_program.h"
+#include "state_cache.h"
 #include "utils.h"
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <glm/gtc/type_ptr.hpp>
 
@@ -65,8 +68,12 @@ bool ShaderProgram::LoadShaders(const std::string& vertex_shader_file_path, cons
 	glDeleteShader(vertex_shader_handle);
 	glDeleteShader(fragment_shader_handle);
 
-	// Clear uniform variables mappings
-	uniform_locations_.clear();
+	// Find the active uniforms, and resolve the handles against them
+	ReflectUniforms();
+	for (auto& handle : handles_)
+	{
+		ResolveHandle(handle);
+	}
 
 	// Success
 	return true;
@@ -77,8 +84,10 @@ void ShaderProgram::UnloadShaders()
 	// If we have a valid linking shader program, delete it
 	if (handle_ > 0)
 	{
-		glDeleteProgram(handle_);
+		StateCache::GetInstance().DeleteProgram(handle_);
 		handle_ = 0;
+		uniforms_.clear();
+		unknown_names_.clear();
 	}
 }
 
@@ -87,7 +96,7 @@ void ShaderProgram::Use()
 	// If we have a valid linking shader program, use it
 	if (handle_ > 0)
 	{
-		glUseProgram(handle_);
+		StateCache::GetInstance().UseProgram(handle_);
 	}
 }
 
@@ -131,6 +140,148 @@ GLuint ShaderProgram::GetProgram() const
 	return handle_;
 }
 
+void ShaderProgram::ReflectUniforms()
+{
+	uniforms_.clear();
+	GLint uniform_count = 0;
+	GLint max_name_length = 0;
+	glGetProgramiv(handle_, GL_ACTIVE_UNIFORMS, &uniform_count);
+	glGetProgramiv(handle_, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+
+	std::string name(std::max(max_name_length, 1), ' ');
+	for (GLint i = 0; i < uniform_count; i++)
+	{
+		// Members of uniform blocks are set through buffers, so they have no location
+		GLint length = 0;
+		GLint size = 0;
+		GLenum type = GL_NONE;
+		glGetActiveUniform(handle_, static_cast<GLuint>(i), static_cast<GLsizei>(name.size()), &length, &size, &type, &name[0]);
+		const GLint location = glGetUniformLocation(handle_, name.c_str());
+		if (location < 0)
+		{
+			continue;
+		}
+
+		// Arrays are reported by their first element
+		std::string uniform_name = name.substr(0, length);
+		if (uniform_name.size() > 3 && uniform_name.compare(uniform_name.size() - 3, 3, "[0]") == 0)
+		{
+			uniform_name.resize(uniform_name.size() - 3);
+		}
+
+		uniforms_.push_back({ uniform_name, location, type });
+	}
+
+	std::sort(uniforms_.begin(), uniforms_.end(), [](const Uniform& a, const Uniform& b) { return a.name < b.name; });
+}
+
+const ShaderProgram::Uniform* ShaderProgram::FindUniform(const GLchar* name) const
+{
+	auto it = std::lower_bound(uniforms_.begin(), uniforms_.end(), name, [](const Uniform& uniform, const GLchar* name)
+	{
+		return std::strcmp(uniform.name.c_str(), name) < 0;
+	});
+
+	return it != uniforms_.end() && it->name == name ? &*it : nullptr;
+}
+
+void ShaderProgram::ResolveHandle(Handle& handle) const
+{
+	handle.location = -1;
+	const Uniform* uniform = FindUniform(handle.name.c_str());
+	if (uniform == nullptr)
+	{
+		std::cerr << "Error! Shader program has no active uniform: " << handle.name << std::endl;
+		return;
+	}
+
+	// Integer handles also set booleans and samplers
+	const bool is_integer = uniform->type == GL_INT || uniform->type == GL_BOOL || uniform->type == GL_SAMPLER_2D;
+	if (uniform->type != handle.type && !(handle.type == GL_INT && is_integer))
+	{
+		std::cerr << "Error! Shader uniform " << handle.name << " doesn't match the type of its handle" << std::endl;
+		return;
+	}
+
+	handle.location = uniform->location;
+}
+
+size_t ShaderProgram::AddHandle(const GLchar* name, GLenum type)
+{
+	// Handles of the same uniform share an entry
+	for (size_t i = 0; i < handles_.size(); i++)
+	{
+		if (handles_[i].name == name && handles_[i].type == type)
+		{
+			return i;
+		}
+	}
+
+	handles_.push_back({ name, type, -1 });
+	ResolveHandle(handles_.back());
+	return handles_.size() - 1;
+}
+
+GLenum ShaderProgram::GetUniformType(const glm::vec2*)
+{
+	return GL_FLOAT_VEC2;
+}
+
+GLenum ShaderProgram::GetUniformType(const glm::vec3*)
+{
+	return GL_FLOAT_VEC3;
+}
+
+GLenum ShaderProgram::GetUniformType(const glm::vec4*)
+{
+	return GL_FLOAT_VEC4;
+}
+
+GLenum ShaderProgram::GetUniformType(const glm::mat4*)
+{
+	return GL_FLOAT_MAT4;
+}
+
+GLenum ShaderProgram::GetUniformType(const GLfloat*)
+{
+	return GL_FLOAT;
+}
+
+GLenum ShaderProgram::GetUniformType(const GLint*)
+{
+	return GL_INT;
+}
+
+void ShaderProgram::SetUniform(const UniformHandle<glm::vec2>& handle, const glm::vec2& vec)
+{
+	glUniform2f(GetHandleLocation(handle), vec.x, vec.y);
+}
+
+void ShaderProgram::SetUniform(const UniformHandle<glm::vec3>& handle, const glm::vec3& vec)
+{
+	glUniform3f(GetHandleLocation(handle), vec.x, vec.y, vec.z);
+}
+
+void ShaderProgram::SetUniform(const UniformHandle<glm::vec4>& handle, const glm::vec4& vec)
+{
+	glUniform4f(GetHandleLocation(handle), vec.x, vec.y, vec.z, vec.w);
+}
+
+void ShaderProgram::SetUniform(const UniformHandle<glm::mat4>& handle, const glm::mat4& mat)
+{
+	glUniformMatrix4fv(GetHandleLocation(handle), 1, GL_FALSE, glm::value_ptr(mat));
+}
+
+void ShaderProgram::SetUniform(const UniformHandle<GLfloat>& handle, const GLfloat value)
+{
+	glUniform1f(GetHandleLocation(handle), value);
+}
+
+void ShaderProgram::SetUniform(const UniformHandle<GLint>& handle, const GLint value)
+{
+	glUniform1i(GetHandleLocation(handle), value);
+}
+
 void ShaderProgram::SetUniform(const GLchar* name, const glm::vec2& vec)
 {
 	// Set a vec2 uniform
@@ -182,17 +333,30 @@ void ShaderProgram::SetUniform(const GLchar* name, const GLint value)
 	glUniform1i(location, value);
 }
 
+void ShaderProgram::SetUniformBlockBinding(const GLchar* name, GLuint binding)
+{
+	// Blocks which the shaders don't use (or were optimized out) have no index
+	GLuint index = glGetUniformBlockIndex(handle_, name);
+	if (index != GL_INVALID_INDEX)
+	{
+		glUniformBlockBinding(handle_, index, binding);
+	}
+}
+
 GLint ShaderProgram::GetUniformLocation(const GLchar* name)
 {
-	// Check if we have already defined a uniform variable under this name
-	std::map<std::string, GLint>::iterator it = uniform_locations_.find(name);
+	const Uniform* uniform = FindUniform(name);
+	if (uniform != nullptr)
+	{
+		return uniform->location;
+	}
 
-	// If the uniform variable doesn't exist in the current shader program, create one
-	if (it == uniform_locations_.end())
+	// Report each unknown name once, instead of silently ignoring it
+	if (std::find(unknown_names_.begin(), unknown_names_.end(), name) == unknown_names_.end())
 	{
-		uniform_locations_[name] = glGetUniformLocation(handle_, name);
+		std::cerr << "Error! Shader program has no active uniform: " << name << std::endl;
+		unknown_names_.push_back(name);
 	}
 
-	// Return the handle of the uniform
-	return uniform_locations_[name];
+	return -1;
 }
\ No newline at end of file
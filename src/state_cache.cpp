@@ -0,0 +1,297 @@
+#include "state_cache.h"
+
+// Capabilities and buffer targets which are shadowed; calls for any others are always issued
+static const GLenum CACHED_CAPABILITIES[] = { GL_DEPTH_TEST, GL_STENCIL_TEST, GL_SCISSOR_TEST, GL_BLEND, GL_CULL_FACE, GL_CLIP_DISTANCE0 };
+static const GLenum CACHED_BUFFER_TARGETS[] = { GL_ARRAY_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GL_UNIFORM_BUFFER };
+
+template<typename T>
+StateCache::Shadow<T>::Shadow() :
+	value(),
+	known(false)
+{
+
+}
+
+StateCache::StateCache() :
+	buffers_(sizeof(CACHED_BUFFER_TARGETS) / sizeof(GLenum)),
+	capabilities_(sizeof(CACHED_CAPABILITIES) / sizeof(GLenum)),
+	issued_count_(0),
+	elided_count_(0),
+	last_issued_count_(0),
+	last_elided_count_(0)
+{
+	GLint binding_count = 0;
+	glGetIntegerv(GL_MAX_UNIFORM_BUFFER_BINDINGS, &binding_count);
+	uniform_ranges_.resize(binding_count);
+}
+
+StateCache& StateCache::GetInstance()
+{
+	static StateCache instance;
+	return instance;
+}
+
+void StateCache::Invalidate()
+{
+	program_ = Shadow<GLuint>();
+	vertex_array_ = Shadow<GLuint>();
+	buffers_.assign(buffers_.size(), Shadow<GLuint>());
+	uniform_ranges_.assign(uniform_ranges_.size(), Shadow<BufferRange>());
+	capabilities_.assign(capabilities_.size(), Shadow<bool>());
+	depth_mask_ = Shadow<GLboolean>();
+	depth_func_ = Shadow<GLenum>();
+	depth_range_ = Shadow<std::array<GLdouble, 2>>();
+	stencil_func_ = Shadow<std::array<GLuint, 3>>();
+	stencil_op_ = Shadow<std::array<GLuint, 3>>();
+	stencil_mask_ = Shadow<GLuint>();
+	color_mask_ = Shadow<std::array<GLboolean, 4>>();
+	blend_func_ = Shadow<std::array<GLuint, 2>>();
+	scissor_ = Shadow<std::array<GLint, 4>>();
+}
+
+void StateCache::BeginFrame()
+{
+	last_issued_count_ = issued_count_;
+	last_elided_count_ = elided_count_;
+	issued_count_ = 0;
+	elided_count_ = 0;
+	Invalidate();
+}
+
+template<typename T>
+bool StateCache::Update(Shadow<T>& shadow, const T& value)
+{
+	if (shadow.known && shadow.value == value)
+	{
+		elided_count_++;
+		return false;
+	}
+
+	shadow.value = value;
+	shadow.known = true;
+	issued_count_++;
+	return true;
+}
+
+int StateCache::GetCapabilityIndex(GLenum capability)
+{
+	for (size_t i = 0; i < sizeof(CACHED_CAPABILITIES) / sizeof(GLenum); i++)
+	{
+		if (CACHED_CAPABILITIES[i] == capability)
+		{
+			return static_cast<int>(i);
+		}
+	}
+
+	return -1;
+}
+
+int StateCache::GetBufferIndex(GLenum target)
+{
+	for (size_t i = 0; i < sizeof(CACHED_BUFFER_TARGETS) / sizeof(GLenum); i++)
+	{
+		if (CACHED_BUFFER_TARGETS[i] == target)
+		{
+			return static_cast<int>(i);
+		}
+	}
+
+	return -1;
+}
+
+void StateCache::UseProgram(GLuint program)
+{
+	if (Update(program_, program))
+	{
+		glUseProgram(program);
+	}
+}
+
+void StateCache::BindVertexArray(GLuint vertex_array)
+{
+	if (Update(vertex_array_, vertex_array))
+	{
+		glBindVertexArray(vertex_array);
+	}
+}
+
+void StateCache::BindBuffer(GLenum target, GLuint buffer)
+{
+	// The element array binding belongs to the vertex array, so it isn't shadowed
+	const int index = GetBufferIndex(target);
+	if (index < 0)
+	{
+		issued_count_++;
+		glBindBuffer(target, buffer);
+	}
+	else if (Update(buffers_[index], buffer))
+	{
+		glBindBuffer(target, buffer);
+	}
+}
+
+void StateCache::BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	if (target != GL_UNIFORM_BUFFER || index >= uniform_ranges_.size())
+	{
+		issued_count_++;
+		glBindBufferRange(target, index, buffer, offset, size);
+		return;
+	}
+
+	if (Update(uniform_ranges_[index], BufferRange{ buffer, offset, size }))
+	{
+		glBindBufferRange(target, index, buffer, offset, size);
+
+		// Binding a range also binds the buffer to the generic binding point
+		Shadow<GLuint>& generic_binding = buffers_[GetBufferIndex(GL_UNIFORM_BUFFER)];
+		generic_binding.value = buffer;
+		generic_binding.known = true;
+	}
+}
+
+void StateCache::DeleteProgram(GLuint program)
+{
+	// A program in use is only deleted once it is no longer used, so keep issuing the next glUseProgram
+	glDeleteProgram(program);
+	if (program_.value == program)
+	{
+		program_ = Shadow<GLuint>();
+	}
+}
+
+void StateCache::DeleteVertexArray(GLuint vertex_array)
+{
+	// Deleting the bound vertex array binds 0
+	glDeleteVertexArrays(1, &vertex_array);
+	if (vertex_array_.value == vertex_array)
+	{
+		vertex_array_.value = 0;
+	}
+}
+
+void StateCache::DeleteBuffer(GLuint buffer)
+{
+	// Deleting a bound buffer unbinds it from every binding point
+	glDeleteBuffers(1, &buffer);
+	for (auto& binding : buffers_)
+	{
+		if (binding.value == buffer)
+		{
+			binding.value = 0;
+		}
+	}
+
+	for (auto& range : uniform_ranges_)
+	{
+		if (range.value.buffer == buffer)
+		{
+			range = Shadow<BufferRange>();
+		}
+	}
+}
+
+void StateCache::SetEnabled(GLenum capability, bool enabled)
+{
+	const int index = GetCapabilityIndex(capability);
+	if (index >= 0 && !Update(capabilities_[index], enabled))
+	{
+		return;
+	}
+
+	if (index < 0)
+	{
+		issued_count_++;
+	}
+
+	if (enabled)
+	{
+		glEnable(capability);
+	}
+	else
+	{
+		glDisable(capability);
+	}
+}
+
+void StateCache::DepthMask(GLboolean mask)
+{
+	if (Update(depth_mask_, mask))
+	{
+		glDepthMask(mask);
+	}
+}
+
+void StateCache::DepthFunc(GLenum func)
+{
+	if (Update(depth_func_, func))
+	{
+		glDepthFunc(func);
+	}
+}
+
+void StateCache::DepthRange(GLdouble near_value, GLdouble far_value)
+{
+	if (Update(depth_range_, std::array<GLdouble, 2>{ near_value, far_value }))
+	{
+		glDepthRange(near_value, far_value);
+	}
+}
+
+void StateCache::StencilFunc(GLenum func, GLint ref, GLuint mask)
+{
+	if (Update(stencil_func_, std::array<GLuint, 3>{ func, static_cast<GLuint>(ref), mask }))
+	{
+		glStencilFunc(func, ref, mask);
+	}
+}
+
+void StateCache::StencilOp(GLenum stencil_fail, GLenum depth_fail, GLenum depth_pass)
+{
+	if (Update(stencil_op_, std::array<GLuint, 3>{ stencil_fail, depth_fail, depth_pass }))
+	{
+		glStencilOp(stencil_fail, depth_fail, depth_pass);
+	}
+}
+
+void StateCache::StencilMask(GLuint mask)
+{
+	if (Update(stencil_mask_, mask))
+	{
+		glStencilMask(mask);
+	}
+}
+
+void StateCache::ColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha)
+{
+	if (Update(color_mask_, std::array<GLboolean, 4>{ red, green, blue, alpha }))
+	{
+		glColorMask(red, green, blue, alpha);
+	}
+}
+
+void StateCache::BlendFunc(GLenum source_factor, GLenum destination_factor)
+{
+	if (Update(blend_func_, std::array<GLuint, 2>{ source_factor, destination_factor }))
+	{
+		glBlendFunc(source_factor, destination_factor);
+	}
+}
+
+void StateCache::Scissor(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	if (Update(scissor_, std::array<GLint, 4>{ x, y, width, height }))
+	{
+		glScissor(x, y, width, height);
+	}
+}
+
+size_t StateCache::GetIssuedCount() const
+{
+	return last_issued_count_;
+}
+
+size_t StateCache::GetElidedCount() const
+{
+	return last_elided_count_;
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#include "uniform_blocks.h"
+
+FrameUniforms::FrameUniforms(const glm::mat4& view, const glm::mat4& projection, PointLight& light) :
+	view(view),
+	projection(projection),
+	view_projection(projection * view),
+	light_position(light.GetPosition(), 1.0f),
+	light_ambient(light.GetAmbientLight(), 1.0f),
+	light_diffuse(light.GetDiffuseLight(), 1.0f)
+{
+
+}
+
+ObjectUniforms::ObjectUniforms(const glm::mat4& model, const glm::mat4& reflection, const glm::mat4& view_projection, const Material& material) :
+	ObjectUniforms(model, glm::mat4(glm::transpose(glm::inverse(glm::mat3(model)))), reflection, view_projection, material)
+{
+
+}
+
+ObjectUniforms::ObjectUniforms(const glm::mat4& model, const glm::mat4& normal_matrix, const glm::mat4& reflection, const glm::mat4& view_projection, const Material& material) :
+	model(model),
+	world(reflection * model),
+	normal_matrix(normal_matrix),
+	model_view_projection(view_projection * world),
+	ambient(material.GetAmbientColor(), 1.0f),
+	diffuse(material.GetDiffuseColor(), 1.0f)
+{
+
+}
\ No newline at end of file
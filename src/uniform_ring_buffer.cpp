@@ -0,0 +1,168 @@
+#include "uniform_ring_buffer.h"
+#include "state_cache.h"
+#include <algorithm>
+#include <cstring>
+
+UniformRingBuffer::UniformRingBuffer(size_t frame_capacity, size_t frame_count) :
+	buffer_(0),
+	alignment_(1),
+	frame_capacity_(0),
+	frame_count_(std::max<size_t>(frame_count, 1)),
+	frame_(0),
+	cursor_(0),
+	stall_count_(0),
+	fences_(frame_count_, nullptr)
+{
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	alignment_ = std::max<size_t>(alignment, 1);
+
+	Grow(frame_capacity);
+}
+
+UniformRingBuffer::~UniformRingBuffer()
+{
+	for (auto fence : fences_)
+	{
+		glDeleteSync(fence);
+	}
+
+	StateCache::GetInstance().DeleteBuffer(buffer_);
+}
+
+void UniformRingBuffer::Grow(size_t frame_capacity)
+{
+	const size_t old_frame_capacity = frame_capacity_;
+	const GLuint old_buffer = buffer_;
+	frame_capacity_ = GetStride(frame_capacity);
+	StateCache& state_cache = StateCache::GetInstance();
+
+	// A new buffer, which the GPU can't be using any region of
+	glGenBuffers(1, &buffer_);
+	state_cache.BindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+	glBufferData(GL_COPY_WRITE_BUFFER, frame_capacity_ * frame_count_, nullptr, GL_STREAM_DRAW);
+	for (auto& fence : fences_)
+	{
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	// Keep what was written this frame, and bind it again at its new location
+	if (old_buffer != 0)
+	{
+		if (cursor_ > 0)
+		{
+			state_cache.BindBuffer(GL_COPY_READ_BUFFER, old_buffer);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, frame_ * old_frame_capacity, frame_ * frame_capacity_, cursor_);
+			state_cache.BindBuffer(GL_COPY_READ_BUFFER, 0);
+		}
+
+		state_cache.DeleteBuffer(old_buffer);
+		for (const auto& range : bound_ranges_)
+		{
+			state_cache.BindBufferRange(GL_UNIFORM_BUFFER, range.binding, buffer_, frame_ * frame_capacity_ + range.region_offset, range.size);
+		}
+	}
+
+	state_cache.BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void UniformRingBuffer::BeginFrame()
+{
+	GLsync& fence = fences_[frame_];
+	if (fence != nullptr)
+	{
+		// Only flush once the fence turns out not to be signaled yet
+		GLenum status = glClientWaitSync(fence, 0, 0);
+		if (status == GL_TIMEOUT_EXPIRED)
+		{
+			stall_count_++;
+			do
+			{
+				status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+			} while (status == GL_TIMEOUT_EXPIRED);
+		}
+
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	cursor_ = 0;
+	bound_ranges_.clear();
+}
+
+void UniformRingBuffer::EndFrame()
+{
+	fences_[frame_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	frame_ = (frame_ + 1) % frame_count_;
+}
+
+GLintptr UniformRingBuffer::Write(const void* blocks, size_t block_size, size_t count)
+{
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	const size_t stride = GetStride(block_size);
+	const size_t size = stride * (count - 1) + block_size;
+	if (cursor_ + size > frame_capacity_)
+	{
+		Grow(std::max(frame_capacity_ * 2, cursor_ + size));
+	}
+
+	// The fence of this region was waited on in BeginFrame, and nothing else writes to it, so no synchronization is needed
+	const GLintptr offset = static_cast<GLintptr>(frame_ * frame_capacity_ + cursor_);
+	StateCache::GetInstance().BindBuffer(GL_UNIFORM_BUFFER, buffer_);
+	auto data = static_cast<char*>(glMapBufferRange(GL_UNIFORM_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+	if (data != nullptr)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			std::memcpy(data + i * stride, static_cast<const char*>(blocks) + i * block_size, block_size);
+		}
+
+		glUnmapBuffer(GL_UNIFORM_BUFFER);
+	}
+
+	cursor_ += GetStride(size);
+	return offset;
+}
+
+size_t UniformRingBuffer::GetStride(size_t block_size) const
+{
+	return (block_size + alignment_ - 1) / alignment_ * alignment_;
+}
+
+void UniformRingBuffer::BindRange(GLuint binding, GLintptr offset, size_t block_size)
+{
+	StateCache::GetInstance().BindBufferRange(GL_UNIFORM_BUFFER, binding, buffer_, offset, block_size);
+
+	// Remember the range relative to the region, in case the buffer grows
+	const size_t region_offset = offset - frame_ * frame_capacity_;
+	auto range = std::find_if(bound_ranges_.begin(), bound_ranges_.end(), [binding](const BoundRange& range) { return range.binding == binding; });
+	if (range != bound_ranges_.end())
+	{
+		range->region_offset = region_offset;
+		range->size = block_size;
+	}
+	else
+	{
+		bound_ranges_.push_back({ binding, region_offset, block_size });
+	}
+}
+
+GLuint UniformRingBuffer::GetBuffer() const
+{
+	return buffer_;
+}
+
+size_t UniformRingBuffer::GetFrameCapacity() const
+{
+	return frame_capacity_;
+}
+
+size_t UniformRingBuffer::GetStallCount() const
+{
+	return stall_count_;
+}
\ No newline at end of file
@@ -1,10 +1,56 @@
 #include "utils.h"
+#include "job_system.h"
 #include <ostream>
 #include <sstream>
 #include <fstream>
 #include <iostream>
+#include <cstring>
 #include <glm/glm.hpp>
 
+// Triangles or vertices per normal generation job
+#define NORMALS_GRAIN 16384
+
+namespace
+{
+	const uint64_t XXH_PRIME64_1 = 0x9E3779B185EBCA87ULL;
+	const uint64_t XXH_PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+	const uint64_t XXH_PRIME64_3 = 0x165667B19E3779F9ULL;
+	const uint64_t XXH_PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+	const uint64_t XXH_PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+	uint64_t RotateLeft(uint64_t value, int bits)
+	{
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	uint64_t Read64(const uint8_t* ptr)
+	{
+		uint64_t value;
+		std::memcpy(&value, ptr, sizeof(value));
+		return value;
+	}
+
+	uint32_t Read32(const uint8_t* ptr)
+	{
+		uint32_t value;
+		std::memcpy(&value, ptr, sizeof(value));
+		return value;
+	}
+
+	uint64_t HashRound(uint64_t accumulator, uint64_t input)
+	{
+		accumulator += input * XXH_PRIME64_2;
+		accumulator = RotateLeft(accumulator, 31);
+		return accumulator * XXH_PRIME64_1;
+	}
+
+	uint64_t HashMerge(uint64_t accumulator, uint64_t value)
+	{
+		accumulator ^= HashRound(0, value);
+		return accumulator * XXH_PRIME64_1 + XXH_PRIME64_4;
+	}
+}
+
 std::string Utils::TextFileToString(const std::string& file_path)
 {
 	return TextFileToStream(file_path).str();
@@ -32,42 +78,150 @@ std::stringstream Utils::TextFileToStream(const std::string& file_path)
 
 std::vector<glm::vec3> Utils::CalculateVertexNormals(const std::vector<glm::vec3>& vertices, const std::vector<uint32_t>& vertex_indices)
 {
+	const size_t triangle_count = vertex_indices.size() / 3;
+	JobSystem& job_system = JobSystem::GetInstance();
+
+	// Vertex to triangle adjacency in compressed (offset + list) form, so every vertex gathers its own sum.
+	// Indices are range checked here, on the calling thread, so the jobs below can't throw
+	std::vector<uint32_t> adjacency_offsets(vertices.size() + 1, 0);
+	for (auto index : vertex_indices)
+	{
+		adjacency_offsets.at(static_cast<size_t>(index) + 1)++;
+	}
+
+	for (size_t i = 1; i < adjacency_offsets.size(); i++)
+	{
+		adjacency_offsets[i] += adjacency_offsets[i - 1];
+	}
+
+	std::vector<uint32_t> adjacency(triangle_count * 3);
+	std::vector<uint32_t> fill_offsets(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+	for (size_t i = 0; i < triangle_count * 3; i++)
+	{
+		adjacency[fill_offsets[vertex_indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	// Face normals, in parallel
+	std::vector<glm::vec3> face_normals(triangle_count);
+	job_system.ParallelFor(triangle_count, NORMALS_GRAIN, [&](size_t begin, size_t end)
+	{
+		for (size_t t = begin; t < end; t++)
+		{
+			glm::vec3 v0 = vertices[vertex_indices[3 * t]];
+			glm::vec3 v1 = vertices[vertex_indices[3 * t + 1]];
+			glm::vec3 v2 = vertices[vertex_indices[3 * t + 2]];
+
+			glm::vec3 u = v0 - v1;
+			glm::vec3 v = v2 - v1;
+			face_normals[t] = glm::normalize(-glm::cross(u, v));
+		}
+	});
+
+	// Average the normals of the adjacent faces, in parallel; faces are added in their original order
 	std::vector<glm::vec3> normals(vertices.size());
-	std::vector<uint32_t> adjacent_faces_count(vertices.size());
+	job_system.ParallelFor(vertices.size(), NORMALS_GRAIN, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			glm::vec3 normal(0);
+			for (uint32_t k = adjacency_offsets[i]; k < adjacency_offsets[i + 1]; k++)
+			{
+				normal += face_normals[adjacency[k]];
+			}
+
+			normal /= static_cast<float>(adjacency_offsets[i + 1] - adjacency_offsets[i]);
+			normals[i] = glm::normalize(normal);
+		}
+	});
 
-	for (size_t i = 0; i < adjacent_faces_count.size(); i++)
+	return normals;
+}
+
+size_t Utils::SimulateVertexCache(const std::vector<uint32_t>& indices, size_t cache_size)
+{
+	// Cache slots hold vertex indices; a vertex is a hit if it was transformed within the last cache_size misses
+	std::vector<size_t> timestamps;
+	size_t misses = 0;
+	for (auto index : indices)
 	{
-		adjacent_faces_count[i] = 0;
+		if (index >= timestamps.size())
+		{
+			timestamps.resize(index + 1, 0);
+		}
+
+		if (timestamps[index] == 0 || misses - timestamps[index] + 1 > cache_size)
+		{
+			misses++;
+			timestamps[index] = misses;
+		}
 	}
 
-	for (size_t i = 0; i < vertex_indices.size(); i += 3)
+	return misses;
+}
+
+uint64_t Utils::HashBytes(const void* data, size_t size, uint64_t seed)
+{
+	const uint8_t* ptr = static_cast<const uint8_t*>(data);
+	const uint8_t* end = ptr + size;
+	uint64_t hash;
+
+	// Consume 32-byte stripes using four independent accumulators
+	if (size >= 32)
 	{
-		const uint32_t v1_index = vertex_indices[i];
-		const uint32_t v2_index = vertex_indices[i + 1];
-		const uint32_t v3_index = vertex_indices[i + 2];
-		
-		glm::vec3 v0 = vertices.at(v1_index);
-		glm::vec3 v1 = vertices.at(v2_index);
-		glm::vec3 v2 = vertices.at(v3_index);
+		uint64_t v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+		uint64_t v2 = seed + XXH_PRIME64_2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - XXH_PRIME64_1;
 
-		glm::vec3 u = v0 - v1;
-		glm::vec3 v = v2 - v1;
-		const glm::vec3 normal = glm::normalize(-glm::cross(u, v));
+		const uint8_t* limit = end - 32;
+		do
+		{
+			v1 = HashRound(v1, Read64(ptr));
+			v2 = HashRound(v2, Read64(ptr + 8));
+			v3 = HashRound(v3, Read64(ptr + 16));
+			v4 = HashRound(v4, Read64(ptr + 24));
+			ptr += 32;
+		} while (ptr <= limit);
+
+		hash = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+		hash = HashMerge(hash, v1);
+		hash = HashMerge(hash, v2);
+		hash = HashMerge(hash, v3);
+		hash = HashMerge(hash, v4);
+	}
+	else
+	{
+		hash = seed + XXH_PRIME64_5;
+	}
 
-		normals.at(v1_index) += normal;
-		normals.at(v2_index) += normal;
-		normals.at(v3_index) += normal;
+	hash += static_cast<uint64_t>(size);
 
-		adjacent_faces_count.at(v1_index) += 1;
-		adjacent_faces_count.at(v2_index) += 1;
-		adjacent_faces_count.at(v3_index) += 1;
+	// Consume the remaining tail
+	for (; ptr + 8 <= end; ptr += 8)
+	{
+		hash ^= HashRound(0, Read64(ptr));
+		hash = RotateLeft(hash, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
 	}
 
-	for (size_t i = 0; i < normals.size(); i++)
+	if (ptr + 4 <= end)
 	{
-		normals[i] /= adjacent_faces_count[i];
-		normals[i] = glm::normalize(normals[i]);
+		hash ^= static_cast<uint64_t>(Read32(ptr)) * XXH_PRIME64_1;
+		hash = RotateLeft(hash, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+		ptr += 4;
 	}
 
-	return normals;
+	for (; ptr < end; ptr++)
+	{
+		hash ^= static_cast<uint64_t>(*ptr) * XXH_PRIME64_5;
+		hash = RotateLeft(hash, 11) * XXH_PRIME64_1;
+	}
+
+	// Final avalanche
+	hash ^= hash >> 33;
+	hash *= XXH_PRIME64_2;
+	hash ^= hash >> 29;
+	hash *= XXH_PRIME64_3;
+	hash ^= hash >> 32;
+
+	return hash;
 }
\ No newline at end of file